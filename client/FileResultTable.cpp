@@ -28,13 +28,19 @@ FileResultTable::FileResultTable(QWidget *parent)
     setSelectionBehavior(QAbstractItemView::SelectRows);
     setSelectionMode(QAbstractItemView::SingleSelection);
     setEditTriggers(QAbstractItemView::NoEditTriggers);
-    setSortingEnabled(true);
+    // 结果分批到达，表格只能对已收到的部分排序；排序交给服务端，点击表头时重新搜索
+    setSortingEnabled(false);
     setAlternatingRowColors(true);
 
     verticalHeader()->setVisible(false);
     
     // 设置列宽
     horizontalHeader()->setDefaultAlignment(Qt::AlignLeft);
+    horizontalHeader()->setSectionsClickable(true);
+    horizontalHeader()->setSortIndicatorShown(true);
+    horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    connect(horizontalHeader(), &QHeaderView::sortIndicatorChanged,
+            this, &FileResultTable::onSortIndicatorChanged);
     horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
     horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
     horizontalHeader()->setSectionResizeMode(2, QHeaderView::Fixed);
@@ -136,6 +142,35 @@ void FileResultTable::clearResults()
     setRowCount(0);
 }
 
+QString FileResultTable::sortKey() const
+{
+    // 名称列按自然顺序，file2 排在 file10 之前
+    switch (horizontalHeader()->sortIndicatorSection()) {
+    case 0:
+        return "natural";
+    case 1:
+        return "path";
+    case 2:
+        return "size";
+    case 3:
+        return "mtime";
+    default:
+        return QString();
+    }
+}
+
+bool FileResultTable::sortDescending() const
+{
+    return horizontalHeader()->sortIndicatorOrder() == Qt::DescendingOrder;
+}
+
+void FileResultTable::onSortIndicatorChanged(int column, Qt::SortOrder order)
+{
+    Q_UNUSED(column);
+    Q_UNUSED(order);
+    emit sortChanged();
+}
+
 void FileResultTable::onItemDoubleClicked(QTableWidgetItem *item)
 {
     if (!item) return;
@@ -19,12 +19,20 @@ public:
     void addSearchResults(const QList<QVariantMap>& results);
     void clearResults();
     QString getSelectedFilePath() const;
+    // 当前的排序键（natural / path / size / mtime），为空表示按服务端的默认顺序
+    QString sortKey() const;
+    bool sortDescending() const;
+
+signals:
+    // 点击表头改变了排序方式，需要重新搜索让服务端按新的顺序返回
+    void sortChanged();
 
 protected:
     void contextMenuEvent(QContextMenuEvent *event) override;
 
 private slots:
     void onItemDoubleClicked(QTableWidgetItem *item);
+    void onSortIndicatorChanged(int column, Qt::SortOrder order);
 
 private:
     QIcon getFileIcon(const QString& filePath, bool isDirectory) const;
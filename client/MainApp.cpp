@@ -77,10 +77,17 @@ void FileSearchApp::setupUI() {
     include_hidden_checkbox_->setChecked(false);
     search_layout->addWidget(include_hidden_checkbox_);
 
+    // 拼音模式：输入 bg 或 baogao 也能找到“报告”，但不支持 ext: 等过滤条件与多词查询，默认关闭
+    pinyin_checkbox_ = new QCheckBox("拼音", this);
+    pinyin_checkbox_->setChecked(false);
+    search_layout->addWidget(pinyin_checkbox_);
+    connect(pinyin_checkbox_, &QCheckBox::toggled, this, &FileSearchApp::performSearch);
+
     search_layout->setContentsMargins(5, 0, 5, 0); // 移除边距
     
     // 搜索结果列表
     result_table_ = new FileResultTable(this);
+    connect(result_table_, &FileResultTable::sortChanged, this, &FileSearchApp::performSearch);
     
     // 主内容区域
     auto main_layout = new QVBoxLayout();
@@ -185,11 +192,22 @@ void FileSearchApp::performSearch()
         
         // 创建搜索任务
         QString include_hidden = include_hidden_checkbox_->isChecked() ? "1" : "0";
-        QUrl url(QString("%1/api/filedb/%2/task/%3?include_hidden=%4")
-                 .arg(SERVER_URL)
-                 .arg(uid)
-                 .arg(encoded_search_text)
-                 .arg(include_hidden));
+        QString url_text = QString("%1/api/filedb/%2/task/%3?include_hidden=%4")
+                           .arg(SERVER_URL)
+                           .arg(uid)
+                           .arg(encoded_search_text)
+                           .arg(include_hidden);
+        if (pinyin_checkbox_->isChecked()) {
+            url_text += "&mode=pinyin";
+        }
+        // 点击过表头时由服务端排好序再分批返回，第一批就是排序后的开头部分
+        QString sort_key = result_table_->sortKey();
+        if (!sort_key.isEmpty()) {
+            url_text += QString("&sort=%1&order=%2")
+                            .arg(sort_key)
+                            .arg(result_table_->sortDescending() ? "desc" : "asc");
+        }
+        QUrl url(url_text);
         
         QNetworkRequest request(url);
         request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
@@ -227,13 +245,16 @@ void FileSearchApp::showSearchStatus(const QString& task_id, int max_file_count)
     progress_bar_->setVisible(true);
 }
 
-void FileSearchApp::updateSearchStatus(int add_file_count)
+void FileSearchApp::updateSearchStatus(int rows_examined, int total_rows)
 {
-    currentId_ += add_file_count;
+    // 按服务端已检查的记录数 / 记录总数显示进度
+    currentId_ = rows_examined;
+    currentMaxId_ = total_rows;
     if (currentId_ > currentMaxId_)
         currentId_ = currentMaxId_;
 
-    progress_bar_->setValue(currentId_ * 100 / currentMaxId_);
+    if (currentMaxId_ > 0)
+        progress_bar_->setValue(static_cast<int>(static_cast<qint64>(currentId_) * 100 / currentMaxId_));
 }
 
 void FileSearchApp::cancelCurrentSearch()
@@ -355,7 +376,8 @@ void FileSearchApp::onFetchBatchFinished(QNetworkReply* reply)
             }
             
             if (result == "ok") {
-                updateSearchStatus(100000);
+                updateSearchStatus(obj["rows_examined"].toInt(), obj["total_rows"].toInt());
+                int estimated_matches = obj["estimated_matches"].toInt(-1);
                 bool is_finished = obj["is_finished"].toBool();
                 // 处理批数据
                 QJsonArray files_array = obj["filedb_objs"].toArray();
@@ -364,10 +386,18 @@ void FileSearchApp::onFetchBatchFinished(QNetworkReply* reply)
                     
                     // 更新状态显示
                     int current_count = result_table_->rowCount();
-                    status_label_->setText(
-                        QString("已找到 %1 个文件")
-                        .arg(current_count)
-                    );
+                    if (estimated_matches > current_count) {
+                        status_label_->setText(
+                            QString("已找到 %1 个文件，预计约 %2 个")
+                            .arg(current_count)
+                            .arg(estimated_matches)
+                        );
+                    } else {
+                        status_label_->setText(
+                            QString("已找到 %1 个文件")
+                            .arg(current_count)
+                        );
+                    }
                 }
                 
                 // 如果搜索完成，停止定时器
@@ -376,7 +406,10 @@ void FileSearchApp::onFetchBatchFinished(QNetworkReply* reply)
                     clearSearchStatus();
                     int displayed_count = result_table_->rowCount();
                     
-                    if (displayed_count == 0) {
+                    if (obj["timed_out"].toBool()) {
+                        // 超过服务端的查询时间上限，只显示已找到的部分
+                        status_label_->setText(QString("搜索超时，已找到 %1 个文件，结果可能不完整").arg(displayed_count));
+                    } else if (displayed_count == 0) {
                         status_label_->setText("没有找到匹配的文件");
                     } else {
                         status_label_->setText(QString("搜索完成，共找到 %1 个文件").arg(displayed_count));
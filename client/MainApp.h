@@ -69,7 +69,7 @@ private:
 
     void clearSearchStatus();    
     void showSearchStatus(const QString& task_id, int max_file_count);
-    void updateSearchStatus(int current_file_count);
+    void updateSearchStatus(int rows_examined, int total_rows);
     QString api_url_;
     bool isSearching_;
     
@@ -81,6 +81,7 @@ private:
     QTimer* search_timer_;
 
     QCheckBox* include_hidden_checkbox_;
+    QCheckBox* pinyin_checkbox_;
     QSystemTrayIcon* trayIcon_;
     QString currentSearchText_;
     QString currentTaskId_;
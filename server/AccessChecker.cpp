@@ -0,0 +1,99 @@
+#include "AccessChecker.h"
+#include <iostream>
+#include <algorithm>
+#include <sys/stat.h>
+#include <pwd.h>
+#include <grp.h>
+#include <unistd.h>
+
+// 目录权限的缓存时间，过期后整体清空，权限变更最迟在这之后生效
+static const int ACCESS_CACHE_TTL_SECONDS = 60;
+
+// 缓存的目录数上限，超过后整体清空
+static const size_t ACCESS_CACHE_MAX_ENTRIES = 100000;
+
+AccessChecker::AccessChecker(uid_t uid) : uid_(uid) {
+    struct passwd pwd;
+    struct passwd* found = nullptr;
+    std::vector<char> buffer(16384);
+    if (getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &found) != 0 || found == nullptr) {
+        // 没有账户信息时只按 other 位判断
+        std::cerr << "无法获取用户信息: " << uid << std::endl;
+        gid_ = static_cast<gid_t>(-1);
+        expires_ = std::chrono::steady_clock::now() + std::chrono::seconds(ACCESS_CACHE_TTL_SECONDS);
+        return;
+    }
+
+    gid_ = pwd.pw_gid;
+    int count = 32;
+    groups_.resize(count);
+    if (getgrouplist(pwd.pw_name, gid_, groups_.data(), &count) < 0) {
+        groups_.resize(count);
+        getgrouplist(pwd.pw_name, gid_, groups_.data(), &count);
+    }
+    groups_.resize(count);
+    expires_ = std::chrono::steady_clock::now() + std::chrono::seconds(ACCESS_CACHE_TTL_SECONDS);
+}
+
+bool AccessChecker::can_list(const std::string& directory) {
+    if (uid_ == 0) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    expire_if_needed();
+
+    auto it = listable_.find(directory);
+    if (it != listable_.end()) {
+        return it->second;
+    }
+
+    const bool listable = can_traverse(directory) && has_permission(directory, S_IROTH);
+    listable_[directory] = listable;
+    return listable;
+}
+
+bool AccessChecker::can_traverse(const std::string& directory) {
+    auto it = traversable_.find(directory);
+    if (it != traversable_.end()) {
+        return it->second;
+    }
+
+    bool traversable = has_permission(directory, S_IXOTH);
+    const size_t slash = directory.find_last_of('/');
+    if (traversable && slash != std::string::npos && directory != "/") {
+        // 上级目录的结果同样缓存，同一棵子树只需检查新出现的目录
+        traversable = can_traverse(slash == 0 ? "/" : directory.substr(0, slash));
+    }
+
+    traversable_[directory] = traversable;
+    return traversable;
+}
+
+bool AccessChecker::has_permission(const std::string& path, mode_t mode) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    // 与内核的判断顺序一致：属主只看 owner 位，属组成员只看 group 位，其余看 other 位
+    mode_t granted;
+    if (st.st_uid == uid_) {
+        granted = (st.st_mode >> 6) & 07;
+    } else if (st.st_gid == gid_ || std::find(groups_.begin(), groups_.end(), st.st_gid) != groups_.end()) {
+        granted = (st.st_mode >> 3) & 07;
+    } else {
+        granted = st.st_mode & 07;
+    }
+    return (granted & mode) == mode;
+}
+
+void AccessChecker::expire_if_needed() {
+    const auto now = std::chrono::steady_clock::now();
+    if (now < expires_ && traversable_.size() + listable_.size() < ACCESS_CACHE_MAX_ENTRIES) {
+        return;
+    }
+    traversable_.clear();
+    listable_.clear();
+    expires_ = now + std::chrono::seconds(ACCESS_CACHE_TTL_SECONDS);
+}
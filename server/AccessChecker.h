@@ -0,0 +1,45 @@
+#ifndef ACCESSCHECKER_H
+#define ACCESSCHECKER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <sys/types.h>
+
+// 判断某个用户能否看到共享索引中的记录：记录所在目录的每一级上级目录都可进入（x），
+// 目录本身可读且可进入（r + x），与该用户在 shell 中能否 ls 出这个文件一致。
+// 按文件的属主、属组与 mode 位判断，用户所属的附加组在构造时取一次；不考虑 ACL。
+// 每个目录的判断结果缓存一段时间，同一目录下的记录只需一次 stat，可以在多个线程上并发调用。
+class AccessChecker {
+public:
+    explicit AccessChecker(uid_t uid);
+
+    // 禁止拷贝
+    AccessChecker(const AccessChecker&) = delete;
+    AccessChecker& operator=(const AccessChecker&) = delete;
+
+    // 用户能否列出目录 directory 中的内容
+    bool can_list(const std::string& directory);
+
+    uid_t uid() const { return uid_; }
+
+private:
+    // 从根目录到 directory 的每一级都可进入，调用者需持有 mutex_
+    bool can_traverse(const std::string& directory);
+    // 对 path 是否拥有 mode 中的全部权限（S_IROTH / S_IXOTH 的组合）
+    bool has_permission(const std::string& path, mode_t mode) const;
+    void expire_if_needed();
+
+    uid_t uid_;
+    gid_t gid_ = 0;
+    std::vector<gid_t> groups_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, bool> traversable_;
+    std::unordered_map<std::string, bool> listable_;
+    std::chrono::steady_clock::time_point expires_;
+};
+
+#endif // ACCESSCHECKER_H
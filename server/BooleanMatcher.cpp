@@ -0,0 +1,149 @@
+#include "BooleanMatcher.h"
+#include <algorithm>
+
+std::vector<BooleanMatcher::Clause> BooleanMatcher::parse(const std::string& query) {
+    std::vector<Clause> clauses;
+
+    const size_t n = query.size();
+    size_t pos = 0;
+    bool pending_or = false;
+    while (pos < n) {
+        const char c = query[pos];
+        if (c == ' ' || c == '\t') {
+            pos++;
+            continue;
+        }
+        if (c == '|') {
+            // 单独的 | 把前后两个词合并为一个多选子句
+            pending_or = true;
+            pos++;
+            continue;
+        }
+
+        // 单独的 ! 或 - 按字面量处理
+        bool negated = false;
+        if ((c == '!' || c == '-') && pos + 1 < n && query[pos + 1] != ' ' && query[pos + 1] != '\t') {
+            negated = true;
+            pos++;
+        }
+
+        std::vector<std::string> terms;
+        std::string current;
+        bool quoted = false;
+        while (pos < n) {
+            const char ch = query[pos];
+            if (ch == '"') {
+                quoted = !quoted;
+                pos++;
+                continue;
+            }
+            if (!quoted && (ch == ' ' || ch == '\t')) {
+                break;
+            }
+            if (!quoted && ch == '|') {
+                if (!current.empty()) {
+                    terms.push_back(current);
+                }
+                current.clear();
+                pos++;
+                continue;
+            }
+            current += ch;
+            pos++;
+        }
+        if (!current.empty()) {
+            terms.push_back(current);
+        }
+        if (terms.empty()) {
+            continue;
+        }
+
+        if (pending_or && !clauses.empty() && !negated && !clauses.back().negated) {
+            auto& previous = clauses.back().terms;
+            previous.insert(previous.end(), terms.begin(), terms.end());
+        } else {
+            clauses.push_back(Clause{terms, negated});
+        }
+        pending_or = false;
+    }
+
+    return clauses;
+}
+
+std::shared_ptr<NameMatcher> BooleanMatcher::create(const std::string& query, const Estimator& estimate) {
+    std::vector<Clause> clauses = parse(query);
+    if (clauses.empty()) {
+        return std::make_shared<NameMatcher>(query);
+    }
+    if (clauses.size() == 1 && !clauses[0].negated && clauses[0].terms.size() == 1) {
+        return std::make_shared<NameMatcher>(clauses[0].terms[0]);
+    }
+    return std::make_shared<BooleanMatcher>(clauses, estimate);
+}
+
+BooleanMatcher::BooleanMatcher(const std::vector<Clause>& clauses, const Estimator& estimate) {
+    for (const auto& clause : clauses) {
+        CompiledClause compiled;
+        compiled.negated = clause.negated;
+        for (const auto& term : clause.terms) {
+            compiled.terms.push_back(std::make_shared<NameMatcher>(term));
+            if (!compiled.text.empty()) {
+                compiled.text += '|';
+            }
+            compiled.text += term;
+            if (!clause.negated) {
+                compiled.estimate += estimate(*compiled.terms.back());
+            }
+        }
+        clauses_.push_back(std::move(compiled));
+    }
+
+    // 不取反的子句按估计从小到大，取反的子句放在最后
+    std::stable_sort(clauses_.begin(), clauses_.end(), [](const CompiledClause& a, const CompiledClause& b) {
+        if (a.negated != b.negated) {
+            return !a.negated;
+        }
+        return !a.negated && a.estimate < b.estimate;
+    });
+
+    // 驱动子句的字面量用于预筛选：只有一个词时它的字面量必须出现，多选时名字至少包含其中一组
+    const CompiledClause& driver = clauses_.front();
+    if (driver.negated) {
+        return;     // 全部取反，只能逐个名字校验
+    }
+    if (driver.terms.size() == 1) {
+        literal_ = driver.terms[0]->literal();
+        literals_ = driver.terms[0]->literals();
+    } else {
+        for (const auto& term : driver.terms) {
+            alternatives_.push_back(term->literals());
+        }
+    }
+}
+
+bool BooleanMatcher::match(const char* name, size_t len) const {
+    for (const auto& clause : clauses_) {
+        bool any = false;
+        for (const auto& term : clause.terms) {
+            if (term->match(name, len)) {
+                any = true;
+                break;
+            }
+        }
+        if (any == clause.negated) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string BooleanMatcher::describe() const {
+    std::string result;
+    for (const auto& clause : clauses_) {
+        if (!result.empty()) {
+            result += ", ";
+        }
+        result += clause.negated ? "!" + clause.text : clause.text + "(~" + std::to_string(clause.estimate) + ")";
+    }
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef BOOLEANMATCHER_H
+#define BOOLEANMATCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstddef>
+#include "NameMatcher.h"
+
+// 多个词组成的文件名查询
+//   invoice 2025      空格分隔的词都要出现
+//   jpg|png           | 分隔的词出现任意一个即可，也可以写成 jpg | png
+//   !draft / -draft   名字中不能出现
+//   "annual report"   引号内的空格、|、!、- 按字面匹配
+// 每个词按 NameMatcher 的规则匹配（子串语义、* ?、大小写不敏感）。
+// 构造时按每个子句匹配数的估计从小到大排序：最有选择性的子句作为驱动条件，
+// 它的字面量交给 literal() / literals() / literal_alternatives() 用于索引预筛选，其余子句只在校验时判断，
+// 并且越有选择性越先判断，不匹配的名字尽早被排除。取反的子句放在最后。
+class BooleanMatcher : public NameMatcher {
+public:
+    // 子句：terms 中任意一个匹配即满足，negated 时要求全都不匹配
+    struct Clause {
+        std::vector<std::string> terms;
+        bool negated = false;
+    };
+
+    // 返回一个词的匹配数的上界，例如 NameIndex::estimate_matches
+    using Estimator = std::function<size_t(const NameMatcher&)>;
+
+    // 解析查询文本
+    static std::vector<Clause> parse(const std::string& query);
+
+    // 查询只有一个不取反的词时返回普通的 NameMatcher，行为与原来的单词搜索相同
+    static std::shared_ptr<NameMatcher> create(const std::string& query, const Estimator& estimate);
+
+    BooleanMatcher(const std::vector<Clause>& clauses, const Estimator& estimate);
+
+    bool match(const char* name, size_t len) const override;
+
+    // 按校验顺序列出各子句及其匹配数的估计，用于日志
+    std::string describe() const;
+
+private:
+    struct CompiledClause {
+        std::vector<std::shared_ptr<NameMatcher>> terms;
+        std::string text;
+        bool negated = false;
+        size_t estimate = 0;
+    };
+
+    std::vector<CompiledClause> clauses_;   // 按校验顺序排列，第一个不取反的子句为驱动条件
+};
+
+#endif // BOOLEANMATCHER_H
@@ -1,7 +1,111 @@
 // DBManager.cpp
 #include "DBManager.h"
+#include "UnicodeFold.h"
+#include "Pinyin.h"
+#include "GlobPattern.h"
 #include <iostream>
 
+// 排序规则 ANYTHING_FOLD：按 Unicode 折叠后的结果比较
+static int fold_collation(void*, int a_length, const void* a, int b_length, const void* b) {
+    return unicode_fold_compare(static_cast<const char*>(a), a_length,
+                                static_cast<const char*>(b), b_length);
+}
+
+// SQL 函数 anything_fold(text)：返回折叠后的文本，迁移旧数据库时使用
+static void fold_function(sqlite3_context* context, int, sqlite3_value** argv) {
+    const unsigned char* text = sqlite3_value_text(argv[0]);
+    if (text == nullptr) {
+        sqlite3_result_null(context);
+        return;
+    }
+    std::string folded = unicode_fold(reinterpret_cast<const char*>(text), sqlite3_value_bytes(argv[0]));
+    sqlite3_result_text(context, folded.c_str(), static_cast<int>(folded.size()), SQLITE_TRANSIENT);
+}
+
+// SQL 函数 anything_pinyin(text, initials)：返回全拼或首字母检索键，迁移旧数据库时使用
+static void pinyin_function(sqlite3_context* context, int, sqlite3_value** argv) {
+    const unsigned char* text = sqlite3_value_text(argv[0]);
+    if (text == nullptr) {
+        sqlite3_result_null(context);
+        return;
+    }
+    std::string full, initials;
+    make_pinyin_keys(std::string(reinterpret_cast<const char*>(text), sqlite3_value_bytes(argv[0])),
+                     full, initials);
+    const std::string& key = sqlite3_value_int(argv[1]) ? initials : full;
+    sqlite3_result_text(context, key.c_str(), static_cast<int>(key.size()), SQLITE_TRANSIENT);
+}
+
+static void delete_glob_pattern(void* pattern) {
+    delete static_cast<std::shared_ptr<const GlobPattern>*>(pattern);
+}
+
+// SQL 函数 anything_match(pattern, value)：value 是否匹配通配符模式，见 GlobPattern.h
+// pattern 可以是用 sqlite3_bind_pointer 绑定的、编译好的 GlobPattern（每个任务只编译一次），
+// 也可以是文本，此时按 ASCII 大小写不敏感编译，并缓存在语句上，之后的行直接使用
+static void match_function(sqlite3_context* context, int, sqlite3_value** argv) {
+    const unsigned char* value = sqlite3_value_text(argv[1]);
+    if (value == nullptr) {
+        sqlite3_result_null(context);
+        return;
+    }
+    const int length = sqlite3_value_bytes(argv[1]);
+
+    const GlobPattern* pattern = static_cast<const GlobPattern*>(
+        sqlite3_value_pointer(argv[0], GlobPattern::POINTER_TYPE));
+    std::shared_ptr<const GlobPattern> compiled;
+    if (pattern == nullptr) {
+        auto* cached = static_cast<std::shared_ptr<const GlobPattern>*>(sqlite3_get_auxdata(context, 0));
+        if (cached != nullptr) {
+            pattern = cached->get();
+        } else {
+            const unsigned char* text = sqlite3_value_text(argv[0]);
+            if (text == nullptr) {
+                sqlite3_result_null(context);
+                return;
+            }
+            compiled = GlobPattern::compile(
+                std::string(reinterpret_cast<const char*>(text), sqlite3_value_bytes(argv[0])), true);
+            pattern = compiled.get();
+            // set_auxdata 可能立即释放传入的副本，这一行仍由局部的 compiled 持有
+            sqlite3_set_auxdata(context, 0, new std::shared_ptr<const GlobPattern>(compiled), delete_glob_pattern);
+        }
+    }
+
+    sqlite3_result_int(context, pattern->match(reinterpret_cast<const char*>(value), length) ? 1 : 0);
+}
+
+// 进度回调的间隔（虚拟机指令数），取消与超时最多延迟这么多条指令生效
+static const int QUERY_PROGRESS_INTERVAL = 1000;
+
+static thread_local QueryInterruptScope* current_interrupt_scope = nullptr;
+
+QueryInterruptScope::QueryInterruptScope(const std::atomic<bool>* cancelled,
+                                         std::chrono::steady_clock::time_point deadline)
+    : cancelled_(cancelled), deadline_(deadline), previous_(current_interrupt_scope) {
+    current_interrupt_scope = this;
+}
+
+QueryInterruptScope::~QueryInterruptScope() {
+    current_interrupt_scope = previous_;
+}
+
+bool QueryInterruptScope::should_interrupt() {
+    const QueryInterruptScope* scope = current_interrupt_scope;
+    if (scope == nullptr) {
+        return false;
+    }
+    if (scope->cancelled_ && scope->cancelled_->load(std::memory_order_relaxed)) {
+        return true;
+    }
+    return std::chrono::steady_clock::now() >= scope->deadline_;
+}
+
+// 进度回调：返回非 0 时 SQLite 中断当前语句
+static int interrupt_handler(void*) {
+    return QueryInterruptScope::should_interrupt() ? 1 : 0;
+}
+
 // DBConnection 实现
 DBConnection::DBConnection(const std::string& db_path) 
     : db_path_(db_path) {
@@ -16,6 +120,19 @@ DBConnection::DBConnection(const std::string& db_path)
     sqlite3_exec(db_, "PRAGMA journal_mode=WAL", 0, 0, 0);
     sqlite3_exec(db_, "PRAGMA synchronous=NORMAL", 0, 0, 0);
     sqlite3_exec(db_, "PRAGMA foreign_keys=ON", 0, 0, 0);
+
+    // file_name_folded 列声明了 ANYTHING_FOLD 排序规则，必须在访问表之前注册
+    sqlite3_create_collation(db_, "ANYTHING_FOLD", SQLITE_UTF8, nullptr, fold_collation);
+    sqlite3_create_function(db_, "anything_fold", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                            nullptr, fold_function, nullptr, nullptr);
+    sqlite3_create_function(db_, "anything_pinyin", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                            nullptr, pinyin_function, nullptr, nullptr);
+    // 代替 LIKE：% 和 _ 按字面匹配，模式按形状编译为专门的实现
+    sqlite3_create_function(db_, "anything_match", 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                            nullptr, match_function, nullptr, nullptr);
+
+    // 搜索任务被取消或超时后中断正在执行的语句，尽快释放 operation_mutex_
+    sqlite3_progress_handler(db_, QUERY_PROGRESS_INTERVAL, interrupt_handler, nullptr);
     
     std::cout << "数据库连接已打开: " << db_path << std::endl;
 }
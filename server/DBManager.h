@@ -8,6 +8,32 @@
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <chrono>
+
+class NameIndex;
+class TokenIndex;
+class StandingQueries;
+
+// 当前线程上执行的 SQLite 语句的中断条件：取消标志被置位或到达截止时间后，
+// 连接上注册的进度回调让正在执行的语句以 SQLITE_INTERRUPT 结束。
+// 连接被多个 FileDB 共享，条件挂在线程上，不会中断其他线程在同一连接上执行的语句。
+// 作用域可以嵌套，结束时恢复外层的条件。
+class QueryInterruptScope {
+public:
+    QueryInterruptScope(const std::atomic<bool>* cancelled, std::chrono::steady_clock::time_point deadline);
+    ~QueryInterruptScope();
+
+    QueryInterruptScope(const QueryInterruptScope&) = delete;
+    QueryInterruptScope& operator=(const QueryInterruptScope&) = delete;
+
+    // 当前线程上的语句是否应当中断；短语句不会触发进度回调，逐条执行的循环需要自己检查
+    static bool should_interrupt();
+
+private:
+    const std::atomic<bool>* cancelled_;
+    std::chrono::steady_clock::time_point deadline_;
+    QueryInterruptScope* previous_;
+};
 
 class DBConnection {
 public:
@@ -41,12 +67,52 @@ public:
         is_scanobj_inited_ = inited;
     }
 
+    // 同一数据库的所有 FileDB 共享一份文件名索引
+    std::shared_ptr<NameIndex> get_name_index() {
+        return name_index_;
+    }
+
+    void set_name_index(std::shared_ptr<NameIndex> name_index) {
+        name_index_ = std::move(name_index);
+    }
+
+    // 拼音检索键的索引，只收录含汉字的文件名
+    std::shared_ptr<NameIndex> get_pinyin_index() {
+        return pinyin_index_;
+    }
+
+    void set_pinyin_index(std::shared_ptr<NameIndex> pinyin_index) {
+        pinyin_index_ = std::move(pinyin_index);
+    }
+
+    // 输入联想用的文件名词元索引
+    std::shared_ptr<TokenIndex> get_token_index() {
+        return token_index_;
+    }
+
+    void set_token_index(std::shared_ptr<TokenIndex> token_index) {
+        token_index_ = std::move(token_index);
+    }
+
+    // 常驻查询，扫描器与 Web 服务的 FileDB 共用一份，修改才能传到查询上
+    std::shared_ptr<StandingQueries> get_standing_queries() {
+        return standing_queries_;
+    }
+
+    void set_standing_queries(std::shared_ptr<StandingQueries> standing_queries) {
+        standing_queries_ = std::move(standing_queries);
+    }
+
 private:
     sqlite3* db_;
     std::string db_path_;
     std::atomic<int> ref_count_{0};
     bool is_filedb_inited_ = false;
     bool is_scanobj_inited_ = false;
+    std::shared_ptr<NameIndex> name_index_;
+    std::shared_ptr<NameIndex> pinyin_index_;
+    std::shared_ptr<TokenIndex> token_index_;
+    std::shared_ptr<StandingQueries> standing_queries_;
 };
 
 class DBManager {
@@ -7,5 +7,12 @@
 #define TARGET_DB_FILE "file_db.db"
 #define RESCAN_SCHEDULE_FILE INSTALL_PATH "/files/rescan_schedule"
 #define SCAN_OBJECTS_BACKUP_FILE INSTALL_PATH "/files/scan_objects_backup"
+#define SEARCH_THREADS_FILE INSTALL_PATH "/files/search_threads"
+#define PINYIN_KEYS_FILE INSTALL_PATH "/files/pinyin_keys"
+#define SHARED_INDEX_FILE INSTALL_PATH "/files/shared_index"
+#define QUERY_TIME_LIMIT_FILE INSTALL_PATH "/files/query_time_limit"
+#define SUGGEST_INDEX_FILE INSTALL_PATH "/files/suggest_index"
+// root 的扫描对象写入的数据库同时作为所有用户的共享索引
+#define SHARED_INDEX_UID "0"
 
 #endif
\ No newline at end of file
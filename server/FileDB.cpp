@@ -3,82 +3,250 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <unordered_set>
+#include "Utils.h"
+#include "UnicodeFold.h"
+#include "RegexMatcher.h"
+#include "BooleanMatcher.h"
+#include "TokenIndex.h"
+#include "StandingQueries.h"
 
+// 每批搜索最多花费的时间，超时后把已扫描的部分作为这一批返回，下一批从游标处继续
+static const int SEARCH_BATCH_TIME_LIMIT_MS = 30;
 
-/**
- * @brief 获取 UTF-8 字符的字节长度
- * @param firstByte UTF-8 字符的第一个字节
- * @return 该字符的总字节数（1-4）
- */
-int getUTF8CharLength(unsigned char firstByte) {
-    if ((firstByte & 0x80) == 0) {
-        return 1;  // ASCII
-    } else if ((firstByte & 0xE0) == 0xC0) {
-        return 2;  // 2 字节字符
-    } else if ((firstByte & 0xF0) == 0xE0) {
-        return 3;  // 3 字节字符
-    } else if ((firstByte & 0xF8) == 0xF0) {
-        return 4;  // 4 字节字符
+// 不走内存索引时 SQL 扫描每条语句的 id 窗口，窗口之间检查时间预算
+static const int SQL_SCAN_WINDOW = 20000;
+
+// 每个 uid 最多同时存在的搜索任务数，超过时挤掉最久没有访问的任务
+static const size_t MAX_SEARCH_TASKS = 64;
+
+// 搜索任务空闲多久后被回收（客户端不再来取结果也没有删除任务）
+static const int SEARCH_TASK_IDLE_TTL_SECONDS = 300;
+
+// 返回一批之后在后台最多预取的批数，以及预取用的线程数
+static const size_t SEARCH_PREFETCH_DEPTH = 2;
+static const size_t SEARCH_PREFETCH_THREADS = 2;
+
+// 模糊搜索最多返回的结果数
+static const size_t FUZZY_TOP_K = 1000;
+
+// 按相关度排序的搜索中，精确/前缀匹配与其余匹配各自最多返回的结果数
+static const size_t RANKED_TOP_K = 1000;
+
+// 选择查询计划时每个过滤条件最多数到的行数，超过后视为没有选择性
+static const int PLAN_PROBE_LIMIT = 100000;
+
+// 用 id IN (...) 校验过滤条件时每条语句的 id 个数，SQLite 默认最多绑定 999 个参数
+static const size_t PLAN_ID_CHUNK = 500;
+
+// 分面统计中扩展名与父目录各自最多列出的个数
+static const size_t FACET_TOP_EXTENSIONS = 20;
+static const size_t FACET_TOP_DIRECTORIES = 10;
+
+// 排序：匹配数超过有效记录数的 1/SORT_INDEX_SCAN_RATIO 时沿排序键上的索引遍历一遍，
+// 比逐条回表取键值再排序快；更少时只取匹配的键值在内存中排序
+static const int SORT_INDEX_SCAN_RATIO = 8;
+// 沿索引遍历时每页的行数，页与页之间释放 operation_mutex_
+static const int SORT_INDEX_SCAN_CHUNK = 2000;
+
+// 任务占用内存的估计：主要是各个 id 列表，matches 可能与结果缓存共用，仍按任务计算
+static size_t estimate_task_bytes(const SearchTask& task) {
+    size_t bytes = sizeof(SearchTask) + task.search_term.capacity();
+    if (task.window_ids) {
+        bytes += task.window_ids->capacity() * sizeof(int);
+    }
+    if (task.sorted && task.sorted != task.window_ids) {
+        bytes += task.sorted->capacity() * sizeof(int);
+    }
+    if (task.candidates) {
+        bytes += task.candidates->capacity() * sizeof(int);
     }
-    return 1;  // 无效 UTF-8，按单字节处理
+    if (task.matches) {
+        bytes += task.matches->capacity() * sizeof(int);
+    }
+    bytes += task.collected.capacity() * sizeof(int);
+    bytes += task.ranked.capacity() * sizeof(int);
+    bytes += task.top.capacity() * sizeof(std::pair<int, int>);
+    return bytes;
 }
 
-/**
- * @brief 更智能的转换函数，处理字面值 % 和 _
- * 注意：这个函数会稍微改变 SQL 语义，但能在不改动 SQL 语句的情况下工作
- */
-static std::string convertWithBracketSyntax(const std::string& userPattern) {
-    std::string result;
-    result.reserve(userPattern.size() * 3);
-    
-    size_t i = 0;
-    const size_t len = userPattern.size();
-    
-    while (i < len) {
-        unsigned char firstByte = static_cast<unsigned char>(userPattern[i]);
+// 请求线程取得任务的锁；后台正在预取时记下等待的时间，这部分没有与请求重叠
+static std::unique_lock<std::mutex> lock_task(SearchTask& task) {
+    if (!task.prefetch_running) {
+        return std::unique_lock<std::mutex>(task.mutex);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(task.mutex);
+    task.prefetch_stats.wait_us += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return lock;
+}
 
-        int byteCount = getUTF8CharLength(firstByte);
-        
-        if (byteCount == 1) {
-            char c = static_cast<char>(firstByte);
-            
-            if (c == '*') {
-                // 系统通配符 * → %
-                result += '%';
-            }
-            else if (c == '?') {
-                // 系统通配符 ? → _
-                result += '_';
-            }
-            else {
-                result += c;
+// 相关度分档：与模式完全相同 > 以模式开头 > 模式出现在单词开头 > 其他
+// 只有模式本身是字面量时才有完全相同和前缀两档，带通配符时按最长的字面量判断单词开头
+static int relevance_tier(const char* name, size_t len, const NameMatcher& matcher) {
+    const std::string& literal = matcher.literal();
+    if (literal.empty()) {
+        return 0;
+    }
+    if (matcher.is_literal() && len >= literal.size() && memcmp(name, literal.data(), literal.size()) == 0) {
+        return len == literal.size() ? 3 : 2;
+    }
+
+    const char* end = name + len;
+    const char* hit = name;
+    while ((hit = NameMatcher::find_literal(hit, end - hit, literal.data(), literal.size())) != nullptr) {
+        const unsigned char before = hit == name ? ' ' : static_cast<unsigned char>(hit[-1]);
+        if (before < 0x80 && !isalnum(before)) {
+            return 1;
+        }
+        hit++;
+    }
+    return 0;
+}
+
+// 拼音索引的键为 全拼/首字母，文件名中不会出现 /。两半分别交给原匹配器：
+// 锚定的一端对全拼和首字母都成立，也不会出现跨过 / 的匹配。
+// 不给出锚定的前后缀，NameIndex 在拼音索引上改用三元组预筛选，字面量在其中一半里也就在整个键里
+class PinyinKeyMatcher : public NameMatcher {
+public:
+    explicit PinyinKeyMatcher(const NameMatcher& inner) : inner_(inner) {
+        literal_ = inner.literal();
+        literals_ = inner.literals();
+        alternatives_ = inner.literal_alternatives();
+    }
+
+    bool match(const char* name, size_t len) const override {
+        const char* slash = static_cast<const char*>(memchr(name, '/', len));
+        if (slash == nullptr) {
+            return inner_.match(name, len);
+        }
+        const size_t full = static_cast<size_t>(slash - name);
+        return inner_.match(name, full) || inner_.match(slash + 1, len - full - 1);
+    }
+
+private:
+    const NameMatcher& inner_;
+};
+
+// 从 SELECT * FROM file_info 的结果行中读取一条记录
+static FileInfo read_file_info(sqlite3_stmt* stmt) {
+    auto column_text = [stmt](int column) -> std::string {
+        const unsigned char* text = sqlite3_column_text(stmt, column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    };
+
+    FileInfo file_info;
+    file_info.id = sqlite3_column_int(stmt, 0);
+    file_info.file_path = column_text(1);
+    file_info.file_name = column_text(2);
+    file_info.modified_time = column_text(3);
+    file_info.created_time = column_text(4);
+    file_info.file_extension = column_text(5);
+    file_info.mime_type = column_text(6);
+    file_info.is_directory = sqlite3_column_int(stmt, 7);
+    file_info.parent_directory = column_text(8);
+    file_info.last_scanned_time = column_text(9);
+    file_info.scan_count = sqlite3_column_int(stmt, 10);
+    // 第 11 列为 file_name_folded，只用于检索
+    file_info.file_name_pinyin = column_text(12);
+    file_info.file_name_initials = column_text(13);
+    // 迁移前的旧记录没有大小，重新扫描到之前为 NULL
+    file_info.file_size = sqlite3_column_type(stmt, 14) == SQLITE_NULL ? -1 : sqlite3_column_int64(stmt, 14);
+    return file_info;
+}
+
+// 排序键对应的列，各列上都有索引；file_name_folded 的 ANYTHING_FOLD 排序规则在折叠后的名字上与字节序一致
+static const char* sort_column(SortKey key) {
+    switch (key) {
+    case SortKey::PATH:
+        return "file_path";
+    case SortKey::MTIME:
+        return "modified_time";
+    case SortKey::SIZE:
+        return "file_size";
+    default:
+        return "file_name_folded";
+    }
+}
+
+// 自然顺序：连续的数字按数值比较，其余部分按字节比较；数值相同时前导零少的在前
+static int compare_natural(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    int zeros = 0;
+    while (i < a.size() && j < b.size()) {
+        const bool a_digit = isdigit(static_cast<unsigned char>(a[i])) != 0;
+        const bool b_digit = isdigit(static_cast<unsigned char>(b[j])) != 0;
+        if (!a_digit || !b_digit) {
+            if (a[i] != b[j]) {
+                return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[j]) ? -1 : 1;
             }
             i++;
+            j++;
+            continue;
         }
-        else {
-            // UTF-8 字符，完整复制
-            int charLen = byteCount;
-            if (i + charLen > len) {
-                charLen = len - i;
-            }
-            
-            result.append(userPattern, i, charLen);
-            i += charLen;
+
+        // 去掉前导零后位数多的大，位数相同时逐位比较
+        size_t a_start = i, b_start = j;
+        while (a_start < a.size() && a[a_start] == '0') {
+            a_start++;
+        }
+        while (b_start < b.size() && b[b_start] == '0') {
+            b_start++;
+        }
+        size_t a_end = a_start, b_end = b_start;
+        while (a_end < a.size() && isdigit(static_cast<unsigned char>(a[a_end]))) {
+            a_end++;
+        }
+        while (b_end < b.size() && isdigit(static_cast<unsigned char>(b[b_end]))) {
+            b_end++;
+        }
+        if (a_end - a_start != b_end - b_start) {
+            return a_end - a_start < b_end - b_start ? -1 : 1;
         }
+        const int digits = a.compare(a_start, a_end - a_start, b, b_start, b_end - b_start);
+        if (digits != 0) {
+            return digits < 0 ? -1 : 1;
+        }
+        if (zeros == 0 && a_start - i != b_start - j) {
+            zeros = a_start - i < b_start - j ? -1 : 1;
+        }
+        i = a_end;
+        j = b_end;
     }
-    
-    return result;
+    if (i < a.size() || j < b.size()) {
+        return i < a.size() ? 1 : -1;
+    }
+    return zeros;
 }
 
 FileDB::FileDB(const std::string& db_path) : 
     db_conn_(nullptr), 
     db_path_(db_path), 
     is_connected_(false), 
-    transaction_depth_(0) {
+    transaction_depth_(0),
+    search_tasks_(MAX_SEARCH_TASKS, std::chrono::seconds(SEARCH_TASK_IDLE_TTL_SECONDS),
+                  [this](const std::shared_ptr<SearchTask>& task) {
+                      // 被回收或淘汰的任务在共享索引中的子任务一起清理，预取好的批一起丢弃
+                      if (task->shared_db) {
+                          task->shared_db->cleanup_task(task->shared_task_id);
+                      }
+                      std::lock_guard<std::mutex> lock(task->mutex);
+                      finish_prefetch(*task);
+                  }),
+    prefetch_executor_(SEARCH_PREFETCH_THREADS) {
     init_database();
 }
 
 FileDB::~FileDB() {
+    // 后台预取和回收线程都会访问数据库连接和预编译语句，必须在它们释放之前停下；
+    // 成员按声明的逆序析构，等到执行器自己析构时连接早已关闭
+    prefetch_executor_.stop();
+    search_tasks_.stop();
     cleanup_prepared_statements();
     close();
 }
@@ -110,7 +278,11 @@ bool FileDB::init_database() {
             "is_directory INTEGER,"
             "parent_directory TEXT,"
             "last_scanned_time TEXT,"
-            "scan_count INTEGER DEFAULT 0"
+            "scan_count INTEGER DEFAULT 0,"
+            "file_name_folded TEXT COLLATE ANYTHING_FOLD,"
+            "file_name_pinyin TEXT,"
+            "file_name_initials TEXT,"
+            "file_size INTEGER"
             ")";
         
         if (!execute_sql(create_table_sql)) {
@@ -118,15 +290,41 @@ bool FileDB::init_database() {
             is_connected_ = false;
             return false;
         }
+
+        // 常驻查询的定义，匹配集合不落盘，重启后第一次取结果时重新求出
+        const char* create_standing_sql =
+            "CREATE TABLE IF NOT EXISTS standing_queries ("
+            "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "query_text TEXT NOT NULL,"
+            "mode TEXT,"
+            "root TEXT,"
+            "include_hidden INTEGER DEFAULT 0,"
+            "created_time TEXT"
+            ")";
+        if (!execute_sql(create_standing_sql)) {
+            std::cerr << "创建常驻查询表失败" << std::endl;
+        }
+
+        if (!migrate_database()) {
+            std::cerr << "数据库迁移失败" << std::endl;
+            is_connected_ = false;
+            return false;
+        }
         
         // 创建索引
         std::vector<std::string> indexes = {
             "CREATE INDEX IF NOT EXISTS idx_file_path ON file_info(file_path)",
             "CREATE INDEX IF NOT EXISTS idx_file_name ON file_info(file_name)",
+            "CREATE INDEX IF NOT EXISTS idx_file_name_folded ON file_info(file_name_folded)",
+            // 拼音检索走内存中的拼音索引，这两列上的 B 树只会拖慢每次写入；删掉旧版本建过的
+            "DROP INDEX IF EXISTS idx_file_name_pinyin",
+            "DROP INDEX IF EXISTS idx_file_name_initials",
             "CREATE INDEX IF NOT EXISTS idx_file_extension ON file_info(file_extension)",
             "CREATE INDEX IF NOT EXISTS idx_mime_type ON file_info(mime_type)",
             "CREATE INDEX IF NOT EXISTS idx_parent_directory ON file_info(parent_directory)",
             "CREATE INDEX IF NOT EXISTS idx_is_directory ON file_info(is_directory)",
+            "CREATE INDEX IF NOT EXISTS idx_file_size ON file_info(file_size)",
+            "CREATE INDEX IF NOT EXISTS idx_modified_time ON file_info(modified_time)",
             "PRAGMA synchronous = NORMAL",      // 平衡模式（默认FULL）
             "PRAGMA journal_mode = WAL",        // 写前日志（比OFF安全）
             "PRAGMA cache_size = 100000",       // 100MB缓存
@@ -143,10 +341,103 @@ bool FileDB::init_database() {
             }
         }
 
+        // 加载常驻内存的文件名索引
+        auto name_index = std::make_shared<NameIndex>();
+        if (name_index->load(db_conn_->get())) {
+            db_conn_->set_name_index(name_index);
+        }
+
+        // 拼音检索键的两种形式用 / 连接，文件名里不会出现 /
+        auto pinyin_index = std::make_shared<NameIndex>(
+            "file_name_pinyin || '/' || file_name_initials", "file_name_pinyin <> ''");
+        if (pinyin_index->load(db_conn_->get())) {
+            db_conn_->set_pinyin_index(pinyin_index);
+        }
+
+        // 输入联想用的词元索引
+        if (is_suggest_index_enabled()) {
+            auto token_index = std::make_shared<TokenIndex>();
+            if (token_index->load(db_conn_->get())) {
+                db_conn_->set_token_index(token_index);
+            }
+        }
+
+        // 保存的常驻查询，匹配集合在第一次取结果时求出
+        auto standing_queries = std::make_shared<StandingQueries>();
+        if (standing_queries->load(db_conn_->get())) {
+            db_conn_->set_standing_queries(standing_queries);
+        }
+
         db_conn_->set_fileinfo_inited(true);
         
         std::cout << "数据库表结构初始化完成" << std::endl;
     }
+
+    name_index_ = db_conn_->get_name_index();
+    pinyin_index_ = db_conn_->get_pinyin_index();
+    token_index_ = db_conn_->get_token_index();
+    standing_queries_ = db_conn_->get_standing_queries();
+    return true;
+}
+
+bool FileDB::migrate_database() {
+    // 旧数据库缺少的检索列：补上并用注册在连接上的函数回填。
+    // file_size 不回填：逐条 stat 在大库上要几分钟，启动期间一直持有写锁；
+    // 先留空，之后扫描或监控到该文件时写入，size: 过滤在此之前不匹配这些记录
+    struct Migration {
+        const char* column;
+        const char* definition;
+        const char* backfill;  // 为空时不回填
+    };
+    static const Migration migrations[] = {
+        {"file_name_folded", "TEXT COLLATE ANYTHING_FOLD",
+         "UPDATE file_info SET file_name_folded = anything_fold(file_name)"},
+        {"file_name_pinyin", "TEXT",
+         "UPDATE file_info SET file_name_pinyin = anything_pinyin(file_name, 0)"},
+        {"file_name_initials", "TEXT",
+         "UPDATE file_info SET file_name_initials = anything_pinyin(file_name, 1)"},
+        {"file_size", "INTEGER", nullptr},
+    };
+
+    std::vector<std::string> columns;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_conn_->get(), "PRAGMA table_info(file_info)", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "读取表结构失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* name = sqlite3_column_text(stmt, 1);
+        if (name) {
+            columns.push_back(reinterpret_cast<const char*>(name));
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    for (const auto& migration : migrations) {
+        if (std::find(columns.begin(), columns.end(), migration.column) != columns.end()) {
+            continue;
+        }
+
+        std::cout << "迁移数据库: 添加 " << migration.column << " 列" << std::endl;
+        auto start = std::chrono::steady_clock::now();
+
+        // 加列与回填放在同一个事务中：中途崩溃或回填失败时连列一起回滚，下次启动重新迁移，
+        // 不会留下一个已存在、却全是 NULL 的列
+        if (!execute_sql("BEGIN TRANSACTION")) {
+            return false;
+        }
+        if (!execute_sql(std::string("ALTER TABLE file_info ADD COLUMN ") + migration.column + " " +
+                         migration.definition) ||
+            (migration.backfill && !execute_sql(migration.backfill)) ||
+            !execute_sql("COMMIT")) {
+            execute_sql("ROLLBACK");
+            return false;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "数据库迁移完成: " << migration.column << ", 耗时: " << elapsed << "ms" << std::endl;
+    }
     return true;
 }
 
@@ -195,7 +486,22 @@ bool FileDB::rollback_transaction() {
         return false;
     }
     transaction_depth_ = 0;  // 所有嵌套都回滚
-    return execute_sql("ROLLBACK");
+    bool success = execute_sql("ROLLBACK");
+
+    // 事务中写入内存索引的记录已经无效，重新加载
+    if (name_index_) {
+        name_index_->load(db_conn_->get());
+    }
+    if (pinyin_index_) {
+        pinyin_index_->load(db_conn_->get());
+    }
+    if (token_index_) {
+        token_index_->load(db_conn_->get());
+    }
+    if (standing_queries_) {
+        standing_queries_->invalidate();
+    }
+    return success;
 }
 
 sqlite3_stmt* FileDB::get_prepared_statement(const std::string& sql) {
@@ -232,7 +538,8 @@ void FileDB::cleanup_prepared_statements() {
 }
 
 bool FileDB::execute_sql_with_params(const std::string& sql, 
-                                   const std::vector<std::string>& params) {
+                                   const std::vector<std::string>& params,
+                                   sqlite3_int64* last_insert_id) {
     if (!is_connected_) {
         return false;
     }
@@ -249,8 +556,15 @@ bool FileDB::execute_sql_with_params(const std::string& sql,
         sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_TRANSIENT);
     }
     
-    // 执行
+    // 执行，连接被多个 FileDB 共享，持有连接锁保证读到的是本次插入的 rowid
+    sqlite3_mutex* conn_mutex = sqlite3_db_mutex(db_conn_->get());
+    sqlite3_mutex_enter(conn_mutex);
     int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE && last_insert_id) {
+        *last_insert_id = sqlite3_last_insert_rowid(db_conn_->get());
+    }
+    sqlite3_mutex_leave(conn_mutex);
+
     if (rc != SQLITE_DONE) {
         std::cerr << "执行SQL失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
         sqlite3_reset(stmt);
@@ -273,7 +587,8 @@ std::string FileDB::get_current_time() {
 bool FileDB::insert_file(const FileInfo& file_info) {
     auto org = get_file(file_info.file_path);
     if (org) {
-        if (org->modified_time != file_info.modified_time) {
+        // 大小未知（迁移前的旧记录）时即使修改时间没变也更新一次，把大小补上
+        if (org->modified_time != file_info.modified_time || (org->file_size < 0 && file_info.file_size >= 0)) {
             return update_file(file_info.file_path, file_info);
         } else {
             return true;
@@ -283,8 +598,9 @@ bool FileDB::insert_file(const FileInfo& file_info) {
     const std::string sql = 
         "INSERT INTO file_info "
         "(file_path, file_name, modified_time, created_time, "
-        "file_extension, mime_type, is_directory, parent_directory, last_scanned_time, scan_count) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, 1)";
+        "file_extension, mime_type, is_directory, parent_directory, last_scanned_time, scan_count, "
+        "file_name_folded, file_name_pinyin, file_name_initials, file_size) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, 1, ?, ?, ?, ?)";
     
     std::vector<std::string> params = {
         file_info.file_path,
@@ -295,13 +611,19 @@ bool FileDB::insert_file(const FileInfo& file_info) {
         file_info.mime_type,
         std::to_string(file_info.is_directory),
         file_info.parent_directory,
-        get_current_time()
+        get_current_time(),
+        unicode_fold(file_info.file_name),
+        file_info.file_name_pinyin,
+        file_info.file_name_initials,
+        std::to_string(file_info.file_size)
     };
     
-    if (!execute_sql_with_params(sql, params)) {
+    sqlite3_int64 id = 0;
+    if (!execute_sql_with_params(sql, params, &id)) {
         return false;
     }
 
+    index_insert(static_cast<int>(id), file_info);
     return true;
 }
 
@@ -313,6 +635,12 @@ bool FileDB::update_file(const std::string& file_path, const FileInfo& file_info
     if (!file_info.file_name.empty()) {
         updates.push_back("file_name = ?");
         params.push_back(file_info.file_name);
+        updates.push_back("file_name_folded = ?");
+        params.push_back(unicode_fold(file_info.file_name));
+        updates.push_back("file_name_pinyin = ?");
+        params.push_back(file_info.file_name_pinyin);
+        updates.push_back("file_name_initials = ?");
+        params.push_back(file_info.file_name_initials);
     }
     if (!file_info.modified_time.empty()) {
         updates.push_back("modified_time = ?");
@@ -332,6 +660,8 @@ bool FileDB::update_file(const std::string& file_path, const FileInfo& file_info
     }
     updates.push_back("is_directory = ?");
     params.push_back(std::to_string(file_info.is_directory));
+    updates.push_back("file_size = ?");
+    params.push_back(std::to_string(file_info.file_size));
     
     if (!file_info.parent_directory.empty()) {
         updates.push_back("parent_directory = ?");
@@ -355,6 +685,10 @@ bool FileDB::update_file(const std::string& file_path, const FileInfo& file_info
     params.push_back(file_path);
     
     if (execute_sql_with_params(sql, params)) {
+        auto updated = get_file(file_path);
+        if (updated) {
+            index_insert(updated->id, *updated);
+        }
         return true;
     }
     
@@ -365,8 +699,14 @@ bool FileDB::update_file(const std::string& file_path, const FileInfo& file_info
 bool FileDB::delete_file(const std::string& file_path) {
     const std::string sql = "DELETE FROM file_info WHERE file_path = ?";
     std::vector<std::string> params = {file_path};
+
+    std::vector<int> ids;
+    if (name_index_ || pinyin_index_ || token_index_ || standing_queries_) {
+        ids = query_ids("SELECT id FROM file_info WHERE file_path = ?", params);
+    }
     
     if (execute_sql_with_params(sql, params)) {
+        index_remove(ids);
         std::cout << "文件记录删除成功: " << file_path << std::endl;
         return true;
     }
@@ -378,11 +718,18 @@ bool FileDB::delete_file(const std::string& file_path) {
 bool FileDB::delete_files_by_path_prefix(const std::string& path_prefix) {
     if (!is_connected_) return false;
     
-    std::string sql = "DELETE FROM file_info WHERE file_path LIKE ? || '%'";
+    // 按前缀比较而不是 LIKE：路径中的 % _ 按字面量处理，也不做大小写不敏感的匹配
+    std::string sql = "DELETE FROM file_info WHERE substr(file_path, 1, length(?1)) = ?1";
 
     std::vector<std::string> params = {path_prefix};
+
+    std::vector<int> ids;
+    if (name_index_ || pinyin_index_ || token_index_ || standing_queries_) {
+        ids = query_ids("SELECT id FROM file_info WHERE substr(file_path, 1, length(?1)) = ?1", params);
+    }
     
     if (execute_sql_with_params(sql, params)) {
+        index_remove(ids);
         std::cout << "递归删除目录记录成功: " << path_prefix << std::endl;
         return true;
     }
@@ -394,8 +741,14 @@ bool FileDB::delete_files_by_path_prefix(const std::string& path_prefix) {
 bool FileDB::delete_files_by_directory(const std::string& directory_path) {
     const std::string sql = "DELETE FROM file_info WHERE parent_directory = ? OR file_path = ?";
     std::vector<std::string> params = {directory_path, directory_path};
+
+    std::vector<int> ids;
+    if (name_index_ || pinyin_index_ || token_index_ || standing_queries_) {
+        ids = query_ids("SELECT id FROM file_info WHERE parent_directory = ? OR file_path = ?", params);
+    }
     
     if (execute_sql_with_params(sql, params)) {
+        index_remove(ids);
         std::cout << "删除目录记录成功: " << directory_path << std::endl;
         return true;
     }
@@ -421,19 +774,7 @@ std::unique_ptr<FileInfo> FileDB::get_file(const std::string& file_path) {
     sqlite3_bind_text(stmt, 1, file_path.c_str(), -1, SQLITE_TRANSIENT);
     
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        auto file_info = std::make_unique<FileInfo>();
-        file_info->id = sqlite3_column_int(stmt, 0);
-        file_info->file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        file_info->file_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        file_info->modified_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        file_info->created_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        file_info->file_extension = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        file_info->mime_type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-        file_info->is_directory = sqlite3_column_int(stmt, 7);
-        file_info->parent_directory = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-        file_info->last_scanned_time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9));
-        file_info->scan_count = sqlite3_column_int(stmt, 10);
-        
+        auto file_info = std::make_unique<FileInfo>(read_file_info(stmt));
         sqlite3_reset(stmt);
         return file_info;
     }
@@ -480,11 +821,34 @@ std::vector<FileInfo> FileDB::search_files(const std::string& search_term,
         return results;
     }
     
-    std::string sql = "SELECT * FROM file_info WHERE " + search_field + " LIKE ? ORDER BY file_path LIMIT ?";
-    std::string pattern = "%" + search_term + "%";
-    
     if (!is_connected_) return results;
 
+    if (search_field == "file_name" && name_index_) {
+        // 文件名搜索走内存索引，只对匹配的记录回表
+        NameMatcher matcher(search_term);
+        std::vector<int> candidates;
+        bool use_candidates = name_index_->find_candidates(matcher, candidates);
+
+        std::vector<int> ids;
+        name_index_->search(matcher, 0, INT32_MAX, true, -1, ids,
+                            use_candidates ? &candidates : nullptr);
+
+        results = get_files_by_ids(ids);
+        std::sort(results.begin(), results.end(), [](const FileInfo& a, const FileInfo& b) {
+            return a.file_path < b.file_path;
+        });
+        if (limit >= 0 && results.size() > static_cast<size_t>(limit)) {
+            results.resize(limit);
+        }
+        return results;
+    }
+
+    // 文件名按折叠列比较，其他列按 ASCII 大小写不敏感
+    const bool by_name = search_field == "file_name";
+    std::string column = by_name ? "file_name_folded" : search_field;
+    std::string sql = "SELECT * FROM file_info WHERE anything_match(?, " + column + ") ORDER BY file_path LIMIT ?";
+    auto pattern = GlobPattern::compile(NameMatcher::substring_glob(by_name ? unicode_fold(search_term) : search_term), !by_name);
+
     std::lock_guard<std::mutex> lock(operation_mutex_);
     
     sqlite3_stmt* stmt;
@@ -495,7 +859,7 @@ std::vector<FileInfo> FileDB::search_files(const std::string& search_term,
         return results;
     }
     
-    sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_pointer(stmt, 1, const_cast<GlobPattern*>(pattern.get()), GlobPattern::POINTER_TYPE, nullptr);
     sqlite3_bind_int(stmt, 2, limit);
     
     while (sqlite3_step(stmt) == SQLITE_ROW) {
@@ -519,6 +883,179 @@ std::vector<FileInfo> FileDB::search_files(const std::string& search_term,
     return results;
 }
 
+std::vector<std::pair<std::string, int>> FileDB::suggest_completions(const std::string& text, int limit) {
+    std::vector<std::pair<std::string, int>> completions;
+    if (!token_index_ || limit <= 0) {
+        return completions;
+    }
+
+    // 只补全最后一个词：从最后一个分隔符（包括多词查询的 | ! 和引号）之后开始，前面的部分原样保留
+    const size_t split = text.find_last_of(" \t._-|!\"");
+    const std::string head = split == std::string::npos ? std::string() : text.substr(0, split + 1);
+    const std::string prefix = unicode_fold(split == std::string::npos ? text : text.substr(split + 1));
+
+    for (const auto& suggestion : token_index_->suggest(prefix, static_cast<size_t>(limit))) {
+        completions.emplace_back(head + suggestion.token, static_cast<int>(suggestion.count));
+    }
+    return completions;
+}
+
+int FileDB::add_standing_query(const std::string& text, const std::string& mode, const std::string& root,
+                               bool include_hidden) {
+    if (!standing_queries_ || !name_index_) {
+        throw std::invalid_argument("常驻查询需要文件名索引");
+    }
+    if (!mode.empty() && mode != "pinyin" && mode != "regex") {
+        throw std::invalid_argument("常驻查询不支持的模式: " + mode);
+    }
+    if (text.empty()) {
+        throw std::invalid_argument("常驻查询的搜索文本为空");
+    }
+    // 过滤条件要回表校验，不能只凭变化的这一条记录判断；正则在这里先编译一次，模式非法时抛出
+    if (mode.empty() && !parse_search_query(text).filters.empty()) {
+        throw std::invalid_argument("常驻查询不支持 ext: type: size: modified: 过滤条件，可以用 root 限定目录");
+    }
+    if (mode == "regex") {
+        RegexMatcher check(text);
+    }
+
+    // 目录去掉末尾的 /，根目录等于不限
+    std::string directory = root;
+    while (directory.size() > 1 && directory.back() == '/') {
+        directory.pop_back();
+    }
+    if (directory == "/") {
+        directory.clear();
+    }
+
+    StandingQueries::Definition definition;
+    definition.text = text;
+    definition.mode = mode;
+    definition.root = directory;
+    definition.include_hidden = include_hidden;
+    definition.created_time = get_current_time();
+
+    sqlite3_int64 id = 0;
+    if (!execute_sql_with_params("INSERT INTO standing_queries (query_text, mode, root, include_hidden, created_time) "
+                                 "VALUES (?, ?, ?, ?, ?)",
+                                 {definition.text, definition.mode, definition.root,
+                                  include_hidden ? "1" : "0", definition.created_time},
+                                 &id)) {
+        return 0;
+    }
+    definition.id = static_cast<int>(id);
+    standing_queries_->add(definition);
+    std::cout << "添加常驻查询: " << definition.id << " (" << text << ")" << std::endl;
+    return definition.id;
+}
+
+bool FileDB::delete_standing_query(int id) {
+    if (!standing_queries_ || !standing_queries_->remove(id)) {
+        return false;
+    }
+    return execute_sql_with_params("DELETE FROM standing_queries WHERE id = ?", {std::to_string(id)});
+}
+
+std::vector<StandingQueries::Definition> FileDB::get_standing_queries() {
+    if (!standing_queries_) {
+        return {};
+    }
+    return standing_queries_->list();
+}
+
+bool FileDB::fetch_standing_query(int id, uint64_t since, uint64_t& version, bool& reset,
+                                  std::vector<FileInfo>& added, std::vector<int>& removed) {
+    if (!standing_queries_) {
+        return false;
+    }
+    StandingQueries::Delta delta;
+    auto evaluate = [this](const StandingQueries::Definition& definition, std::vector<int>& ids) {
+        return evaluate_standing_query(definition, ids);
+    };
+    if (!standing_queries_->fetch(id, since, evaluate, delta)) {
+        return false;
+    }
+    version = delta.version;
+    reset = delta.reset;
+    removed = std::move(delta.removed);
+    added = get_files_by_ids(delta.added);
+    return true;
+}
+
+std::shared_ptr<NameMatcher> FileDB::evaluate_standing_query(const StandingQueries::Definition& definition,
+                                                             std::vector<int>& ids) {
+    if (!name_index_) {
+        return nullptr;
+    }
+
+    // 与同样模式的搜索任务使用相同的匹配器
+    std::shared_ptr<NameMatcher> matcher;
+    try {
+        if (definition.mode == "regex") {
+            matcher = std::make_shared<RegexMatcher>(definition.text);
+        } else if (definition.mode == "pinyin") {
+            matcher = std::make_shared<NameMatcher>(definition.text);
+        } else {
+            matcher = compile_name_query(definition.text);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "常驻查询编译失败: " << definition.id << ", " << e.what() << std::endl;
+        return nullptr;
+    }
+
+    if (definition.mode == "pinyin" && pinyin_index_) {
+        ids = *search_pinyin(*matcher, definition.include_hidden);
+    } else {
+        std::vector<int> candidates;
+        const bool use_candidates = name_index_->find_candidates(*matcher, candidates);
+        name_index_->search(*matcher, 0, INT32_MAX, definition.include_hidden, -1, ids,
+                            use_candidates ? &candidates : nullptr, get_search_parallelism());
+    }
+
+    if (!definition.root.empty()) {
+        // 目录本身或其下任意一层；只在求值时执行一次，之后的变化由 on_insert 按父目录判断
+        std::vector<int> under = query_ids("SELECT id FROM file_info WHERE parent_directory = ?1 OR "
+                                           "substr(parent_directory, 1, length(?2)) = ?2 ORDER BY id",
+                                           {definition.root, definition.root + "/"});
+        std::vector<int> filtered;
+        std::set_intersection(ids.begin(), ids.end(), under.begin(), under.end(), std::back_inserter(filtered));
+        ids.swap(filtered);
+    }
+    return matcher;
+}
+
+std::vector<FileInfo> FileDB::search_files_by_name_prefix(const std::string& prefix, int limit,
+                                                          bool include_hidden) {
+    std::vector<FileInfo> results;
+    if (!is_connected_) return results;
+
+    // 折叠后的前缀作为下界，前缀后接最大码位 U+10FFFF 作为上界，两端都落在索引范围扫描内
+    const std::string lower = unicode_fold(prefix);
+    const std::string upper = lower + "\xF4\x8F\xBF\xBF";
+
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+
+    // 隐藏路径在 SQL 中排除，LIMIT 只计可见的记录
+    sqlite3_stmt* stmt = get_prepared_statement(
+        std::string("SELECT * FROM file_info WHERE file_name_folded >= ? AND file_name_folded < ? ") +
+        (include_hidden ? "" : "AND instr(file_path, '/.') = 0 ") +
+        "ORDER BY file_name_folded LIMIT ?");
+    if (!stmt) {
+        return results;
+    }
+
+    sqlite3_bind_text(stmt, 1, lower.c_str(), static_cast<int>(lower.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, upper.c_str(), static_cast<int>(upper.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        results.push_back(read_file_info(stmt));
+    }
+
+    sqlite3_reset(stmt);
+    return results;
+}
+
 std::vector<FileInfo> FileDB::get_files_by_parent_directory(const std::string& parent_directory) {    
     std::vector<FileInfo> results;
     const std::string sql = "SELECT * FROM file_info WHERE parent_directory = ?";
@@ -561,16 +1098,21 @@ std::vector<FileInfo> FileDB::get_files_by_parent_directory(const std::string& p
 bool FileDB::batch_delete_files(const std::vector<std::string>& file_paths) {
     if (file_paths.empty()) return true;
 
-    std::lock_guard<std::mutex> lock(operation_mutex_);
-    
-    std::string sql = "DELETE FROM file_info WHERE file_path IN (";
+    // execute_sql_with_params 内部会加 operation_mutex_，这里不能重复加锁
+    std::string placeholders;
     for (size_t i = 0; i < file_paths.size(); ++i) {
-        sql += "?";
-        if (i < file_paths.size() - 1) sql += ",";
+        placeholders += "?";
+        if (i < file_paths.size() - 1) placeholders += ",";
+    }
+    std::string sql = "DELETE FROM file_info WHERE file_path IN (" + placeholders + ")";
+
+    std::vector<int> ids;
+    if (name_index_ || pinyin_index_ || token_index_ || standing_queries_) {
+        ids = query_ids("SELECT id FROM file_info WHERE file_path IN (" + placeholders + ")", file_paths);
     }
-    sql += ")";
     
     if (execute_sql_with_params(sql, file_paths)) {
+        index_remove(ids);
         std::cout << "批量删除文件成功，数量: " << file_paths.size() << std::endl;
         return true;
     }
@@ -621,6 +1163,18 @@ bool FileDB::clear_database() {
     const std::string sql = "DELETE FROM file_info";
     
     if (execute_sql(sql)) {
+        if (name_index_) {
+            name_index_->clear();
+        }
+        if (pinyin_index_) {
+            pinyin_index_->clear();
+        }
+        if (token_index_) {
+            token_index_->clear();
+        }
+        if (standing_queries_) {
+            standing_queries_->on_clear();
+        }
         std::cout << "数据库已清空" << std::endl;
         return true;
     }
@@ -642,9 +1196,23 @@ std::string FileDB::start_search_task(const std::string& search_term,
                                      const std::string& search_field,
                                      int &max_file_count,
                                      int limit,
-                                     bool include_hidden) {
+                                     bool include_hidden,
+                                     bool* refined) {
+    return create_search_task(search_term, search_field, max_file_count, limit, include_hidden, refined, false);
+}
+
+std::string FileDB::create_search_task(const std::string& search_term,
+                                      const std::string& search_field,
+                                      int& max_file_count,
+                                      int limit,
+                                      bool include_hidden,
+                                      bool* refined,
+                                      bool nested) {
+    // pinyin 表示文件名或其拼音检索键匹配均可，regex 表示按正则表达式匹配文件名，fuzzy 表示模糊匹配文件名，
+    // ranked 与 file_name 匹配规则相同，但按相关度返回前 k 个
     std::vector<std::string> valid_fields = {
-        "file_name", "file_path", "file_extension", "mime_type", "parent_directory"
+        "file_name", "file_path", "file_extension", "mime_type", "parent_directory", "pinyin", "regex", "fuzzy",
+        "ranked"
     };
 
     if (std::find(valid_fields.begin(), valid_fields.end(), search_field) == valid_fields.end()) {
@@ -656,28 +1224,131 @@ std::string FileDB::start_search_task(const std::string& search_term,
 
     next_task_id_++;
 
-    auto task = std::make_unique<SearchTask>();
+    auto task = std::make_shared<SearchTask>();
     task->task_id = task_id;
-    task->search_term = convertWithBracketSyntax(search_term);
+    task->nested = nested;
+    // 单次查询的时间上限从创建任务时开始计算，覆盖求匹配与之后的各批
+    const int time_limit_ms = get_query_time_limit_ms();
+    if (time_limit_ms > 0) {
+        task->deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_limit_ms);
+    }
+    // 文件名按折叠列比较，模式也要折叠
+    const bool by_name = search_field == "file_name" || search_field == "pinyin" || search_field == "ranked";
+    task->search_term = by_name ? unicode_fold(search_term) : search_term;
     task->search_field = search_field;
     task->limit = limit;  // 总限制，-1表示无限制
     task->include_hidden = include_hidden;
-    task->pattern = "%" + task->search_term + "%";
+    // 折叠过的列与折叠后的模式直接比较，其他列与原来的 LIKE 一样按 ASCII 大小写不敏感
+    task->glob = GlobPattern::compile(NameMatcher::substring_glob(task->search_term), !by_name);
+    // 文件名搜索支持 ext: type: size: modified: 过滤条件，值非法时 parse_search_query 抛出 std::invalid_argument
+    SearchQuery query;
+    if (search_field == "file_name") {
+        query = parse_search_query(search_term);
+    }
+    if (search_field == "ranked" && !name_index_) {
+        throw std::invalid_argument("按相关度排序需要文件名索引");
+    }
+    // 求匹配时执行的语句同样受时间上限约束，超时的结果不完整，不能作为任务的匹配集合
+    QueryInterruptScope interrupt(&task->cancel_requested, task->deadline);
+    if (!query.filters.empty()) {
+        // 按查询计划一次求出全部匹配，之后各批直接切片；结果不进缓存，缓存的键只包含文件名模式
+        task->matcher = compile_name_query(query.text);
+        task->matches = execute_query_plan(query, *task->matcher, include_hidden);
+    } else if (search_field == "fuzzy") {
+        // 模糊匹配需要给每个名字打分，只能在内存索引上执行
+        if (!name_index_) {
+            throw std::invalid_argument("模糊搜索需要文件名索引");
+        }
+        task->fuzzy = std::make_shared<FuzzyMatcher>(search_term);
+    } else if (search_field == "regex") {
+        // 正则只能在内存索引上执行，模式非法时 RegexMatcher 抛出 std::invalid_argument
+        if (!name_index_) {
+            throw std::invalid_argument("正则搜索需要文件名索引");
+        }
+        task->matcher = std::make_shared<RegexMatcher>(search_term);
+
+        // 必须出现的字面量可以用倒排表预筛选；结果不进缓存，模式间的子串关系对正则不成立
+        auto candidates = std::make_shared<std::vector<int>>();
+        if (name_index_->find_candidates(*task->matcher, *candidates)) {
+            task->candidates = candidates;
+        }
+    } else if (search_field == "pinyin" && name_index_ && pinyin_index_) {
+        task->matcher = std::make_shared<NameMatcher>(search_term);
+        task->matches = search_pinyin(*task->matcher, include_hidden);
+    } else if (by_name && name_index_) {
+        task->matcher = compile_name_query(search_term);
+
+        // 多词查询由最有选择性的子句给出候选，其余子句只做校验
+        auto candidates = std::make_shared<std::vector<int>>();
+        if (name_index_->find_candidates(*task->matcher, *candidates)) {
+            task->candidates = candidates;
+        }
+        task->parallelism = get_search_parallelism();
+        // 多词查询不进缓存：取反的词让“模式是子串则结果是子集”不再成立，不能用于细化
+        if (!std::dynamic_pointer_cast<BooleanMatcher>(task->matcher)) {
+            // ranked 的匹配集合与 file_name 相同，共用缓存
+            task->cache_key = SearchCache::make_key(search_term, search_field == "ranked" ? "file_name" : search_field,
+                                                    include_hidden);
+            task->generation = name_index_->generation();
+            task->matches = lookup_search_cache(*task);
+            task->cacheable = !task->matches && limit <= 0;
+        }
+    }
+    if (QueryInterruptScope::should_interrupt()) {
+        throw std::runtime_error("搜索超过查询时间上限");
+    }
     task->created_time = std::chrono::system_clock::now();
     task->status = SearchStatus::PENDING;
     task->total_results = 0;
     
     // 获取当前最大ID，用于判断搜索范围
     task->current_min_id = 1;
-    task->max_id = get_max_id();
+    if (task->matches || task->fuzzy) {
+        // 命中缓存时不访问数据库
+        task->max_id = name_index_ ? name_index_->max_id() : 0;
+        if (task->matches && !task->matches->empty()) {
+            task->max_id = std::max(task->max_id, task->matches->back());
+        }
+    } else {
+        task->max_id = get_max_id();
+    }
 
-    max_file_count = task->max_id;
-    
+    task->total_rows = count_rows(1, task->max_id);
+    if (task->matches && !task->fuzzy && task->search_field != "ranked") {
+        // 匹配已经全部求出（命中缓存、拼音或带过滤条件的搜索）
+        task->estimated_matches = static_cast<int>(task->matches->size());
+        if (task->limit > 0) {
+            task->estimated_matches = std::min(task->estimated_matches, task->limit);
+        }
+    }
+
+    // 在共享索引上用相同的参数创建对应的任务
+    int shared_max_file_count = 0;
     {
         std::lock_guard<std::mutex> lock(task_mutex_);
-        search_tasks_[task_id] = std::move(task);
+        task->shared_db = shared_db_;
+        task->access_checker = access_checker_;
+    }
+    if (task->shared_db) {
+        try {
+            task->shared_task_id = task->shared_db->create_search_task(search_term, search_field,
+                                                                       shared_max_file_count, limit,
+                                                                       include_hidden, nullptr, true);
+        } catch (const std::exception& e) {
+            std::cerr << "共享索引创建搜索任务失败: " << e.what() << std::endl;
+            task->shared_db.reset();
+            shared_max_file_count = 0;
+        }
+    }
+
+    max_file_count = task->max_id + shared_max_file_count;
+    if (refined) {
+        *refined = task->refined;
     }
     
+    task->memory_bytes = estimate_task_bytes(*task);
+    search_tasks_.add(task);
+    
     return task_id;
 }
 
@@ -685,126 +1356,258 @@ std::vector<FileInfo> FileDB::get_search_batch(const std::string& task_id,
                                               int batch_size) {
     std::vector<FileInfo> results;
     
-    std::unique_ptr<SearchTask> task;
-    {
-        std::lock_guard<std::mutex> lock(task_mutex_);
-        auto it = search_tasks_.find(task_id);
-        if (it == search_tasks_.end()) {
-            std::cerr << "任务不存在: " << task_id << std::endl;
-            return results;
-        }
-        task = std::move(it->second);
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        std::cerr << "任务不存在: " << task_id << std::endl;
+        return results;
+    }
+    // 同一任务的并发请求依次执行，后来的请求从前一批的游标处继续；后台正在预取时等它算完
+    std::unique_lock<std::mutex> task_lock = lock_task(*task);
+
+    if (!task->prefetched.empty() && !task->cancel_requested) {
+        // 直接交出预取好的一批，对外的进度随之前进到这一批
+        results = std::move(task->prefetched.front().files);
+        task->delivered_progress = task->prefetched.front().progress;
+        task->prefetched.pop_front();
+        task->prefetch_stats.batches_served++;
+    } else {
+        const auto start = std::chrono::steady_clock::now();
+        results = compute_search_batch(task, batch_size);
+        task->prefetch_stats.foreground_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (task->status == SearchStatus::PENDING || task->status == SearchStatus::RUNNING) {
+        schedule_prefetch(task, batch_size);
+    } else if (task->prefetched.empty()) {
+        finish_prefetch(*task);
     }
+    return results;
+}
+
+std::vector<FileInfo> FileDB::compute_search_batch(const std::shared_ptr<SearchTask>& task, int batch_size) {
+    std::vector<FileInfo> results;
+    const std::string& task_id = task->task_id;
+
+    // 一批结束：私有数据库中的匹配取完后转入共享索引阶段，
+    // 被取消或超过时间上限的任务以 CANCELLED 结束
+    auto save_task = [&]() {
+        enter_shared_stage(*task);
+        if (task->status == SearchStatus::PENDING || task->status == SearchStatus::RUNNING) {
+            if (task->cancel_requested) {
+                task->status = SearchStatus::CANCELLED;
+            } else if (std::chrono::steady_clock::now() >= task->deadline) {
+                task->status = SearchStatus::CANCELLED;
+                task->timed_out = true;
+                std::cerr << "搜索超过查询时间上限: " << task_id << ", 已返回 " << task->total_results << " 条" << std::endl;
+            }
+        }
+        if (task->status == SearchStatus::COMPLETED && !task->completion_counted) {
+            task->completion_counted = true;
+            search_tasks_.mark_completed();
+        }
+        task->memory_bytes = estimate_task_bytes(*task);
+    };
+
+    // 取消或超时后，连接上的进度回调中断这一批正在执行的语句，尽快释放 operation_mutex_
+    QueryInterruptScope interrupt(&task->cancel_requested, task->deadline);
     
     if (task->status == SearchStatus::CANCELLED) {
         std::cerr << "任务已取消" << std::endl;
+        save_task();
         return results;
     }
     
     if (task->status == SearchStatus::COMPLETED) {
         std::cerr << "任务已完成" << std::endl;
+        save_task();
+        return results;
+    }
+
+    if (QueryInterruptScope::should_interrupt()) {
+        save_task();
+        return results;
+    }
+
+    if (task->serving_shared) {
+        results = get_shared_batch(*task, batch_size);
+        save_task();
+        return results;
+    }
+
+    if (task->sort.key != SortKey::NONE) {
+        // 按指定的键排序返回，共享索引中的匹配一起参与排序
+        const int from_id = task->current_min_id;
+        results = get_sorted_batch(*task, batch_size);
+        update_progress(*task, from_id);
+        save_task();
+        return results;
+    }
+
+    if (task->fuzzy || task->search_field == "ranked") {
+        // 模糊搜索按得分、ranked 按相关度而不是 id 顺序返回
+        const int from_id = task->current_min_id;
+        results = task->fuzzy ? get_fuzzy_batch(*task, batch_size) : get_ranked_batch(*task, batch_size);
+        update_progress(*task, from_id);
+        save_task();
         return results;
     }
     
     // 检查是否还有需要查询的范围
     if (task->current_min_id > task->max_id) {
         task->status = SearchStatus::COMPLETED;
+        save_task();
         return results;
     }
     
     // 检查是否达到总限制
     if (task->limit > 0 && task->total_results >= task->limit) {
         task->status = SearchStatus::COMPLETED;
+        save_task();
         return results;
     }
     
     task->status = SearchStatus::RUNNING;
+    const int from_id = task->current_min_id;
     
     if (!is_connected_) {
         task->status = SearchStatus::ERROR;
+        save_task();
         return results;
     }
     
-    std::lock_guard<std::mutex> lock(operation_mutex_);
-    
     try {
-        // 计算本次查询的实际ID范围
-        int current_max_id = task->current_min_id + batch_size - 1;
-        if (current_max_id > task->max_id) {
-            current_max_id = task->max_id;
-        }
-        
         // 计算本次最多返回多少条（考虑总限制）
         int max_return = batch_size;
         if (task->limit > 0) {
             int remaining = task->limit - task->total_results;
             max_return = std::min(batch_size, remaining);
         }
-        
-        // 构建SQL：按ID范围查询
-        std::string sql = "SELECT * FROM file_info WHERE "
-                         "id BETWEEN ? AND ? AND "
-                         + task->search_field + " LIKE ? ";
-        if (!task->include_hidden) {
-            sql += "AND file_path NOT LIKE '%/.%' ";
-        }
-        sql += "LIMIT ?";
-        
-        sqlite3_stmt* stmt;
-        int rc = sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr);
-        
-        if (rc != SQLITE_OK) {
-            std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
-            task->status = SearchStatus::ERROR;
-            return results;
-        }
-        
-        // 绑定参数
-        sqlite3_bind_int(stmt, 1, task->current_min_id);      // 起始ID
-        sqlite3_bind_int(stmt, 2, current_max_id);            // 结束ID
-        sqlite3_bind_text(stmt, 3, task->pattern.c_str(), -1, SQLITE_TRANSIENT);  // 搜索条件
-        sqlite3_bind_int(stmt, 4, max_return);                // 返回限制
-        
-        // 执行查询并获取数据
+
+        // 从游标处继续，找到 max_return 条或者用完时间预算就结束这一批，
+        // last_id 为这一批检查过的最后一个 id，id 稀疏与否不影响每批的耗时
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(SEARCH_BATCH_TIME_LIMIT_MS);
+        int last_id = task->max_id;
+
         int count = 0;
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            FileInfo file_info;
-            file_info.id = sqlite3_column_int(stmt, 0);
-            file_info.file_path = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 1));
-            file_info.file_name = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 2));
-            file_info.modified_time = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 3));
-            file_info.created_time = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 4));
-            file_info.file_extension = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 5));
-            file_info.mime_type = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 6));
-            file_info.is_directory = sqlite3_column_int(stmt, 7);
-            file_info.parent_directory = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 8));
-            file_info.last_scanned_time = reinterpret_cast<const char*>(
-                sqlite3_column_text(stmt, 9));
-            file_info.scan_count = sqlite3_column_int(stmt, 10);
+        if (task->matcher) {
+            // 文件名搜索：先在内存索引中找出匹配的 id，再回表取完整记录
+            if (task->facets_requested && !task->facets) {
+                compute_facets(*task);
+            }
+            if (task->parallelism > 1) {
+                resolve_matches(*task);
+            }
+
+            std::vector<int> ids;
+            if (task->matches) {
+                auto begin = std::lower_bound(task->matches->begin(), task->matches->end(),
+                                              task->current_min_id);
+                auto end = task->matches->end();
+                if (end - begin > max_return) {
+                    end = begin + max_return;
+                    last_id = *(end - 1);
+                }
+                ids.assign(begin, end);
+            } else {
+                // 每批限定扫描时间，病态的正则也不会长时间占住索引的读锁
+                NameIndex::ScanBudget budget;
+                budget.deadline = std::min(deadline, task->deadline);
+                budget.cancelled = &task->cancel_requested;
+                name_index_->search(*task->matcher, task->current_min_id, task->max_id,
+                                    task->include_hidden, max_return, ids, task->candidates.get(),
+                                    1, &budget);
+                if (budget.exhausted) {
+                    last_id = budget.resume_id - 1;
+                } else if (static_cast<int>(ids.size()) >= max_return) {
+                    last_id = ids.back();
+                }
+            }
+            if (task->cacheable) {
+                task->collected.insert(task->collected.end(), ids.begin(), ids.end());
+            }
+            results = get_files_by_ids(ids);
+            count = static_cast<int>(results.size());
+        } else {
+            std::lock_guard<std::mutex> lock(operation_mutex_);
+
+            // 构建SQL：按ID窗口查询，rowid 上的范围查找不受 id 空洞影响
+            std::string sql = "SELECT * FROM file_info WHERE "
+                             "id BETWEEN ? AND ? AND " +
+                             match_condition(task->search_field, 3) + " ";
+            if (!task->include_hidden) {
+                sql += "AND instr(file_path, '/.') = 0 ";
+            }
+            sql += "ORDER BY id LIMIT ?";
             
-            results.push_back(file_info);
-            count++;
+            sqlite3_stmt* stmt;
+            int rc = sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr);
+            
+            if (rc != SQLITE_OK) {
+                std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
+                task->status = SearchStatus::ERROR;
+                save_task();
+                return results;
+            }
+
+            // 逐个窗口扫描，窗口之间检查时间预算
+            int window_min_id = task->current_min_id;
+            while (window_min_id <= task->max_id) {
+                const int window_max_id = static_cast<int>(std::min<long long>(
+                    static_cast<long long>(window_min_id) + SQL_SCAN_WINDOW - 1, task->max_id));
+
+                // 绑定参数
+                sqlite3_bind_int(stmt, 1, window_min_id);             // 起始ID
+                sqlite3_bind_int(stmt, 2, window_max_id);             // 结束ID
+                sqlite3_bind_pointer(stmt, 3, const_cast<GlobPattern*>(task->glob.get()),
+                                     GlobPattern::POINTER_TYPE, nullptr);    // 编译好的搜索模式
+                sqlite3_bind_int(stmt, 4, max_return - count);        // 返回限制
+
+                // 执行查询并获取数据
+                while (sqlite3_step(stmt) == SQLITE_ROW) {
+                    results.push_back(read_file_info(stmt));
+                    count++;
+                }
+                sqlite3_reset(stmt);
+
+                if (QueryInterruptScope::should_interrupt()) {
+                    // 语句在窗口中途被中断，已读到的记录按 id 有序，游标停在最后一条之后
+                    last_id = count > 0 && results.back().id >= window_min_id ? results.back().id
+                                                                               : window_min_id - 1;
+                    break;
+                }
+                if (count >= max_return) {
+                    last_id = results.back().id;
+                    break;
+                }
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    last_id = window_max_id;
+                    break;
+                }
+                window_min_id = window_max_id + 1;
+            }
+            
+            sqlite3_finalize(stmt);
         }
         
-        sqlite3_finalize(stmt);
-        
         // 更新任务状态
         task->total_results += count;
         
-        // 移动ID范围指针
-        task->current_min_id = current_max_id + 1;
+        // 移动游标
+        task->current_min_id = last_id + 1;
         
         // 判断任务是否完成
         if (task->current_min_id > task->max_id) {
             // ID范围已遍历完
             task->status = SearchStatus::COMPLETED;
+            if (task->cacheable) {
+                // 以创建任务时的代数保存，期间发生的修改会在下次命中时被修补
+                search_cache_.put(task->cache_key,
+                                  std::make_shared<const std::vector<int>>(std::move(task->collected)),
+                                  task->generation);
+                task->cacheable = false;
+            }
         } else if (task->limit > 0 && task->total_results >= task->limit) {
             // 达到总限制
             task->status = SearchStatus::COMPLETED;
@@ -821,61 +1624,1497 @@ std::vector<FileInfo> FileDB::get_search_batch(const std::string& task_id,
         std::cerr << "搜索过程中出错: " << e.what() << std::endl;
         task->status = SearchStatus::ERROR;
     }
+
+    update_progress(*task, from_id);
     
     // 保存任务状态
-    {
-        std::lock_guard<std::mutex> lock(task_mutex_);
-        search_tasks_[task_id] = std::move(task);
-    }
+    save_task();
     
     return results;
 }
 
-// 辅助函数：获取最大ID
-int FileDB::get_max_id() {
-    if (!is_connected_) return 0;
-    
+void FileDB::resolve_matches(SearchTask& task) {
+    if (task.matches) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto matches = std::make_shared<std::vector<int>>();
+    // 排序的任务先求出全部匹配，排好序后再取前 limit 个
+    int remaining = task.limit > 0 && task.sort.key == SortKey::NONE ? task.limit - task.total_results : -1;
+    name_index_->search(*task.matcher, task.current_min_id, task.max_id,
+                        task.include_hidden, remaining, *matches,
+                        task.candidates.get(), task.parallelism);
+    task.matches = matches;
+    if (task.cacheable) {
+        search_cache_.put(task.cache_key, matches, task.generation);
+        task.cacheable = false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "求出全部匹配: " << task.task_id << ", 线程数: " << task.parallelism
+              << ", 匹配数: " << matches->size() << ", 耗时: " << elapsed << "us" << std::endl;
+}
+
+bool FileDB::collect_all_matches(SearchTask& task, std::vector<int>& ids) {
+    if (task.fuzzy || task.search_field == "ranked") {
+        return false;
+    }
+    const int limit = task.sort.key == SortKey::NONE ? task.limit : -1;
+
+    if (task.matcher) {
+        // matches 总是在游标位于开头时求出的，是完整的匹配集合
+        if (!task.matches && task.current_min_id == 1) {
+            resolve_matches(task);
+        }
+        if (task.matches) {
+            ids = *task.matches;
+        } else {
+            name_index_->search(*task.matcher, 1, task.max_id, task.include_hidden, limit, ids,
+                                task.candidates.get(), task.parallelism);
+        }
+        return !QueryInterruptScope::should_interrupt();
+    }
+
+    if (!task.glob || !is_connected_) {
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(operation_mutex_);
-    
+
+    std::string sql = "SELECT id FROM file_info WHERE id <= ? AND " +
+                      match_condition(task.search_field, 2) + " ";
+    if (!task.include_hidden) {
+        sql += "AND instr(file_path, '/.') = 0 ";
+    }
+    sql += "ORDER BY id";
+    if (limit > 0) {
+        sql += " LIMIT " + std::to_string(limit);
+    }
+
     sqlite3_stmt* stmt;
-    int max_id = 0;
-    
-    if (sqlite3_prepare_v2(db_conn_->get(), 
-                          "SELECT MAX(id) FROM file_info", 
-                          -1, &stmt, nullptr) == SQLITE_OK) {
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            max_id = sqlite3_column_int(stmt, 0);
+    if (sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, task.max_id);
+    sqlite3_bind_pointer(stmt, 2, const_cast<GlobPattern*>(task.glob.get()), GlobPattern::POINTER_TYPE, nullptr);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+bool FileDB::collect_shared_matches(SearchTask& task, std::vector<int>& ids) {
+    std::shared_ptr<SearchTask> shared_task;
+    if (task.shared_db) {
+        shared_task = task.shared_db->search_tasks_.find(task.shared_task_id);
+    }
+    if (!shared_task) {
+        return true;
+    }
+    std::vector<int> shared_ids;
+    bool complete;
+    {
+        std::lock_guard<std::mutex> shared_lock(shared_task->mutex);
+        complete = task.shared_db->collect_all_matches(*shared_task, shared_ids);
+    }
+    if (!complete) {
+        return false;
+    }
+
+    // 按父目录的权限过滤，本数据库中已有的路径不再重复
+    std::unordered_map<std::string, bool> listable;
+    for (size_t i = 0; i < shared_ids.size(); i += PLAN_ID_CHUNK) {
+        const std::vector<int> chunk(shared_ids.begin() + i,
+                                     shared_ids.begin() + std::min(shared_ids.size(), i + PLAN_ID_CHUNK));
+        std::vector<FileInfo> visible;
+        std::vector<std::string> paths;
+        for (auto& file : task.shared_db->get_files_by_ids(chunk)) {
+            auto it = listable.find(file.parent_directory);
+            if (it == listable.end()) {
+                it = listable.emplace(file.parent_directory,
+                                      task.access_checker->can_list(file.parent_directory)).first;
+            }
+            if (it->second) {
+                paths.push_back(file.file_path);
+                visible.push_back(std::move(file));
+            }
+        }
+        // 每块只用一条语句查出本数据库中已有的路径
+        const std::unordered_set<std::string> existing = existing_paths(paths);
+        for (const auto& file : visible) {
+            if (existing.count(file.file_path) == 0) {
+                ids.push_back(-file.id);
+            }
+        }
+        if (QueryInterruptScope::should_interrupt()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileDB::materialize_window(SearchTask& task) {
+    auto start = std::chrono::steady_clock::now();
+    QueryInterruptScope interrupt(&task.cancel_requested, task.deadline);
+
+    auto ids = std::make_shared<std::vector<int>>();
+    if (!collect_all_matches(task, *ids)) {
+        return false;
+    }
+    const size_t own = ids->size();
+
+    if (task.limit <= 0 || static_cast<int>(own) < task.limit) {
+        if (!collect_shared_matches(task, *ids)) {
+            return false;
+        }
+        if (task.limit > 0 && static_cast<int>(ids->size()) > task.limit) {
+            ids->resize(task.limit);
+        }
+    }
+
+    // 没有共享索引的部分时与逐批返回共用同一份匹配集合
+    if (ids->size() == own && task.matches && task.matches->size() == own) {
+        task.window_ids = task.matches;
+    } else {
+        task.window_ids = ids;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "随机访问窗口就绪: " << task.task_id << ", 匹配数: " << ids->size()
+              << " (共享索引 " << ids->size() - own << "), 约 " << ids->size() * sizeof(int) / 1024
+              << " KB, 耗时: " << elapsed << "ms" << std::endl;
+    return true;
+}
+
+std::vector<FileInfo> FileDB::get_files_in_order(SearchTask& task, const std::vector<int>& ids) {
+    std::vector<int> own, shared;
+    for (int id : ids) {
+        if (id >= 0) {
+            own.push_back(id);
+        } else {
+            shared.push_back(-id);
+        }
+    }
+    if (shared.empty() || !task.shared_db) {
+        return get_files_by_ids(own);
+    }
+
+    // 两部分分别回表，再按 ids 的顺序合并
+    std::unordered_map<int, FileInfo> own_files, shared_files;
+    for (auto& file : get_files_by_ids(own)) {
+        own_files.emplace(file.id, std::move(file));
+    }
+    for (auto& file : task.shared_db->get_files_by_ids(shared)) {
+        shared_files.emplace(file.id, std::move(file));
+    }
+    std::vector<FileInfo> files;
+    files.reserve(ids.size());
+    for (int id : ids) {
+        auto& found = id >= 0 ? own_files : shared_files;
+        auto it = found.find(id >= 0 ? id : -id);
+        if (it != found.end()) {
+            files.push_back(std::move(it->second));
+        }
+    }
+    return files;
+}
+
+bool FileDB::get_search_window(const std::string& task_id, int offset, int count,
+                               std::vector<FileInfo>& files, int& total) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        std::cerr << "任务不存在: " << task_id << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> task_lock(task->mutex);
+
+    if (!task->window_ids) {
+        // 排序的任务按排序后的顺序取窗口，与逐批返回共用同一份 id
+        const bool ready = task->sort.key != SortKey::NONE ? (task->sorted || sort_matches(*task))
+                                                           : materialize_window(*task);
+        if (!ready) {
+            if (!task->cancel_requested && std::chrono::steady_clock::now() >= task->deadline) {
+                task->timed_out = true;
+            }
+            return false;
+        }
+        if (task->sort.key != SortKey::NONE) {
+            task->window_ids = task->sorted;
+        }
+        task->memory_bytes = estimate_task_bytes(*task);
+    }
+
+    const std::vector<int>& ids = *task->window_ids;
+    total = static_cast<int>(ids.size());
+    const size_t begin = std::min(static_cast<size_t>(std::max(offset, 0)), ids.size());
+    const size_t end = std::min(begin + static_cast<size_t>(std::max(count, 0)), ids.size());
+    files = get_files_in_order(*task, std::vector<int>(ids.begin() + begin, ids.begin() + end));
+    return true;
+}
+
+bool FileDB::set_task_sort(const std::string& task_id, const SearchSort& sort) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        return false;
+    }
+    std::lock_guard<std::mutex> task_lock(task->mutex);
+    // 模糊搜索与按相关度排序的搜索有自己的顺序；已经开始返回结果的任务不能再改变顺序
+    if (task->fuzzy || task->search_field == "ranked" || task->current_min_id > 1 || task->window_ids) {
+        return false;
+    }
+    task->sort = sort;
+    // 共享索引中的子任务同样不受 limit 限制，由本任务排序后统一截取
+    if (task->shared_db) {
+        task->shared_db->set_task_sort(task->shared_task_id, sort);
+    }
+    return true;
+}
+
+bool FileDB::sort_matches(SearchTask& task) {
+    auto start = std::chrono::steady_clock::now();
+    QueryInterruptScope interrupt(&task.cancel_requested, task.deadline);
+
+    std::vector<int> ids;
+    if (!collect_all_matches(task, ids)) {
+        return false;
+    }
+    const size_t own = ids.size();
+    if (!collect_shared_matches(task, ids)) {
+        return false;
+    }
+
+    auto sorted = std::make_shared<std::vector<int>>();
+    // 索引只覆盖本数据库，自然顺序没有对应的索引
+    const bool scan_index = ids.size() == own && task.sort.key != SortKey::NATURAL &&
+                            static_cast<long long>(own) * SORT_INDEX_SCAN_RATIO > task.total_rows;
+    if (scan_index) {
+        if (!scan_sort_index(task, ids, *sorted)) {
+            return false;
+        }
+    } else {
+        std::vector<SortValue> values;
+        values.reserve(ids.size());
+        if (!fetch_sort_values(std::vector<int>(ids.begin(), ids.begin() + own), task.sort.key, values)) {
+            return false;
+        }
+        if (ids.size() > own) {
+            // 共享索引中的 id 按升序取键值，之后恢复为相反数
+            const size_t shared_from = values.size();
+            std::vector<int> shared_ids;
+            shared_ids.reserve(ids.size() - own);
+            for (size_t i = own; i < ids.size(); ++i) {
+                shared_ids.push_back(-ids[i]);
+            }
+            if (!task.shared_db->fetch_sort_values(shared_ids, task.sort.key, values)) {
+                return false;
+            }
+            for (size_t i = shared_from; i < values.size(); ++i) {
+                values[i].id = -values[i].id;
+            }
+        }
+
+        // 键相同时本数据库的记录在前，再按 id；降序时整个顺序反过来，与索引遍历的 ORDER BY ... DESC, id DESC 一致
+        const SortKey key = task.sort.key;
+        auto compare = [key](const SortValue& a, const SortValue& b) {
+            int c;
+            if (key == SortKey::SIZE) {
+                c = a.number < b.number ? -1 : (a.number > b.number ? 1 : 0);
+            } else if (key == SortKey::NATURAL) {
+                c = compare_natural(a.text, b.text);
+            } else {
+                c = a.text.compare(b.text);
+            }
+            if (c != 0) {
+                return c;
+            }
+            if ((a.id < 0) != (b.id < 0)) {
+                return a.id < 0 ? 1 : -1;
+            }
+            return std::abs(a.id) < std::abs(b.id) ? -1 : (std::abs(a.id) > std::abs(b.id) ? 1 : 0);
+        };
+        const bool descending = task.sort.descending;
+        auto less = [&compare, descending](const SortValue& a, const SortValue& b) {
+            const int c = compare(a, b);
+            return descending ? c > 0 : c < 0;
+        };
+        if (task.limit > 0 && values.size() > static_cast<size_t>(task.limit)) {
+            std::partial_sort(values.begin(), values.begin() + task.limit, values.end(), less);
+            values.resize(task.limit);
+        } else {
+            std::sort(values.begin(), values.end(), less);
+        }
+        sorted->reserve(values.size());
+        for (const auto& value : values) {
+            sorted->push_back(value.id);
+        }
+    }
+    task.sorted = sorted;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "排序完成: " << task.task_id << ", 排序列: " << sort_column(task.sort.key)
+              << (task.sort.key == SortKey::NATURAL ? " (自然顺序)" : "")
+              << (task.sort.descending ? " 降序" : " 升序") << ", 匹配数: " << sorted->size()
+              << " (共享索引 " << ids.size() - own << "), 方式: " << (scan_index ? "索引遍历" : "内存排序")
+              << ", 耗时: " << elapsed << "ms" << std::endl;
+    return true;
+}
+
+bool FileDB::scan_sort_index(SearchTask& task, const std::vector<int>& ids, std::vector<int>& sorted) {
+    if (ids.empty()) {
+        return true;
+    }
+    // ids 升序，最后一个就是最大的 id
+    std::vector<bool> wanted(static_cast<size_t>(ids.back()) + 1, false);
+    for (int id : ids) {
+        wanted[id] = true;
+    }
+    size_t wanted_count = ids.size();
+    if (task.limit > 0) {
+        wanted_count = std::min(wanted_count, static_cast<size_t>(task.limit));
+    }
+    sorted.reserve(wanted_count);
+
+    // 只读索引本身（id 即 rowid），按 (键, id) 有序，不需要排序；找齐全部匹配后提前结束。
+    // 按键集分页，每页只持有一次 operation_mutex_，两页之间写入和其他查询可以进行。
+    // SQLite 3.22 不支持 (col, id) > (?, ?) 这样的行值比较，拆成两步：先取与上一页最后一行键相同、
+    // id 更靠后的行，不够一页再取键更靠后的行。NULL 升序时排在最前，降序时排在最后，单独处理
+    const std::string column = sort_column(task.sort.key);
+    const bool descending = task.sort.descending;
+    const std::string direction = descending ? " DESC" : "";
+    const std::string select = "SELECT id, " + column + " FROM file_info ";
+    const std::string order = " ORDER BY " + column + direction + ", id" + direction + " LIMIT ?3";
+    const std::string first_sql = select + order;
+    const std::string same_key_sql = select + "WHERE " + column + " IS ?1 AND id " + (descending ? "<" : ">") +
+                                     " ?2 ORDER BY id" + direction + " LIMIT ?3";
+    const std::string next_key_sql = select + "WHERE " + column + (descending ? " < ?1" : " > ?1") + order;
+    const std::string after_null_sql = select + "WHERE " + column + " IS NOT NULL" + order;
+    const std::string nulls_sql = select + "WHERE " + column + " IS NULL" + order;
+
+    std::unique_ptr<sqlite3_value, void (*)(sqlite3_value*)> last_key(nullptr, sqlite3_value_free);
+    int last_id = 0;
+    bool started = false;
+
+    // 执行一步，返回读到的行数，出错返回 -1
+    auto run = [&](const std::string& sql, int limit) -> int {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
+            return -1;
+        }
+        if (last_key) {
+            sqlite3_bind_value(stmt, 1, last_key.get());
+        }
+        sqlite3_bind_int(stmt, 2, last_id);
+        sqlite3_bind_int(stmt, 3, limit);
+        int count = 0;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const int id = sqlite3_column_int(stmt, 0);
+            count++;
+            last_id = id;
+            last_key.reset(sqlite3_value_dup(sqlite3_column_value(stmt, 1)));
+            // 翻页之间记录的键可能被修改而再次出现，取过的不再取
+            if (id >= 0 && static_cast<size_t>(id) < wanted.size() && wanted[id] && sorted.size() < wanted_count) {
+                wanted[id] = false;
+                sorted.push_back(id);
+            }
         }
         sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE ? count : -1;
+    };
+
+    while (sorted.size() < wanted_count) {
+        std::lock_guard<std::mutex> lock(operation_mutex_);
+        int fetched;
+        if (!started) {
+            started = true;
+            fetched = run(first_sql, SORT_INDEX_SCAN_CHUNK);
+        } else {
+            const bool null_key = sqlite3_value_type(last_key.get()) == SQLITE_NULL;
+            fetched = run(same_key_sql, SORT_INDEX_SCAN_CHUNK);
+            if (fetched >= 0 && fetched < SORT_INDEX_SCAN_CHUNK) {
+                int more = 0;
+                if (!null_key) {
+                    more = run(next_key_sql, SORT_INDEX_SCAN_CHUNK - fetched);
+                    if (more >= 0 && descending && fetched + more < SORT_INDEX_SCAN_CHUNK) {
+                        // 降序时非 NULL 的键已经取完，接着取 NULL
+                        const int nulls = run(nulls_sql, SORT_INDEX_SCAN_CHUNK - fetched - more);
+                        more = nulls < 0 ? -1 : more + nulls;
+                    }
+                } else if (!descending) {
+                    more = run(after_null_sql, SORT_INDEX_SCAN_CHUNK - fetched);
+                }
+                fetched = more < 0 ? -1 : fetched + more;
+            }
+        }
+        if (fetched < 0) {
+            return false;
+        }
+        if (fetched < SORT_INDEX_SCAN_CHUNK) {
+            break;
+        }
     }
-    
-    return max_id;
+    return true;
 }
 
-// 获取任务状态
-SearchStatus FileDB::get_task_status(const std::string& task_id) {
-    std::lock_guard<std::mutex> lock(task_mutex_);
-    auto it = search_tasks_.find(task_id);
-    if (it == search_tasks_.end()) {
-        return SearchStatus::ERROR;
+bool FileDB::fetch_sort_values(const std::vector<int>& ids, SortKey key, std::vector<SortValue>& values) {
+    if (ids.empty()) {
+        return true;
+    }
+    if ((key == SortKey::NAME || key == SortKey::NATURAL) && name_index_) {
+        // 内存索引中就是折叠后的名字，不访问数据库
+        name_index_->visit_ids(ids, [&values](int id, const char* name, size_t length, int) {
+            SortValue value;
+            value.id = id;
+            value.text.assign(name, length);
+            values.push_back(std::move(value));
+        });
+        return true;
+    }
+    if (!is_connected_) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+
+    sqlite3_stmt* stmt = get_prepared_statement(std::string("SELECT ") + sort_column(key) +
+                                                " FROM file_info WHERE id = ?");
+    if (!stmt) {
+        return false;
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        // 每条语句都很短，不会触发进度回调，由循环检查任务是否已被取消或超时
+        if (i % 64 == 63 && QueryInterruptScope::should_interrupt()) {
+            return false;
+        }
+        sqlite3_bind_int(stmt, 1, ids[i]);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            SortValue value;
+            value.id = ids[i];
+            if (key == SortKey::SIZE) {
+                // 大小未知的排在最前，与沿索引遍历时 NULL 的位置一致
+                value.number = sqlite3_column_type(stmt, 0) == SQLITE_NULL ? -1 : sqlite3_column_int64(stmt, 0);
+            } else {
+                const unsigned char* text = sqlite3_column_text(stmt, 0);
+                value.text = text ? reinterpret_cast<const char*>(text) : "";
+            }
+            values.push_back(std::move(value));
+        }
+        sqlite3_reset(stmt);
     }
-    return it->second->status;
+    return true;
 }
 
-// 取消任务
-bool FileDB::cancel_search_task(const std::string& task_id) {
-    std::lock_guard<std::mutex> lock(task_mutex_);
-    auto it = search_tasks_.find(task_id);
-    if (it == search_tasks_.end()) {
+std::vector<FileInfo> FileDB::get_sorted_batch(SearchTask& task, int batch_size) {
+    std::vector<FileInfo> results;
+
+    if (task.facets_requested && !task.facets) {
+        compute_facets(task);
+    }
+    if (!task.sorted) {
+        if (!sort_matches(task)) {
+            // 被取消或超时时由 save_task 以 CANCELLED 结束
+            if (!QueryInterruptScope::should_interrupt()) {
+                task.status = SearchStatus::ERROR;
+            }
+            return results;
+        }
+        // 整个范围都已检查过
+        task.current_min_id = task.max_id + 1;
+    }
+
+    const std::vector<int>& ids = *task.sorted;
+    const size_t begin = std::min(task.sorted_pos, ids.size());
+    const size_t end = std::min(begin + static_cast<size_t>(std::max(batch_size, 0)), ids.size());
+    results = get_files_in_order(task, std::vector<int>(ids.begin() + begin, ids.begin() + end));
+    task.sorted_pos = end;
+    task.total_results += static_cast<int>(results.size());
+    task.status = end >= ids.size() ? SearchStatus::COMPLETED : SearchStatus::PENDING;
+    return results;
+}
+
+bool FileDB::enable_task_facets(const std::string& task_id, const std::vector<std::string>& roots) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
         return false;
     }
-    
-    it->second->status = SearchStatus::CANCELLED;
+    std::lock_guard<std::mutex> task_lock(task->mutex);
+    // 模糊搜索与按相关度排序的搜索不按 id 顺序返回，SQL 扫描没有可供统计的索引
+    if (!task->matcher || !name_index_ || task->fuzzy || task->search_field == "ranked") {
+        return false;
+    }
+    task->facets_requested = true;
+    task->facet_roots = roots;
     return true;
 }
 
-// 清理任务（手动或自动清理）
-void FileDB::cleanup_task(const std::string& task_id) {
-    std::lock_guard<std::mutex> lock(task_mutex_);
-    search_tasks_.erase(task_id);
-}
\ No newline at end of file
+bool FileDB::take_task_facets(const std::string& task_id, SearchFacets& facets) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        return false;
+    }
+    std::lock_guard<std::mutex> task_lock(task->mutex);
+    if (!task->facets || task->facets_taken) {
+        return false;
+    }
+    facets = *task->facets;
+    task->facets_taken = true;
+    return true;
+}
+
+bool FileDB::count_task_facets(SearchTask& task, NameIndex::FacetCounts& counts) {
+    if (!task.matcher || !name_index_ || task.fuzzy || task.search_field == "ranked") {
+        return false;
+    }
+    // 之后的各批直接从 task.matches 切片，不再重复匹配
+    resolve_matches(task);
+    name_index_->count_facets(*task.matches, counts);
+    return true;
+}
+
+void FileDB::compute_facets(SearchTask& task) {
+    auto start = std::chrono::steady_clock::now();
+    NameIndex::FacetCounts counts;
+    count_task_facets(task, counts);
+
+    // 共享索引中的匹配与 get_shared_batch 返回的一致：只统计有权限看到、且本数据库中没有的记录
+    if (task.shared_db && task.shared_db->name_index_) {
+        std::vector<int> shared;
+        if (collect_shared_matches(task, shared)) {
+            // 共享索引中的 id 以相反数保存
+            for (int& id : shared) {
+                id = -id;
+            }
+            std::sort(shared.begin(), shared.end());
+            task.shared_db->name_index_->count_facets(shared, counts);
+        }
+    }
+
+    // 按数量从多到少取前 limit 个，数量相同时按名字排序，结果与哈希表的遍历顺序无关
+    auto top = [](const std::unordered_map<std::string, size_t>& counted, size_t limit) {
+        std::vector<std::pair<std::string, int>> items;
+        items.reserve(counted.size());
+        for (const auto& item : counted) {
+            items.emplace_back(item.first, static_cast<int>(item.second));
+        }
+        auto order = [](const std::pair<std::string, int>& a, const std::pair<std::string, int>& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        };
+        if (items.size() > limit) {
+            std::partial_sort(items.begin(), items.begin() + limit, items.end(), order);
+            items.resize(limit);
+        } else {
+            std::sort(items.begin(), items.end(), order);
+        }
+        return items;
+    };
+
+    auto facets = std::make_shared<SearchFacets>();
+    facets->files = static_cast<int>(counts.files);
+    facets->directories = static_cast<int>(counts.directories);
+    facets->total = facets->files + facets->directories;
+    facets->extensions = top(counts.extensions, FACET_TOP_EXTENSIONS);
+    facets->parents = top(counts.parents, FACET_TOP_DIRECTORIES);
+
+    // 扫描对象的目录本身或其下任意一层的父目录都算在该扫描对象下
+    std::unordered_map<std::string, size_t> roots;
+    for (const auto& root : task.facet_roots) {
+        if (root.empty()) {
+            continue;
+        }
+        size_t count = 0;
+        for (const auto& parent : counts.parents) {
+            const std::string& dir = parent.first;
+            const bool under = dir.size() > root.size() && dir.compare(0, root.size(), root) == 0 &&
+                               (root.back() == '/' || dir[root.size()] == '/');
+            if (dir == root || under) {
+                count += parent.second;
+            }
+        }
+        if (count > 0) {
+            roots[root] = count;
+        }
+    }
+    facets->roots = top(roots, roots.size());
+    task.facets = facets;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "分面统计完成: " << task.task_id << ", 匹配数: " << facets->total
+              << ", 扩展名: " << counts.extensions.size() << " 种, 父目录: " << counts.parents.size()
+              << " 个, 耗时: " << elapsed << "us" << std::endl;
+}
+
+void FileDB::enter_shared_stage(SearchTask& task) {
+    if (task.status != SearchStatus::COMPLETED || task.serving_shared || !task.shared_db) {
+        return;
+    }
+    // 排序的任务已经把共享索引中的匹配并入 task.sorted
+    if (task.sort.key != SortKey::NONE) {
+        return;
+    }
+    if (task.limit > 0 && task.total_results >= task.limit) {
+        return;
+    }
+    task.serving_shared = true;
+    task.status = SearchStatus::PENDING;
+}
+
+std::vector<FileInfo> FileDB::get_shared_batch(SearchTask& task, int batch_size) {
+    std::vector<FileInfo> results;
+
+    int max_return = batch_size;
+    if (task.limit > 0) {
+        max_return = std::min(batch_size, task.limit - task.total_results);
+    }
+
+    // 只返回调用者有权限看到、且不在自己数据库中的记录
+    std::vector<FileInfo> files = task.shared_db->get_search_batch(task.shared_task_id, max_return);
+    std::vector<std::string> paths;
+    paths.reserve(files.size());
+    for (const auto& file : files) {
+        paths.push_back(file.file_path);
+    }
+    const std::unordered_set<std::string> existing = existing_paths(paths);
+    size_t hidden = 0;
+    for (auto& file : files) {
+        if (!task.access_checker->can_list(file.parent_directory)) {
+            hidden++;
+            continue;
+        }
+        if (existing.count(file.file_path) > 0) {
+            continue;
+        }
+        // id 属于共享索引，与私有数据库中的 id 无关
+        results.push_back(std::move(file));
+    }
+    task.total_results += static_cast<int>(results.size());
+    if (hidden > 0) {
+        std::cout << "共享索引: 过滤无权限的记录 " << hidden << " 条, uid: " << task.access_checker->uid() << std::endl;
+    }
+
+    const SearchStatus shared_status = task.shared_db->get_task_status(task.shared_task_id);
+    if (shared_status == SearchStatus::PENDING || shared_status == SearchStatus::RUNNING) {
+        task.status = SearchStatus::PENDING;
+    } else if (shared_status == SearchStatus::CANCELLED) {
+        // 没有取消本任务时，只有超时会让共享索引中的任务先结束
+        task.status = SearchStatus::CANCELLED;
+        task.timed_out = !task.cancel_requested;
+    } else {
+        task.status = shared_status == SearchStatus::COMPLETED ? SearchStatus::COMPLETED : SearchStatus::ERROR;
+    }
+    if (task.limit > 0 && task.total_results >= task.limit) {
+        task.status = SearchStatus::COMPLETED;
+    }
+    return results;
+}
+
+std::shared_ptr<const std::vector<int>> FileDB::lookup_search_cache(SearchTask& task) {
+    SearchCache::Entry entry;
+    if (!search_cache_.get(task.cache_key, entry)) {
+        if (search_cache_.find_refinable(task.cache_key, entry)) {
+            return refine_search_result(task, entry);
+        }
+        return nullptr;
+    }
+    if (entry.generation == task.generation) {
+        return entry.ids;
+    }
+
+    std::vector<int> changed;
+    uint64_t current = 0;
+    if (!name_index_->changes_since(entry.generation, changed, current)) {
+        return nullptr;     // 修改太多，只能重新搜索
+    }
+
+    // 变化的 id 先从旧结果中去掉，再把其中仍然匹配的按序并回去
+    std::vector<int> rematched;
+    name_index_->search(*task.matcher, 0, INT32_MAX, task.include_hidden, -1, rematched, &changed);
+
+    auto patched = std::make_shared<std::vector<int>>();
+    patched->reserve(entry.ids->size() + rematched.size());
+    std::set_difference(entry.ids->begin(), entry.ids->end(), changed.begin(), changed.end(),
+                        std::back_inserter(*patched));
+    size_t middle = patched->size();
+    patched->insert(patched->end(), rematched.begin(), rematched.end());
+    std::inplace_merge(patched->begin(), patched->begin() + middle, patched->end());
+
+    std::cout << "搜索缓存修补: " << task.search_term << ", 变化记录: " << changed.size()
+              << ", 匹配数: " << patched->size() << std::endl;
+
+    search_cache_.put(task.cache_key, patched, current);
+    return patched;
+}
+
+std::shared_ptr<const std::vector<int>> FileDB::refine_search_result(SearchTask& task,
+                                                                     const SearchCache::Entry& base) {
+    // 没变化的记录只可能在旧结果里匹配，变化过的记录需要重新判断，两者合并作为候选
+    std::vector<int> changed;
+    uint64_t current = 0;
+    if (!name_index_->changes_since(base.generation, changed, current)) {
+        return nullptr;
+    }
+
+    std::vector<int> candidates;
+    candidates.reserve(base.ids->size() + changed.size());
+    std::set_union(base.ids->begin(), base.ids->end(), changed.begin(), changed.end(),
+                   std::back_inserter(candidates));
+
+    auto start = std::chrono::steady_clock::now();
+    auto refined = std::make_shared<std::vector<int>>();
+    name_index_->search(*task.matcher, 0, INT32_MAX, task.include_hidden, -1, *refined, &candidates);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "搜索结果细化: " << task.search_term << ", 候选数: " << candidates.size()
+              << ", 匹配数: " << refined->size() << ", 耗时: " << elapsed << "us" << std::endl;
+
+    search_cache_.put(task.cache_key, refined, current);
+    task.refined = true;
+    return refined;
+}
+
+void FileDB::index_insert(int id, const FileInfo& file_info) {
+    if (name_index_) {
+        name_index_->insert(id, file_info.file_name, file_info.is_directory, file_info.parent_directory);
+    }
+    if (pinyin_index_) {
+        if (file_info.file_name_pinyin.empty()) {
+            pinyin_index_->remove(id);     // 改名后可能不再含有汉字
+        } else {
+            pinyin_index_->insert(id, file_info.file_name_pinyin + "/" + file_info.file_name_initials,
+                                  file_info.is_directory, file_info.parent_directory);
+        }
+    }
+    if (token_index_) {
+        token_index_->insert(id, file_info.file_name);
+    }
+    // 在文件名索引更新之后，正在求值的常驻查询结束后再校验这条记录
+    if (standing_queries_) {
+        standing_queries_->on_insert(id, file_info);
+    }
+}
+
+void FileDB::index_remove(const std::vector<int>& ids) {
+    if (name_index_) {
+        name_index_->remove(ids);
+    }
+    if (pinyin_index_) {
+        pinyin_index_->remove(ids);
+    }
+    if (token_index_) {
+        token_index_->remove(ids);
+    }
+    if (standing_queries_) {
+        standing_queries_->on_remove(ids);
+    }
+}
+
+std::string FileDB::match_condition(const std::string& search_field, int param) {
+    const std::string pattern = "anything_match(?" + std::to_string(param) + ", ";
+    if (search_field == "file_name") {
+        return pattern + "file_name_folded)";
+    }
+    if (search_field == "pinyin") {
+        // 三个键分别匹配，锚定的模式对全拼和首字母同样成立
+        return "(" + pattern + "file_name_folded) OR " + pattern + "IFNULL(file_name_pinyin, '')) OR " +
+               pattern + "IFNULL(file_name_initials, '')))";
+    }
+    return pattern + search_field + ")";
+}
+
+std::vector<FileInfo> FileDB::get_fuzzy_batch(SearchTask& task, int batch_size) {
+    std::vector<FileInfo> results;
+
+    if (!is_connected_) {
+        task.status = SearchStatus::ERROR;
+        return results;
+    }
+
+    size_t top_k = FUZZY_TOP_K;
+    if (task.limit > 0) {
+        top_k = std::min(top_k, static_cast<size_t>(task.limit));
+    }
+
+    if (task.current_min_id <= task.max_id) {
+        // 流式扫描，堆中只保留前 k 名，堆顶是其中最差的一个
+        auto start = std::chrono::steady_clock::now();
+        NameIndex::ScanBudget budget;
+        budget.deadline = std::min(start + std::chrono::milliseconds(SEARCH_BATCH_TIME_LIMIT_MS), task.deadline);
+        budget.cancelled = &task.cancel_requested;
+
+        const FuzzyMatcher& fuzzy = *task.fuzzy;
+        auto& top = task.top;
+        name_index_->visit_names(task.current_min_id, task.max_id, task.include_hidden,
+            [&](int id, const char* name, size_t len) {
+                const int score = fuzzy.score(name, len);
+                if (score == FuzzyMatcher::NO_MATCH) {
+                    return;
+                }
+                const std::pair<int, int> entry(score, -id);
+                if (top.size() < top_k) {
+                    top.push_back(entry);
+                    std::push_heap(top.begin(), top.end(), std::greater<std::pair<int, int>>());
+                } else if (entry > top.front()) {
+                    std::pop_heap(top.begin(), top.end(), std::greater<std::pair<int, int>>());
+                    top.back() = entry;
+                    std::push_heap(top.begin(), top.end(), std::greater<std::pair<int, int>>());
+                }
+            }, &budget);
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (budget.exhausted) {
+            // 还没扫描完，这一批没有结果
+            task.current_min_id = budget.resume_id;
+            task.status = SearchStatus::PENDING;
+            std::cout << "模糊搜索扫描中: " << task.task_id << ", 已扫描到 id " << budget.resume_id
+                      << ", 耗时: " << elapsed << "us" << std::endl;
+            return results;
+        }
+
+        task.current_min_id = task.max_id + 1;
+        std::sort(top.begin(), top.end(), std::greater<std::pair<int, int>>());
+        task.ranked.reserve(top.size());
+        for (const auto& entry : top) {
+            task.ranked.push_back(-entry.second);
+        }
+        top.clear();
+        top.shrink_to_fit();
+        std::cout << "模糊搜索扫描完成: " << task.task_id << ", 结果数: " << task.ranked.size()
+                  << ", 耗时: " << elapsed << "us" << std::endl;
+    }
+
+    const size_t take = std::min(static_cast<size_t>(batch_size), task.ranked.size() - task.ranked_pos);
+    std::vector<int> ids(task.ranked.begin() + task.ranked_pos, task.ranked.begin() + task.ranked_pos + take);
+    task.ranked_pos += take;
+
+    results = get_files_by_ids(ids);
+    task.total_results += static_cast<int>(results.size());
+    task.status = task.ranked_pos >= task.ranked.size() ? SearchStatus::COMPLETED : SearchStatus::PENDING;
+    return results;
+}
+
+std::vector<FileInfo> FileDB::get_ranked_batch(SearchTask& task, int batch_size) {
+    std::vector<FileInfo> results;
+
+    if (!is_connected_) {
+        task.status = SearchStatus::ERROR;
+        return results;
+    }
+
+    const NameMatcher& matcher = *task.matcher;
+    // 每一阶段最多再给出的结果数：不超过 RANKED_TOP_K，也不超过任务的总限制
+    auto stage_limit = [&task]() -> size_t {
+        if (task.limit <= 0) {
+            return RANKED_TOP_K;
+        }
+        const size_t remaining = static_cast<size_t>(task.limit) > task.ranked.size()
+                                 ? static_cast<size_t>(task.limit) - task.ranked.size() : 0;
+        return std::min(RANKED_TOP_K, remaining);
+    };
+
+    if (task.ranked_stage == 0) {
+        task.ranked_stage = 1;
+        if (matcher.is_literal() && !matcher.literal().empty()) {
+            // 精确与前缀匹配直接走 file_name_folded 上的索引，第一屏结果不必等全量匹配
+            std::vector<FileInfo> files = search_files_by_name_prefix(matcher.literal(),
+                                                                      static_cast<int>(stage_limit()),
+                                                                      task.include_hidden);
+            append_ranked(task, files);
+        }
+    }
+
+    if (task.ranked_stage == 1 && task.ranked_pos >= task.ranked.size() && stage_limit() == 0) {
+        // 前缀匹配已经凑满总限制
+        task.ranked_stage = 2;
+        task.current_min_id = task.max_id + 1;
+    }
+
+    if (task.ranked_stage == 1 && task.ranked_pos >= task.ranked.size()) {
+        task.ranked_stage = 2;
+        task.current_min_id = task.max_id + 1;
+        auto start = std::chrono::steady_clock::now();
+        const size_t top_k = stage_limit();
+
+        std::shared_ptr<const std::vector<int>> matches = task.matches;
+        if (!matches) {
+            auto found = std::make_shared<std::vector<int>>();
+            name_index_->search(matcher, 1, task.max_id, task.include_hidden, -1, *found,
+                                task.candidates.get(), task.parallelism);
+            matches = found;
+            if (task.cacheable) {
+                search_cache_.put(task.cache_key, matches, task.generation);
+                task.cacheable = false;
+            }
+        }
+
+        // 去掉上一阶段已经给出的结果
+        std::vector<int> returned = task.ranked;
+        std::sort(returned.begin(), returned.end());
+        std::vector<int> rest;
+        std::set_difference(matches->begin(), matches->end(), returned.begin(), returned.end(),
+                            std::back_inserter(rest));
+
+        // 分档与路径深度只需内存索引即可算出，先按它们部分选择出前 k 个，只对这些回表取修改时间
+        std::vector<std::pair<uint32_t, int>> scored;
+        scored.reserve(rest.size());
+        name_index_->visit_ids(rest, [&](int id, const char* name, size_t len, int depth) {
+            const uint32_t key = (static_cast<uint32_t>(relevance_tier(name, len, matcher)) << 16) |
+                                 (0xFFFFu - static_cast<uint32_t>(std::min(depth, 0xFFFF)));
+            scored.push_back({key, -id});
+        });
+        if (scored.size() > top_k) {
+            std::nth_element(scored.begin(), scored.begin() + top_k, scored.end(),
+                             std::greater<std::pair<uint32_t, int>>());
+            scored.resize(top_k);
+        }
+
+        std::vector<int> ids;
+        ids.reserve(scored.size());
+        for (const auto& entry : scored) {
+            ids.push_back(-entry.second);
+        }
+        std::sort(ids.begin(), ids.end());
+        std::vector<FileInfo> files = get_files_by_ids(ids);
+        append_ranked(task, files);
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "相关度排序完成: " << task.task_id << ", 匹配数: " << matches->size()
+                  << ", 返回: " << task.ranked.size() << ", 耗时: " << elapsed << "us" << std::endl;
+    }
+
+    const size_t take = std::min(static_cast<size_t>(batch_size), task.ranked.size() - task.ranked_pos);
+    std::vector<int> ids(task.ranked.begin() + task.ranked_pos, task.ranked.begin() + task.ranked_pos + take);
+    task.ranked_pos += take;
+
+    results = get_files_by_ids(ids);
+    task.total_results += static_cast<int>(results.size());
+    task.status = (task.ranked_stage == 2 && task.ranked_pos >= task.ranked.size())
+                  ? SearchStatus::COMPLETED : SearchStatus::PENDING;
+    return results;
+}
+
+void FileDB::append_ranked(SearchTask& task, std::vector<FileInfo>& files) {
+    // 分档高的在前，同档路径浅的在前，再按修改时间从新到旧
+    struct Ranked {
+        int tier;
+        int depth;
+        const FileInfo* file;
+    };
+
+    std::vector<Ranked> order;
+    order.reserve(files.size());
+    for (const auto& file : files) {
+        const std::string folded = NameMatcher::fold_name(file.file_name);
+        order.push_back({relevance_tier(folded.data(), folded.size(), *task.matcher),
+                         static_cast<int>(std::count(file.file_path.begin(), file.file_path.end(), '/')),
+                         &file});
+    }
+
+    std::sort(order.begin(), order.end(), [](const Ranked& a, const Ranked& b) {
+        if (a.tier != b.tier) {
+            return a.tier > b.tier;
+        }
+        if (a.depth != b.depth) {
+            return a.depth < b.depth;
+        }
+        if (a.file->modified_time != b.file->modified_time) {
+            return a.file->modified_time > b.file->modified_time;
+        }
+        return a.file->id < b.file->id;
+    });
+
+    for (const auto& entry : order) {
+        task.ranked.push_back(entry.file->id);
+    }
+}
+
+std::shared_ptr<const std::vector<int>> FileDB::search_pinyin(const NameMatcher& matcher,
+                                                              bool include_hidden) {
+    // 两个索引各查一遍再合并；拼音索引只收录含汉字的文件名，通常比文件名索引小得多
+    auto start = std::chrono::steady_clock::now();
+    const int parallelism = get_search_parallelism();
+
+    std::vector<int> by_name, by_pinyin, candidates;
+    bool use_candidates = name_index_->find_candidates(matcher, candidates);
+    name_index_->search(matcher, 0, INT32_MAX, include_hidden, -1, by_name,
+                        use_candidates ? &candidates : nullptr, parallelism);
+    const PinyinKeyMatcher pinyin_matcher(matcher);
+    use_candidates = pinyin_index_->find_candidates(pinyin_matcher, candidates);
+    pinyin_index_->search(pinyin_matcher, 0, INT32_MAX, include_hidden, -1, by_pinyin,
+                          use_candidates ? &candidates : nullptr, parallelism);
+
+    auto matches = std::make_shared<std::vector<int>>();
+    matches->reserve(by_name.size() + by_pinyin.size());
+    std::set_union(by_name.begin(), by_name.end(), by_pinyin.begin(), by_pinyin.end(),
+                   std::back_inserter(*matches));
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "拼音搜索完成, 文件名匹配: " << by_name.size() << ", 拼音匹配: " << by_pinyin.size()
+              << ", 耗时: " << elapsed << "us" << std::endl;
+    return matches;
+}
+
+std::shared_ptr<const std::vector<int>> FileDB::execute_query_plan(const SearchQuery& query,
+                                                                   const NameMatcher& matcher,
+                                                                   bool include_hidden) {
+    auto start = std::chrono::steady_clock::now();
+
+    // 全部过滤条件的合取
+    std::string predicates;
+    std::vector<std::string> params;
+    for (const auto& filter : query.filters) {
+        predicates += (predicates.empty() ? "(" : " AND (") + filter.sql + ")";
+        params.insert(params.end(), filter.params.begin(), filter.params.end());
+    }
+
+    // 数据库没有 ANALYZE 统计信息，直接在各自的索引上数一数命中的行数（最多数到 PLAN_PROBE_LIMIT）
+    const QueryFilter* driver = nullptr;
+    int driver_rows = PLAN_PROBE_LIMIT;
+    for (const auto& filter : query.filters) {
+        auto counts = query_ids("SELECT COUNT(*) FROM (SELECT 1 FROM file_info INDEXED BY " + filter.index +
+                                " WHERE " + filter.sql + " LIMIT " + std::to_string(PLAN_PROBE_LIMIT) + ")",
+                                filter.params, false);
+        if (!counts.empty() && (driver == nullptr || counts[0] < driver_rows)) {
+            driver = &filter;
+            driver_rows = counts[0];
+        }
+    }
+
+    // 文件名搜索词能用倒排表缩小到比最好的过滤条件更少的候选，或者过滤条件都没有选择性时，从文件名索引出发
+    const bool has_text = !query.text.empty();
+    std::vector<int> candidates;
+    const bool use_candidates = has_text && name_index_ && name_index_->find_candidates(matcher, candidates);
+    const bool by_name = has_text && name_index_ &&
+                         (driver_rows >= PLAN_PROBE_LIMIT ||
+                          (use_candidates && candidates.size() < static_cast<size_t>(driver_rows)));
+
+    auto matches = std::make_shared<std::vector<int>>();
+    std::string plan;
+    if (by_name) {
+        plan = "文件名索引";
+        std::vector<int> named;
+        name_index_->search(matcher, 0, INT32_MAX, include_hidden, -1, named,
+                            use_candidates ? &candidates : nullptr, get_search_parallelism());
+
+        // 分段用主键校验其余条件
+        for (size_t begin = 0; begin < named.size(); begin += PLAN_ID_CHUNK) {
+            const size_t end = std::min(named.size(), begin + PLAN_ID_CHUNK);
+            std::string sql = "SELECT id FROM file_info WHERE id IN (";
+            std::vector<std::string> chunk_params;
+            for (size_t i = begin; i < end; ++i) {
+                sql += i == begin ? "?" : ", ?";
+                chunk_params.push_back(std::to_string(named[i]));
+            }
+            sql += ") AND " + predicates;
+            chunk_params.insert(chunk_params.end(), params.begin(), params.end());
+
+            auto ids = query_ids(sql, chunk_params, false);
+            matches->insert(matches->end(), ids.begin(), ids.end());
+        }
+    } else {
+        std::string sql = "SELECT id FROM file_info ";
+        if (driver) {
+            plan = driver->index;
+            sql += "INDEXED BY " + driver->index + " ";
+        } else {
+            plan = "全表扫描";
+        }
+        sql += "WHERE " + predicates;
+
+        std::vector<std::string> sql_params = params;
+        if (!name_index_) {
+            // 没有内存索引时文件名与隐藏目录也在 SQL 中判断
+            if (has_text) {
+                sql += " AND anything_match(?, file_name_folded)";
+                sql_params.push_back(NameMatcher::substring_glob(unicode_fold(query.text)));
+            }
+            if (!include_hidden) {
+                sql += " AND instr(file_path, '/.') = 0";
+            }
+        }
+
+        auto ids = query_ids(sql, sql_params, false);
+        std::sort(ids.begin(), ids.end());
+        if (name_index_) {
+            // 过滤条件命中的 id 作为候选，由内存索引校验文件名与隐藏目录
+            name_index_->search(matcher, 0, INT32_MAX, include_hidden, -1, *matches, &ids);
+        } else {
+            *matches = std::move(ids);
+        }
+    }
+    std::sort(matches->begin(), matches->end());
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "过滤搜索完成, 驱动: " << plan << ", 估计行数: " << driver_rows
+              << ", 匹配数: " << matches->size() << ", 耗时: " << elapsed << "us" << std::endl;
+    return matches;
+}
+
+// 辅助函数：查询语句第一列的所有 id
+std::unordered_set<std::string> FileDB::existing_paths(const std::vector<std::string>& paths) {
+    std::unordered_set<std::string> existing;
+    if (!is_connected_ || paths.empty()) return existing;
+
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+
+    for (size_t i = 0; i < paths.size(); i += PLAN_ID_CHUNK) {
+        const size_t count = std::min(PLAN_ID_CHUNK, paths.size() - i);
+        std::string sql = "SELECT file_path FROM file_info WHERE file_path IN (";
+        for (size_t j = 0; j < count; ++j) {
+            sql += j == 0 ? "?" : ",?";
+        }
+        sql += ")";
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << std::endl;
+            sqlite3_finalize(stmt);
+            break;
+        }
+        for (size_t j = 0; j < count; ++j) {
+            const std::string& path = paths[i + j];
+            sqlite3_bind_text(stmt, static_cast<int>(j + 1), path.c_str(), static_cast<int>(path.size()), SQLITE_STATIC);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            existing.emplace(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                             sqlite3_column_bytes(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    return existing;
+}
+
+std::vector<int> FileDB::query_ids(const std::string& sql,
+                                   const std::vector<std::string>& params,
+                                   bool cache_statement) {
+    std::vector<int> ids;
+    if (!is_connected_) return ids;
+
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+
+    sqlite3_stmt* stmt = nullptr;
+    if (cache_statement) {
+        stmt = get_prepared_statement(sql);
+    } else if (sqlite3_prepare_v2(db_conn_->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db_conn_->get()) << " SQL: " << sql << std::endl;
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+    }
+    if (!stmt) {
+        return ids;
+    }
+
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, i + 1, params[i].c_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+
+    if (cache_statement) {
+        sqlite3_reset(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+    return ids;
+}
+
+std::shared_ptr<NameMatcher> FileDB::compile_name_query(const std::string& text) {
+    auto matcher = BooleanMatcher::create(text, [this](const NameMatcher& term) {
+        return name_index_ ? name_index_->estimate_matches(term) : 0;
+    });
+    if (auto boolean = std::dynamic_pointer_cast<BooleanMatcher>(matcher)) {
+        std::cout << "多词查询: " << boolean->describe() << std::endl;
+    }
+    return matcher;
+}
+
+// 辅助函数：按 id 回表取完整记录
+std::vector<FileInfo> FileDB::get_files_by_ids(const std::vector<int>& ids) {
+    std::vector<FileInfo> results;
+    if (!is_connected_ || ids.empty()) return results;
+
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+
+    sqlite3_stmt* stmt = get_prepared_statement("SELECT * FROM file_info WHERE id = ?");
+    if (!stmt) {
+        return results;
+    }
+
+    results.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        // 每条语句都很短，不会触发进度回调，由循环检查任务是否已被取消或超时
+        if (i % 64 == 63 && QueryInterruptScope::should_interrupt()) {
+            break;
+        }
+        const int id = ids[i];
+        sqlite3_bind_int(stmt, 1, id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            results.push_back(read_file_info(stmt));
+        }
+        sqlite3_reset(stmt);
+    }
+
+    return results;
+}
+
+// 辅助函数：获取最大ID
+int FileDB::get_max_id() {
+    if (!is_connected_) return 0;
+    
+    std::lock_guard<std::mutex> lock(operation_mutex_);
+    
+    sqlite3_stmt* stmt;
+    int max_id = 0;
+    
+    if (sqlite3_prepare_v2(db_conn_->get(), 
+                          "SELECT MAX(id) FROM file_info", 
+                          -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            max_id = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    return max_id;
+}
+
+// 辅助函数：统计 id 范围内的有效记录数
+int FileDB::count_rows(int min_id, int max_id) {
+    if (min_id > max_id) {
+        return 0;
+    }
+    if (name_index_) {
+        return static_cast<int>(name_index_->count_range(min_id, max_id));
+    }
+
+    std::vector<int> counts = query_ids("SELECT COUNT(*) FROM file_info WHERE id BETWEEN ? AND ?",
+                                        {std::to_string(min_id), std::to_string(max_id)});
+    return counts.empty() ? 0 : counts[0];
+}
+
+void FileDB::update_progress(SearchTask& task, int from_id) {
+    const int to_id = std::min(task.current_min_id - 1, task.max_id);
+    task.rows_examined = std::min(task.rows_examined + count_rows(from_id, to_id), task.total_rows);
+
+    if (task.sorted) {
+        task.estimated_matches = static_cast<int>(task.sorted->size());
+        return;
+    }
+    if (task.fuzzy || task.search_field == "ranked") {
+        // 排好序的结果就是全部结果；模糊搜索扫描中按堆的大小外推，最多 k 个
+        const bool ranked_ready = task.fuzzy ? task.current_min_id > task.max_id : task.ranked_stage == 2;
+        if (ranked_ready) {
+            task.estimated_matches = static_cast<int>(task.ranked.size());
+        } else if (task.fuzzy && task.rows_examined > 0) {
+            const double rate = static_cast<double>(task.top.size()) / task.rows_examined;
+            size_t top_k = FUZZY_TOP_K;
+            if (task.limit > 0) {
+                top_k = std::min(top_k, static_cast<size_t>(task.limit));
+            }
+            task.estimated_matches = static_cast<int>(std::min<double>(rate * task.total_rows, top_k));
+        }
+        return;
+    }
+
+    if (task.status == SearchStatus::COMPLETED) {
+        task.estimated_matches = task.total_results;
+        return;
+    }
+    if (task.matches) {
+        task.estimated_matches = static_cast<int>(task.matches->size());
+    } else if (task.rows_examined > 0) {
+        // 按已扫描部分的命中率外推到剩余的记录，第一批就能给出估计
+        const double rate = static_cast<double>(task.total_results) / task.rows_examined;
+        double estimate = task.total_results + rate * (task.total_rows - task.rows_examined);
+        if (task.candidates) {
+            // 倒排表给出的候选数是匹配数的上限
+            estimate = std::min(estimate, static_cast<double>(task.candidates->size()));
+        }
+        task.estimated_matches = static_cast<int>(estimate + 0.5);
+    }
+    if (task.limit > 0 && task.estimated_matches > task.limit) {
+        task.estimated_matches = task.limit;
+    }
+}
+
+bool FileDB::get_task_progress(const std::string& task_id, SearchProgress& progress) {
+    std::shared_ptr<SearchTask> found = search_tasks_.find(task_id);
+    if (!found) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock = lock_task(*found);
+    if (!found->prefetched.empty()) {
+        // 后台已经算到了后面，对外只报告已交出的部分
+        progress = found->delivered_progress;
+        return true;
+    }
+    fill_progress(*found, progress);
+    return true;
+}
+
+void FileDB::fill_progress(const SearchTask& task, SearchProgress& progress) {
+    progress.timed_out = task.timed_out;
+    progress.cursor = std::min(task.current_min_id - 1, task.max_id);
+    progress.rows_examined = task.rows_examined;
+    progress.total_rows = task.total_rows;
+    progress.estimated_matches = task.estimated_matches;
+
+    // 加上共享索引中的进度；共享索引的估计未按权限过滤，偏大。排好序的任务已包含共享索引中的匹配
+    SearchProgress shared;
+    if (task.shared_db && !task.sorted && task.shared_db->get_task_progress(task.shared_task_id, shared)) {
+        progress.rows_examined += shared.rows_examined;
+        progress.total_rows += shared.total_rows;
+        if (progress.estimated_matches >= 0 && shared.estimated_matches >= 0) {
+            progress.estimated_matches += shared.estimated_matches;
+        } else {
+            progress.estimated_matches = -1;
+        }
+    }
+    if (task.status == SearchStatus::COMPLETED) {
+        // 全部取完后以实际返回的条数为准
+        progress.estimated_matches = task.total_results;
+    }
+}
+
+void FileDB::schedule_prefetch(const std::shared_ptr<SearchTask>& task, int batch_size) {
+    // 共享索引中的子任务由父任务的预取带着往前走，不单独预取
+    if (task->nested || task->cancel_requested || task->prefetch_running ||
+        task->prefetched.size() >= SEARCH_PREFETCH_DEPTH) {
+        return;
+    }
+    task->prefetch_batch_size = batch_size;
+    task->prefetch_running = true;
+    prefetch_executor_.post([this, task]() { prefetch_batches(task); });
+}
+
+void FileDB::prefetch_batches(const std::shared_ptr<SearchTask>& task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    // 没有找到匹配的批也算一轮，持锁的时间不超过 SEARCH_PREFETCH_DEPTH 批的时间预算
+    for (size_t round = 0; round < SEARCH_PREFETCH_DEPTH && task->prefetched.size() < SEARCH_PREFETCH_DEPTH &&
+                           !task->cancel_requested &&
+                           (task->status == SearchStatus::PENDING || task->status == SearchStatus::RUNNING);
+         round++) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<FileInfo> files = compute_search_batch(task, task->prefetch_batch_size);
+        task->prefetch_stats.background_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (files.empty()) {
+            // 时间预算内没有找到匹配的一批不必保留，游标已经前进
+            continue;
+        }
+
+        SearchTask::PrefetchedBatch batch;
+        batch.files = std::move(files);
+        fill_progress(*task, batch.progress);
+        task->prefetched.push_back(std::move(batch));
+        task->prefetch_stats.batches_prefetched++;
+    }
+    task->prefetch_running = false;
+}
+
+void FileDB::finish_prefetch(SearchTask& task) {
+    SearchPrefetchStats& stats = task.prefetch_stats;
+    stats.batches_discarded += task.prefetched.size();
+    task.prefetched.clear();
+    if (stats.batches_prefetched == 0) {
+        return;
+    }
+
+    const uint64_t overlapped_us = stats.background_us > stats.wait_us ? stats.background_us - stats.wait_us : 0;
+    std::cout << "搜索预取: " << task.task_id << ", 预取 " << stats.batches_prefetched << " 批, 交出 "
+              << stats.batches_served << " 批, 丢弃 " << stats.batches_discarded << " 批, 后台计算 "
+              << stats.background_us / 1000 << "ms, 其中与请求重叠 " << overlapped_us / 1000
+              << "ms, 前台计算 " << stats.foreground_us / 1000 << "ms" << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(prefetch_stats_mutex_);
+        prefetch_totals_.batches_prefetched += stats.batches_prefetched;
+        prefetch_totals_.batches_served += stats.batches_served;
+        prefetch_totals_.batches_discarded += stats.batches_discarded;
+        prefetch_totals_.background_us += stats.background_us;
+        prefetch_totals_.foreground_us += stats.foreground_us;
+        prefetch_totals_.wait_us += stats.wait_us;
+    }
+    stats = SearchPrefetchStats();
+}
+
+SearchPrefetchStats FileDB::get_prefetch_stats() {
+    std::lock_guard<std::mutex> lock(prefetch_stats_mutex_);
+    return prefetch_totals_;
+}
+
+void FileDB::set_shared_index(std::shared_ptr<FileDB> shared_db, std::shared_ptr<AccessChecker> checker) {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    shared_db_ = shared_db;
+    access_checker_ = checker;
+}
+
+bool FileDB::has_shared_index() {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    return shared_db_ != nullptr;
+}
+
+// 获取任务状态
+SearchStatus FileDB::get_task_status(const std::string& task_id) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        return SearchStatus::ERROR;
+    }
+    std::unique_lock<std::mutex> lock = lock_task(*task);
+    if (!task->prefetched.empty() && !task->cancel_requested) {
+        // 还有预取好的批没有交出
+        return SearchStatus::RUNNING;
+    }
+    return task->status;
+}
+
+// 取消任务
+bool FileDB::cancel_search_task(const std::string& task_id) {
+    std::shared_ptr<SearchTask> task = search_tasks_.find(task_id);
+    if (!task) {
+        return false;
+    }
+
+    // 先置位取消标志，正在执行的一批会在进度回调或下一次检查时停下，不用等它跑完这一批
+    task->cancel_requested = true;
+    if (task->shared_db) {
+        task->shared_db->cancel_search_task(task->shared_task_id);
+    }
+
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->status = SearchStatus::CANCELLED;
+    finish_prefetch(*task);
+    return true;
+}
+
+// 清理任务（手动或自动清理）
+void FileDB::cleanup_task(const std::string& task_id) {
+    // 正在执行的一批持有任务的引用，remove 置位取消标志让它尽快停下
+    std::shared_ptr<SearchTask> task = search_tasks_.remove(task_id);
+    if (task && task->shared_db) {
+        task->shared_db->cleanup_task(task->shared_task_id);
+    }
+    if (task) {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        finish_prefetch(*task);
+    }
+}
+
+SearchTaskRegistry::Stats FileDB::get_task_stats() {
+    return search_tasks_.stats();
+}
@@ -4,10 +4,28 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <deque>
+#include <cstdint>
 #include "sqlite3.h"
 #include <chrono>
 #include "DBManager.h"
+#include "NameIndex.h"
+#include "SearchCache.h"
+#include "FuzzyMatcher.h"
+#include "SearchQuery.h"
+#include "AccessChecker.h"
+#include "SearchTaskRegistry.h"
+#include "GlobPattern.h"
+#include "StandingQueries.h"
+#include "TaskExecutor.h"
+
+class FileDB;
+class TokenIndex;
 
 // 搜索任务状态
 enum class SearchStatus {
@@ -18,6 +36,51 @@ enum class SearchStatus {
     ERROR
 };
 
+// 搜索结果的分面统计，见 FileDB::enable_task_facets；各列表按数量从多到少排列
+struct SearchFacets {
+    int total = 0;                                          // 参与统计的匹配数
+    int files = 0;
+    int directories = 0;
+    std::vector<std::pair<std::string, int>> extensions;    // 文件的扩展名（小写），没有扩展名为 ""，只保留前 N 个
+    std::vector<std::pair<std::string, int>> parents;       // 匹配最多的前 N 个父目录
+    std::vector<std::pair<std::string, int>> roots;         // 各扫描对象目录下的匹配数，没有匹配的目录不列出
+};
+
+// 搜索结果的排序键，见 FileDB::set_task_sort
+// NAME 按折叠后的名字的字节序，NATURAL 按名字排序但数字部分按数值比较（file2 在 file10 之前）
+enum class SortKey {
+    NONE,
+    NAME,
+    NATURAL,
+    PATH,
+    MTIME,
+    SIZE
+};
+
+struct SearchSort {
+    SortKey key = SortKey::NONE;
+    bool descending = false;
+};
+
+// 搜索进度，见 FileDB::get_task_progress
+struct SearchProgress {
+    int cursor = 0;                    // 已检查过的最后一个 id
+    int rows_examined = 0;             // 已检查的有效记录数
+    int total_rows = 0;                // 需要检查的有效记录总数
+    int estimated_matches = -1;        // 匹配总数的估计，扫描完成后为准确值，-1 表示还无法估计
+    bool timed_out = false;            // 任务因超过单次查询的时间上限而结束，结果不完整
+};
+
+// 后台预取的计数，见 FileDB::get_prefetch_stats；时间单位为微秒
+struct SearchPrefetchStats {
+    uint64_t batches_prefetched = 0;   // 在后台算好的批数
+    uint64_t batches_served = 0;       // 直接交给请求的预取批数
+    uint64_t batches_discarded = 0;    // 任务取消或被清理时丢弃的预取批数
+    uint64_t background_us = 0;        // 后台计算的总耗时
+    uint64_t foreground_us = 0;        // 请求线程上同步计算的总耗时
+    uint64_t wait_us = 0;              // 请求等待正在进行的预取的总耗时，这部分没有被重叠
+};
+
 // 搜索任务结构
 struct SearchTask {
     std::string task_id;
@@ -26,15 +89,95 @@ struct SearchTask {
     int total_results = 0;
     int limit = 0;                     // 总限制
     SearchStatus status = SearchStatus::PENDING;
-    std::string pattern;
+    // 不走内存索引时 SQL 扫描使用的模式（子串匹配，锚定规则见 NameMatcher::substring_glob），每个任务编译一次，见 anything_match
+    std::shared_ptr<const GlobPattern> glob;
     std::chrono::system_clock::time_point created_time;
+
+    // 取消与超时：cancel_requested 可以在任何线程上置位，正在执行的语句和索引扫描会尽快停下；
+    // 到达 deadline 后任务以 CANCELLED 结束并置位 timed_out，已返回的结果保持有效
+    std::atomic<bool> cancel_requested{false};
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    bool timed_out = false;
+
+    // 执行一批、读取状态与进度时持有，同一任务的并发请求依次执行；取消只置位 cancel_requested，不等这把锁
+    std::mutex mutex;
+    // 共享索引中代表其他用户任务的子任务，生命周期由父任务管理
+    bool nested = false;
+    // 任务占用内存的估计，每批结束时更新
+    std::atomic<size_t> memory_bytes{0};
+    bool completion_counted = false;
     
     // ID范围相关
-    int current_min_id = 1;            // 当前查询的起始ID
+    int current_min_id = 1;            // 游标：下一个要检查的ID
     int max_id = 0;                    // 最大ID（用于判断结束）
+    int total_rows = 0;                // 创建任务时的有效记录数
+    int rows_examined = 0;             // 游标之前的有效记录数
+    int estimated_matches = -1;        // 匹配总数的估计，-1 表示还无法估计
     bool include_hidden = false;        // 是否包含隐藏文件夹
+
+    // 文件名搜索走内存索引时使用的匹配器，为空表示走 SQL 的 anything_match
+    std::shared_ptr<NameMatcher> matcher;
+    // 倒排表或排序数组求出的候选 id（见 NameIndex::find_candidates），为空表示需要扫描整个范围
+    std::shared_ptr<std::vector<int>> candidates;
+    // 并行度大于 1 时，第一批请求会并行求出剩余范围内的全部匹配 id，之后各批直接切片
+    int parallelism = 1;
+    std::shared_ptr<const std::vector<int>> matches;
+
+    // 分面统计：第一批求出全部匹配时一起统计，facet_roots 为按扫描对象统计的目录，facets 只交给调用者一次
+    bool facets_requested = false;
+    std::vector<std::string> facet_roots;
+    std::shared_ptr<SearchFacets> facets;
+    bool facets_taken = false;
+
+    // 随机访问的窗口：全部匹配的 id，共享索引中的记录以相反数保存，见 FileDB::get_search_window
+    std::shared_ptr<const std::vector<int>> window_ids;
+
+    // 按指定的键排序返回：第一批求出排好序的全部匹配 id（包括共享索引中的，以相反数保存），之后各批依次从 sorted_pos 处取
+    SearchSort sort;
+    std::shared_ptr<const std::vector<int>> sorted;
+    size_t sorted_pos = 0;
+
+    // 结果缓存：创建任务时索引的代数，完整遍历后把收集到的 id 写回缓存
+    std::string cache_key;
+    uint64_t generation = 0;
+    bool cacheable = false;
+    std::vector<int> collected;
+    // 是否由之前某个更宽的模式的结果细化得到
+    bool refined = false;
+
+    // 模糊搜索：扫描过程中维护得分最高的前 k 个 (得分, -id) 的小顶堆，
+    // 扫描完成后按得分从高到低排好放入 ranked
+    std::shared_ptr<FuzzyMatcher> fuzzy;
+    std::vector<std::pair<int, int>> top;
+
+    // 模糊搜索与按相关度排序的搜索：排好序的 id，各批依次从 ranked_pos 处取
+    std::vector<int> ranked;
+    size_t ranked_pos = 0;
+    // 按相关度排序的搜索进行到的阶段：0 未开始，1 已给出精确/前缀匹配，2 已给出全部结果
+    int ranked_stage = 0;
+
+    // 共享索引中对应的任务，私有数据库的结果取完后再从它取，shared_db 为空表示没有共享索引
+    std::shared_ptr<FileDB> shared_db;
+    std::shared_ptr<AccessChecker> access_checker;
+    std::string shared_task_id;
+    bool serving_shared = false;
+
+    // 预取：返回一批之后在后台线程上接着算后面最多 SEARCH_PREFETCH_DEPTH 批，与这一批的序列化、
+    // 传输以及客户端的解析重叠。prefetched 中每批附带算完那一刻的进度与状态，交出去之前对外只报告
+    // 最后交出的那一批的进度，任务算完了但还有预取的批没有交出时状态报告为 RUNNING
+    struct PrefetchedBatch {
+        std::vector<FileInfo> files;
+        SearchProgress progress;
+    };
+    std::deque<PrefetchedBatch> prefetched;
+    SearchProgress delivered_progress;
+    int prefetch_batch_size = 0;
+    // 已投递预取、还没有算完，请求线程不持锁读取，用来统计等待预取的时间
+    std::atomic<bool> prefetch_running{false};
+    SearchPrefetchStats prefetch_stats;
 };
 
+
 struct FileInfo {
     int id;
     std::string file_path;
@@ -47,6 +190,11 @@ struct FileInfo {
     std::string parent_directory;
     std::string last_scanned_time;
     int scan_count;
+    // 拼音检索键（全拼 / 首字母），文件名不含汉字时为空，见 Pinyin.h
+    std::string file_name_pinyin;
+    std::string file_name_initials;
+    // 文件大小（字节），目录为 0，未知（迁移前的旧记录尚未重新扫描）时为 -1
+    long long file_size = 0;
 };
 
 class FileDB {
@@ -76,6 +224,11 @@ public:
                                       const std::string& search_field = "file_name",
                                       int limit = -1);
     
+    // 按文件名前缀查找（大小写不敏感），走 file_name_folded 上的索引，结果按折叠后的名字排序；
+    // include_hidden 为 false 时排除路径中有以 . 开头的部分的记录
+    std::vector<FileInfo> search_files_by_name_prefix(const std::string& prefix, int limit = -1,
+                                                      bool include_hidden = true);
+
     std::vector<FileInfo> get_files_by_parent_directory(const std::string& parent_directory);
     bool batch_delete_files(const std::vector<std::string>& file_paths);
     
@@ -90,7 +243,8 @@ public:
                                  const std::string& search_field,
                                  int& max_file_count,
                                  int limit = -1,
-                                 bool include_hidden = false);
+                                 bool include_hidden = false,
+                                 bool* refined = nullptr);
 
     SearchStatus get_task_status(const std::string& task_id);
 
@@ -98,8 +252,57 @@ public:
     
     void cleanup_task(const std::string& task_id);
 
+    // 从任务的游标处继续，最多返回 batch_size 条，或者在时间预算用完时返回已找到的部分
     std::vector<FileInfo> get_search_batch(const std::string& task_id, 
-                                          int batch_size = 100000);
+                                          int batch_size = 1000);
+
+    // 任务的进度与匹配总数的估计，任务不存在时返回 false
+    bool get_task_progress(const std::string& task_id, SearchProgress& progress);
+
+    // 为任务开启分面统计，须在取第一批之前调用：第一批求出全部匹配，并按扩展名、文件/目录、
+    // 父目录以及 roots 中的各个目录统计匹配数，不需要把结果全部取回就能看出匹配集中在哪里。
+    // 只支持走文件名索引逐批返回的任务（默认模式、带过滤条件、拼音、正则），其他任务返回 false
+    bool enable_task_facets(const std::string& task_id, const std::vector<std::string>& roots);
+    // 取出任务的分面统计，统计好之后只返回一次
+    bool take_task_facets(const std::string& task_id, SearchFacets& facets);
+
+    // 让任务按 sort 指定的键返回结果，须在取第一批之前调用：第一批求出全部匹配并排好序，
+    // 之后的各批与随机访问的窗口都按这个顺序给出，第一批就是排序后的开头部分。limit 取排序后的前 limit 个。
+    // 共享索引中有权限看到的匹配一起参与排序。模糊搜索与按相关度排序的搜索有自己的顺序，返回 false
+    bool set_task_sort(const std::string& task_id, const SearchSort& sort);
+
+    // 随机访问：第一次调用时求出任务的全部匹配 id（按 id 升序，共享索引中有权限看到、且本数据库中没有的排在后面；
+    // 设置了排序的任务按排序后的顺序），只保存 id，之后按下标取出 [offset, offset + count) 的记录，耗时只与 count 有关，与翻到多远无关。
+    // total 为匹配总数。窗口与逐批返回互不影响；已被删除的记录会被跳过。
+    // 只支持按 id 顺序返回的任务（模糊搜索与按相关度排序的搜索除外），不支持、任务不存在或求匹配超时时返回 false
+    bool get_search_window(const std::string& task_id, int offset, int count,
+                           std::vector<FileInfo>& files, int& total);
+
+    // 输入联想：把 text 的最后一个词补全为文件名中出现最多的 limit 个词元，返回补全后的整段文本及出现次数。
+    // 只查内存中的词元索引，不访问数据库；词元索引未开启时返回空
+    std::vector<std::pair<std::string, int>> suggest_completions(const std::string& text, int limit = 10);
+
+    // 常驻查询：保存一个搜索，之后随文件记录的变化增量维护它的结果，刷新时不再重新扫描。
+    // mode 为空（文件名，可以是多个词）、pinyin 或 regex，不支持 ext: 等过滤条件；root 非空时只保留该目录下的记录。
+    // 需要文件名索引；参数非法时抛出 std::invalid_argument，写库失败时返回 0，成功时返回查询的 id
+    int add_standing_query(const std::string& text, const std::string& mode, const std::string& root,
+                           bool include_hidden);
+    bool delete_standing_query(int id);
+    std::vector<StandingQueries::Definition> get_standing_queries();
+    // 取出常驻查询自版本 since 之后的变化，since 为 0 或太旧时 reset 为 true、added 为全部结果；
+    // 第一次调用时求出匹配集合。version 为当前版本，下次刷新时作为 since 传入。查询不存在或求值被中断时返回 false
+    bool fetch_standing_query(int id, uint64_t since, uint64_t& version, bool& reset,
+                              std::vector<FileInfo>& added, std::vector<int>& removed);
+
+    // 挂上由 root 的扫描对象写入的共享索引：之后的搜索任务先返回本数据库的结果，
+    // 再返回共享索引中 checker 对应的用户有权限看到、且本数据库中没有的记录
+    void set_shared_index(std::shared_ptr<FileDB> shared_db, std::shared_ptr<AccessChecker> checker);
+    bool has_shared_index();
+
+    // 任务表的计数：存活、正常结束、空闲超时被回收、超过上限被淘汰的任务数
+    SearchTaskRegistry::Stats get_task_stats();
+    // 后台预取的累计计数：后台计算的时间减去请求等待预取的时间，就是与请求重叠掉的时间
+    SearchPrefetchStats get_prefetch_stats();
 
 private:
     // 批量操作结构
@@ -112,10 +315,108 @@ private:
     void cleanup_prepared_statements();
 
     bool execute_sql(const std::string& sql);
+    bool migrate_database();
     bool execute_sql_with_params(const std::string& sql, 
-                                const std::vector<std::string>& params);
+                                const std::vector<std::string>& params,
+                                sqlite3_int64* last_insert_id = nullptr);
+
+    // start_search_task 的实现，nested 表示这是其他用户的任务在共享索引中的子任务
+    std::string create_search_task(const std::string& search_term,
+                                   const std::string& search_field,
+                                   int& max_file_count,
+                                   int limit,
+                                   bool include_hidden,
+                                   bool* refined,
+                                   bool nested);
 
     int get_max_id();
+    // [min_id, max_id] 范围内的有效记录数，有内存索引时不访问数据库
+    int count_rows(int min_id, int max_id);
+    // 私有数据库的匹配取完后转入共享索引阶段
+    void enter_shared_stage(SearchTask& task);
+    // 共享索引阶段的一批：从共享索引中的任务取一批，按权限过滤
+    std::vector<FileInfo> get_shared_batch(SearchTask& task, int batch_size);
+    // 求出任务在本数据库中的全部匹配 id（升序，受 limit 限制，排序的任务不受限制），与游标无关；被中断时返回 false
+    bool collect_all_matches(SearchTask& task, std::vector<int>& ids);
+    // 共享索引中有权限看到、且本数据库中没有的匹配，按 id 升序取相反数后追加到 ids；被中断时返回 false
+    bool collect_shared_matches(SearchTask& task, std::vector<int>& ids);
+    // 求出 task.window_ids，包括共享索引中有权限看到的匹配
+    bool materialize_window(SearchTask& task);
+    // 按 ids 的顺序回表，负数为共享索引中的记录，已不存在的记录会被跳过
+    std::vector<FileInfo> get_files_in_order(SearchTask& task, const std::vector<int>& ids);
+
+    // 排序用的键值：SIZE 为 number，其余为 text
+    struct SortValue {
+        int id = 0;
+        long long number = 0;
+        std::string text;
+    };
+    // 求出 task.sorted：匹配多时沿排序键上的索引遍历一遍，否则取出各条匹配的键值在内存中排序
+    bool sort_matches(SearchTask& task);
+    // 按排序键的索引顺序遍历 file_info，依次保留 ids（升序）中的记录
+    bool scan_sort_index(SearchTask& task, const std::vector<int>& ids, std::vector<int>& sorted);
+    // 取出 ids（升序）中各条记录的键值追加到 values，名字优先从内存索引取
+    bool fetch_sort_values(const std::vector<int>& ids, SortKey key, std::vector<SortValue>& values);
+    // 排好序的任务的一批
+    std::vector<FileInfo> get_sorted_batch(SearchTask& task, int batch_size);
+    // 求出游标之后的全部匹配放入 task.matches，已经求出时不做任何事
+    void resolve_matches(SearchTask& task);
+    // 求出任务的全部匹配并把分面统计累加到 counts，任务不走文件名索引时返回 false
+    bool count_task_facets(SearchTask& task, NameIndex::FacetCounts& counts);
+    // 求出 task.facets，共享索引中的匹配只统计有权限看到、且本数据库中没有的记录
+    void compute_facets(SearchTask& task);
+    // 一批结束后累计游标扫过的记录数，并更新匹配总数的估计；from_id 为这一批开始时的游标
+    void update_progress(SearchTask& task, int from_id);
+    // 算出任务的下一批，调用时须持有 task.mutex
+    std::vector<FileInfo> compute_search_batch(const std::shared_ptr<SearchTask>& task, int batch_size);
+    // 任务当前的进度，调用时须持有 task.mutex
+    void fill_progress(const SearchTask& task, SearchProgress& progress);
+    // 在后台线程上为任务预取后面的批，见 SearchTask::prefetched
+    void schedule_prefetch(const std::shared_ptr<SearchTask>& task, int batch_size);
+    void prefetch_batches(const std::shared_ptr<SearchTask>& task);
+    // 把任务的预取计数累加到全局计数，丢弃还没交出的预取批
+    void finish_prefetch(SearchTask& task);
+
+    // 查询语句第一列的所有 id，cache_statement 为 false 时语句用完即释放，不进预编译缓存
+    std::vector<int> query_ids(const std::string& sql,
+                               const std::vector<std::string>& params,
+                               bool cache_statement = true);
+    // paths 中在本数据库里已有的路径，每 PLAN_ID_CHUNK 个路径执行一条 IN 查询
+    std::unordered_set<std::string> existing_paths(const std::vector<std::string>& paths);
+    // 按 id 取回完整记录，保持 ids 的顺序，已不存在的 id 会被跳过
+    std::vector<FileInfo> get_files_by_ids(const std::vector<int>& ids);
+
+    // 求出常驻查询的匹配集合（升序），返回编译好的匹配器，失败时返回空
+    std::shared_ptr<NameMatcher> evaluate_standing_query(const StandingQueries::Definition& definition,
+                                                         std::vector<int>& ids);
+
+    // 编译文件名搜索词：含多个词、|、! 或 - 时为 BooleanMatcher，按倒排表长度估计各词的选择性
+    std::shared_ptr<NameMatcher> compile_name_query(const std::string& text);
+    // SQL 扫描路径中搜索字段的匹配条件，模式绑定在第 param 个参数上
+    static std::string match_condition(const std::string& search_field, int param);
+    // 拼音模式：文件名或拼音检索键匹配的全部 id
+    std::shared_ptr<const std::vector<int>> search_pinyin(const NameMatcher& matcher, bool include_hidden);
+    // 带过滤条件的文件名搜索：估计各条件命中的行数，从最有选择性的索引（或文件名索引）出发，
+    // 再用其余条件过滤，返回按 id 升序的全部匹配
+    std::shared_ptr<const std::vector<int>> execute_query_plan(const SearchQuery& query,
+                                                               const NameMatcher& matcher,
+                                                               bool include_hidden);
+    // 模糊搜索的一批：先分批扫描完整个范围，之后按得分从高到低返回
+    std::vector<FileInfo> get_fuzzy_batch(SearchTask& task, int batch_size);
+    // 按相关度排序的一批：先从索引取精确/前缀匹配，再对其余匹配部分选择前 k 个
+    std::vector<FileInfo> get_ranked_batch(SearchTask& task, int batch_size);
+    // 按相关度对记录排序后把 id 追加到 task.ranked
+    void append_ranked(SearchTask& task, std::vector<FileInfo>& files);
+
+    // 同步内存索引（文件名索引与拼音索引）
+    void index_insert(int id, const FileInfo& file_info);
+    void index_remove(const std::vector<int>& ids);
+
+    // 查找缓存的搜索结果，过期的结果在修改日志覆盖得到时用变化的 id 修补
+    // 没有完全相同的结果时，尝试从更宽的模式的结果中细化，成功时设置 task.refined
+    std::shared_ptr<const std::vector<int>> lookup_search_cache(SearchTask& task);
+    std::shared_ptr<const std::vector<int>> refine_search_result(SearchTask& task,
+                                                                 const SearchCache::Entry& base);
 
     DBConnection* db_conn_;
     std::string db_path_;
@@ -124,11 +425,28 @@ private:
     
     int transaction_depth_ = 0;
 
+    std::shared_ptr<NameIndex> name_index_;
+    std::shared_ptr<NameIndex> pinyin_index_;
+    std::shared_ptr<TokenIndex> token_index_;
+    std::shared_ptr<StandingQueries> standing_queries_;
+    SearchCache search_cache_;
+
+    // 共享索引及按权限过滤用的检查器，由 task_mutex_ 保护
+    std::shared_ptr<FileDB> shared_db_;
+    std::shared_ptr<AccessChecker> access_checker_;
+
     std::unordered_map<std::string, sqlite3_stmt*> prepared_statements_;
 
-    std::unordered_map<std::string, std::unique_ptr<SearchTask>> search_tasks_;
     std::mutex task_mutex_;
     std::atomic<int> next_task_id_{0};
+
+    std::mutex prefetch_stats_mutex_;
+    SearchPrefetchStats prefetch_totals_;
+
+    // 放在后面，析构时先停下回收线程
+    SearchTaskRegistry search_tasks_;
+    // 预取用的后台线程，工作中会用到上面的所有成员，放在最后最先析构，等正在进行的预取结束
+    TaskExecutor prefetch_executor_;
 };
 
 #endif // FILEDB_H
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "FileScanner.h"
+#include "Pinyin.h"
+#include "Utils.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -18,6 +20,7 @@ FileScanner::FileScanner(const std::string& directory_path,
     excluded_patterns_(excluded_patterns.empty() ? DEFAULT_EXCLUDED_DIRS : excluded_patterns),
     is_watching_(false),
     total_file_count_(0),
+    pinyin_keys_enabled_(is_pinyin_keys_enabled()),
     file_watcher_(nullptr) {
     
     file_db_ = std::make_unique<FileDB>(db_path_);
@@ -385,6 +388,10 @@ std::unique_ptr<FileInfo> FileScanner::get_file_info(const std::filesystem::path
         file_info->mime_type = get_mime_type(file_path);
         file_info->is_directory = 0;
         file_info->parent_directory = file_path.parent_path().string();
+        std::error_code size_error;
+        const auto size = std::filesystem::file_size(file_path, size_error);
+        file_info->file_size = size_error ? 0 : static_cast<long long>(size);
+        fill_pinyin_keys(*file_info);
         
         return file_info;
         
@@ -422,6 +429,7 @@ std::unique_ptr<FileInfo> FileScanner::get_directory_info(const std::filesystem:
         file_info->mime_type = "inode/directory";
         file_info->is_directory = 1;
         file_info->parent_directory = dir_path.parent_path().string();
+        fill_pinyin_keys(*file_info);
         
         return file_info;
         
@@ -431,6 +439,12 @@ std::unique_ptr<FileInfo> FileScanner::get_directory_info(const std::filesystem:
     }
 }
 
+void FileScanner::fill_pinyin_keys(FileInfo& file_info) const {
+    if (pinyin_keys_enabled_) {
+        make_pinyin_keys(file_info.file_name, file_info.file_name_pinyin, file_info.file_name_initials);
+    }
+}
+
 std::string FileScanner::get_mime_type(const std::filesystem::path& file_path) {
     // 简化的MIME类型检测，基于文件扩展名
     std::string extension = file_path.extension().string();
@@ -50,6 +50,7 @@ private:
     std::unique_ptr<FileInfo> get_file_info(const std::filesystem::path& file_path);
     std::unique_ptr<FileInfo> get_directory_info(const std::filesystem::path& dir_path);
     std::string get_mime_type(const std::filesystem::path& file_path);
+    void fill_pinyin_keys(FileInfo& file_info) const;
     
     void start_file_watcher();
     void stop_file_watcher();
@@ -70,6 +71,7 @@ private:
     static const std::unordered_set<std::string> DEFAULT_EXCLUDED_DIRS;
 
     int total_file_count_;
+    bool pinyin_keys_enabled_;
 
     std::unique_ptr<FileWatcher> file_watcher_;
 };
@@ -0,0 +1,230 @@
+#include "FuzzyMatcher.h"
+#include "NameMatcher.h"
+#include <algorithm>
+
+// 打分参数，取自 fzf
+static const int SCORE_MATCH = 16;
+static const int SCORE_GAP_START = -3;
+static const int SCORE_GAP_EXTENSION = -1;
+static const int BONUS_BOUNDARY = 8;
+static const int BONUS_CONSECUTIVE = 4;
+static const int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+// 编辑距离匹配时每个错误的扣分
+static const int TYPO_PENALTY = 24;
+
+// Myers 算法一次处理一个 64 位字，查询超过 64 个字符的部分被忽略
+static const size_t MAX_QUERY_CHARS = 64;
+
+// 取出下一个 UTF-8 字符，把它的字节打包成一个整数，不做解码
+static inline uint32_t next_char(const char* s, size_t len, size_t& i) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+    size_t n = c < 0xC0 ? 1 : (c < 0xE0 ? 2 : (c < 0xF0 ? 3 : 4));
+    if (i + n > len) {
+        n = len - i;
+    }
+
+    uint32_t packed = 0;
+    for (size_t k = 0; k < n; ++k) {
+        packed = (packed << 8) | static_cast<unsigned char>(s[i + k]);
+    }
+    i += n;
+    return packed;
+}
+
+// 分隔符后面的字符视为单词开头
+static inline bool is_delimiter(unsigned char c) {
+    return c < 0x80 && !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'));
+}
+
+FuzzyMatcher::FuzzyMatcher(const std::string& query) {
+    const std::string folded = NameMatcher::fold_name(query);
+    size_t i = 0;
+    while (i < folded.size() && chars_.size() < MAX_QUERY_CHARS) {
+        chars_.push_back(next_char(folded.data(), folded.size(), i));
+        offsets_.push_back(i);
+    }
+    query_ = folded.substr(0, i);
+
+    for (size_t k = 0; k < chars_.size(); ++k) {
+        const uint64_t bit = 1ULL << k;
+        const uint32_t c = chars_[k];
+        if (c < 128) {
+            ascii_masks_[c] |= bit;
+            continue;
+        }
+
+        auto it = std::find_if(wide_masks_.begin(), wide_masks_.end(),
+            [c](const std::pair<uint32_t, uint64_t>& entry) { return entry.first == c; });
+        if (it != wide_masks_.end()) {
+            it->second |= bit;
+        } else {
+            wide_masks_.push_back({c, bit});
+        }
+    }
+
+    // 短查询只允许子序列匹配，否则几乎所有名字都在编辑距离之内
+    const size_t m = chars_.size();
+    max_errors_ = m <= 3 ? 0 : (m <= 7 ? 1 : 2);
+
+    // 鸽巢原理：把查询切成 max_errors_ + 1 段，k 个错误最多破坏 k 段，编辑距离之内的名字至少完整包含其中一段
+    if (max_errors_ > 0) {
+        const size_t count = static_cast<size_t>(max_errors_) + 1;
+        for (size_t piece = 0; piece < count; ++piece) {
+            const size_t begin = offsets_[m * piece / count];
+            const size_t end = offsets_[m * (piece + 1) / count];
+            pieces_.push_back(query_.substr(begin, end - begin));
+        }
+    }
+}
+
+int FuzzyMatcher::score(const char* name, size_t len) const {
+    int best = 0;
+    if (!chars_.empty()) {
+        bool matched = subsequence_score(name, len, best);
+
+        // 编辑距离为 0 时一定也是子序列匹配且得分更高，只有可能超过当前得分时才计算
+        const int m = static_cast<int>(chars_.size());
+        const int best_typo = m * SCORE_MATCH - TYPO_PENALTY;
+        if (max_errors_ > 0 && (!matched || best < best_typo) && contains_piece(name, len)) {
+            const int distance = edit_distance(name, len);
+            if (distance > 0 && distance <= max_errors_) {
+                const int typo = m * SCORE_MATCH - distance * TYPO_PENALTY;
+                best = matched ? std::max(best, typo) : typo;
+                matched = true;
+            }
+        }
+        if (!matched) {
+            return NO_MATCH;
+        }
+    }
+
+    // 低 8 位按名字长度排序，同分时短的名字在前
+    return std::max(best, 0) * 256 + (255 - static_cast<int>(std::min<size_t>(len, 255)));
+}
+
+bool FuzzyMatcher::subsequence_score(const char* name, size_t len, int& score) const {
+    const size_t m = chars_.size();
+
+    // 正向依次查找每个字符，得到最早完成匹配的位置
+    size_t i = 0;
+    for (size_t j = 0; j < m; ++j) {
+        const size_t length = offsets_[j + 1] - offsets_[j];
+        const char* hit = NameMatcher::find_literal(name + i, len - i, query_.data() + offsets_[j], length);
+        if (hit == nullptr) {
+            return false;
+        }
+        i = (hit - name) + length;
+    }
+    const size_t end = i;
+    size_t j = m;
+
+    // 从结尾反向匹配，得到最短的匹配窗口
+    size_t start = end;
+    while (start > 0) {
+        size_t p = start - 1;
+        while (p > 0 && (static_cast<unsigned char>(name[p]) & 0xC0) == 0x80) {
+            p--;
+        }
+        size_t q = p;
+        const uint32_t c = next_char(name, len, q);
+        start = p;
+        if (c == chars_[j - 1] && --j == 0) {
+            break;
+        }
+    }
+
+    // 在窗口内贪心对齐并打分
+    score = 0;
+    int consecutive = 0;
+    int first_bonus = 0;
+    bool in_gap = false;
+    j = 0;
+    i = start;
+    while (i < end) {
+        const bool boundary = i == 0 || is_delimiter(static_cast<unsigned char>(name[i - 1]));
+        const uint32_t c = next_char(name, len, i);
+        if (j < m && c == chars_[j]) {
+            // 连续命中的一段沿用这一段开头的加分，整段命中在单词开头的名字优于分散命中在各个单词开头的名字
+            int bonus = boundary ? BONUS_BOUNDARY : 0;
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                bonus = std::max({bonus, first_bonus, BONUS_CONSECUTIVE});
+            }
+            if (j == 0) {
+                bonus *= BONUS_FIRST_CHAR_MULTIPLIER;
+            }
+            score += SCORE_MATCH + bonus;
+            consecutive++;
+            in_gap = false;
+            j++;
+        } else {
+            score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            consecutive = 0;
+            in_gap = true;
+        }
+    }
+
+    return true;
+}
+
+int FuzzyMatcher::edit_distance(const char* name, size_t len) const {
+    // Myers (1999) 位并行近似匹配：pv / mv 记录 DP 矩阵当前列相邻行之差为 +1 / -1 的位置，
+    // 每读入一个字符用几次位运算推进一整列；横向差值不向第 0 行进位，即名字中任意位置都可以作为起点
+    const int m = static_cast<int>(chars_.size());
+    const uint64_t high = 1ULL << (m - 1);
+    uint64_t pv = ~0ULL;
+    uint64_t mv = 0;
+    int current = m;
+    int best = m;
+
+    size_t i = 0;
+    while (i < len && best > 0) {
+        const unsigned char b = static_cast<unsigned char>(name[i]);
+        uint64_t eq;
+        if (b < 0x80) {
+            eq = ascii_masks_[b];
+            i++;
+        } else {
+            eq = char_mask(next_char(name, len, i));
+        }
+        const uint64_t xv = eq | mv;
+        const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) {
+            current++;
+        } else if (mh & high) {
+            current--;
+        }
+        ph <<= 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        best = std::min(best, current);
+    }
+
+    return best;
+}
+
+bool FuzzyMatcher::contains_piece(const char* name, size_t len) const {
+    for (const auto& piece : pieces_) {
+        if (NameMatcher::find_literal(name, len, piece.data(), piece.size()) != nullptr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t FuzzyMatcher::char_mask(uint32_t c) const {
+    if (c < 128) {
+        return ascii_masks_[c];
+    }
+    for (const auto& entry : wide_masks_) {
+        if (entry.first == c) {
+            return entry.second;
+        }
+    }
+    return 0;
+}
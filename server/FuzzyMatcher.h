@@ -0,0 +1,52 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// 模糊文件名匹配：容忍漏字、多字和错字，给每个名字打分而不是只判断是否匹配
+// 两种打分取较高者：
+//   1. 子序列对齐（类似 fzf）：查询的字符按顺序出现在名字中即可，连续命中、命中在单词开头加分，间隔扣分
+//   2. 有界编辑距离：查询与名字中任意一段的编辑距离不超过上限（按查询长度取 0~2），
+//      用 Myers 位并行算法计算，每个字符只需几次 64 位整数运算
+// 以 UTF-8 字符为单位比较，名字必须已经用 NameMatcher::fold_name 折叠过。
+// score() 不分配内存，可以在多个线程上并发调用。
+class FuzzyMatcher {
+public:
+    static const int NO_MATCH = -1;
+
+    explicit FuzzyMatcher(const std::string& query);
+
+    // 得分越高越相关，不匹配时返回 NO_MATCH；得分相同时名字越短越高
+    int score(const char* name, size_t len) const;
+
+    // 允许的最大编辑距离
+    int max_errors() const { return max_errors_; }
+
+private:
+    // 查询是名字的子序列时返回 true 并给出得分
+    bool subsequence_score(const char* name, size_t len, int& score) const;
+    // 查询与名字任意一段之间的最小编辑距离
+    int edit_distance(const char* name, size_t len) const;
+    // 名字是否包含 pieces_ 中的某一段，不包含时编辑距离一定超过上限
+    bool contains_piece(const char* name, size_t len) const;
+    uint64_t char_mask(uint32_t c) const;
+
+    // 折叠后的查询（最多 64 个字符），offsets_[k] 为第 k 个字符的起始字节位置，末尾为总长度
+    std::string query_;
+    std::vector<size_t> offsets_ = {0};
+    // 查询的字符（UTF-8 字节打包成整数）
+    std::vector<uint32_t> chars_;
+
+    // 每个字符在查询中出现位置的位掩码，ASCII 查表，其他字符在 wide_masks_ 中线性查找
+    uint64_t ascii_masks_[128] = {};
+    std::vector<std::pair<uint32_t, uint64_t>> wide_masks_;
+
+    int max_errors_ = 0;
+    std::vector<std::string> pieces_;
+};
+
+#endif // FUZZYMATCHER_H
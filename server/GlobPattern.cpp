@@ -0,0 +1,211 @@
+#include "GlobPattern.h"
+#include "NameMatcher.h"
+#include "Utils.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+const char* const GlobPattern::POINTER_TYPE = "anything_glob_pattern";
+
+static inline char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// 值按 ASCII 转小写后的副本，名字与路径都不长，复用线程局部的缓冲区
+static const char* lowered_copy(const char* value, size_t len) {
+    thread_local std::string buffer;
+    buffer.resize(len);
+    for (size_t i = 0; i < len; ++i) {
+        buffer[i] = ascii_lower(value[i]);
+    }
+    return buffer.data();
+}
+
+namespace {
+
+template <GlobPattern::Kind K>
+class SpecializedGlob final : public GlobPattern {
+public:
+    // EXACT / PREFIX / SUFFIX / CONTAINS 的 text 为去掉 * 后的字面量，GLOB 为合并连续 * 后的模式
+    SpecializedGlob(std::string text, bool ascii_case_insensitive)
+        : GlobPattern(K, ascii_case_insensitive), text_(std::move(text)) {
+        if (K == Kind::GLOB) {
+            has_question_ = text_.find('?') != std::string::npos;
+            leading_star_ = !text_.empty() && text_.front() == '*';
+            trailing_star_ = !text_.empty() && text_.back() == '*';
+            size_t start = 0;
+            while (start <= text_.size()) {
+                size_t star = text_.find('*', start);
+                if (star == std::string::npos) {
+                    star = text_.size();
+                }
+                if (star > start) {
+                    segments_.push_back(text_.substr(start, star - start));
+                }
+                start = star + 1;
+            }
+        }
+    }
+
+    bool match(const char* value, size_t len) const override;
+
+private:
+    bool equal(const char* value, const char* literal, size_t n) const {
+        if (!ascii_case_insensitive_) {
+            return memcmp(value, literal, n) == 0;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (ascii_lower(value[i]) != literal[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool match_segments(const char* value, size_t len) const;
+    bool match_backtracking(const char* value, size_t len) const;
+
+    std::string text_;
+
+    // 仅 GLOB 使用
+    std::vector<std::string> segments_;
+    bool has_question_ = false;
+    bool leading_star_ = false;
+    bool trailing_star_ = false;
+};
+
+template <>
+bool SpecializedGlob<GlobPattern::Kind::EXACT>::match(const char* value, size_t len) const {
+    return len == text_.size() && equal(value, text_.data(), len);
+}
+
+template <>
+bool SpecializedGlob<GlobPattern::Kind::PREFIX>::match(const char* value, size_t len) const {
+    return len >= text_.size() && equal(value, text_.data(), text_.size());
+}
+
+template <>
+bool SpecializedGlob<GlobPattern::Kind::SUFFIX>::match(const char* value, size_t len) const {
+    return len >= text_.size() && equal(value + len - text_.size(), text_.data(), text_.size());
+}
+
+template <>
+bool SpecializedGlob<GlobPattern::Kind::CONTAINS>::match(const char* value, size_t len) const {
+    if (ascii_case_insensitive_) {
+        value = lowered_copy(value, len);
+    }
+    return NameMatcher::find_literal(value, len, text_.data(), text_.size()) != nullptr;
+}
+
+template <>
+bool SpecializedGlob<GlobPattern::Kind::GLOB>::match(const char* value, size_t len) const {
+    if (ascii_case_insensitive_) {
+        value = lowered_copy(value, len);
+    }
+    return has_question_ ? match_backtracking(value, len) : match_segments(value, len);
+}
+
+template <GlobPattern::Kind K>
+bool SpecializedGlob<K>::match_segments(const char* value, size_t len) const {
+    // 不以 * 开头时第一段必须在开头，不以 * 结尾时最后一段必须在结尾，中间各段取最左的出现即可
+    size_t first = 0;
+    size_t last = segments_.size();
+    size_t pos = 0;
+    size_t end = len;
+    if (!leading_star_) {
+        const std::string& head = segments_[first++];
+        if (len < head.size() || memcmp(value, head.data(), head.size()) != 0) {
+            return false;
+        }
+        pos = head.size();
+    }
+    if (!trailing_star_ && last > first) {
+        const std::string& tail = segments_[--last];
+        if (len - pos < tail.size() || memcmp(value + len - tail.size(), tail.data(), tail.size()) != 0) {
+            return false;
+        }
+        end = len - tail.size();
+    }
+    for (size_t i = first; i < last; ++i) {
+        const std::string& segment = segments_[i];
+        const char* hit = NameMatcher::find_literal(value + pos, end - pos, segment.data(), segment.size());
+        if (hit == nullptr) {
+            return false;
+        }
+        pos = (hit - value) + segment.size();
+    }
+    return true;
+}
+
+template <GlobPattern::Kind K>
+bool SpecializedGlob<K>::match_backtracking(const char* value, size_t len) const {
+    // 与 NameMatcher 相同的回溯匹配，只回溯到最近的一个 *，最坏 O(n*m)
+    const char* p = text_.data();
+    const size_t plen = text_.size();
+    size_t pi = 0, si = 0;
+    size_t star = std::string::npos, mark = 0;
+
+    while (si < len) {
+        if (pi < plen && p[pi] == '*') {
+            star = pi++;
+            mark = si;
+        } else if (pi < plen && p[pi] == '?') {
+            si += getUTF8CharLength(static_cast<unsigned char>(value[si]));
+            pi++;
+        } else if (pi < plen && p[pi] == value[si]) {
+            pi++;
+            si++;
+        } else if (star != std::string::npos) {
+            pi = star + 1;
+            mark += getUTF8CharLength(static_cast<unsigned char>(value[mark]));
+            si = mark;
+        } else {
+            return false;
+        }
+    }
+
+    if (si > len) {
+        return false;   // ? 跨过了被截断的 UTF-8 字符
+    }
+    while (pi < plen && p[pi] == '*') {
+        pi++;
+    }
+    return pi == plen;
+}
+
+} // namespace
+
+std::shared_ptr<const GlobPattern> GlobPattern::compile(const std::string& pattern, bool ascii_case_insensitive) {
+    // 合并连续的 *，大小写不敏感时模式先转小写
+    std::string text;
+    text.reserve(pattern.size());
+    for (char c : pattern) {
+        if (c == '*' && !text.empty() && text.back() == '*') {
+            continue;
+        }
+        text += ascii_case_insensitive ? ascii_lower(c) : c;
+    }
+
+    const size_t stars = static_cast<size_t>(std::count(text.begin(), text.end(), '*'));
+    const bool has_question = text.find('?') != std::string::npos;
+    const bool leading = !text.empty() && text.front() == '*';
+    const bool trailing = text.size() > 1 && text.back() == '*';
+
+    if (!has_question) {
+        if (stars == 0) {
+            return std::make_shared<SpecializedGlob<Kind::EXACT>>(text, ascii_case_insensitive);
+        }
+        if (stars == 1 && trailing) {
+            return std::make_shared<SpecializedGlob<Kind::PREFIX>>(text.substr(0, text.size() - 1),
+                                                                   ascii_case_insensitive);
+        }
+        if (stars == 1 && leading) {
+            return std::make_shared<SpecializedGlob<Kind::SUFFIX>>(text.substr(1), ascii_case_insensitive);
+        }
+        if (stars == 2 && leading && trailing) {
+            return std::make_shared<SpecializedGlob<Kind::CONTAINS>>(text.substr(1, text.size() - 2),
+                                                                     ascii_case_insensitive);
+        }
+    }
+    return std::make_shared<SpecializedGlob<Kind::GLOB>>(text, ascii_case_insensitive);
+}
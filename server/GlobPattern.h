@@ -0,0 +1,41 @@
+#ifndef GLOBPATTERN_H
+#define GLOBPATTERN_H
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+// SQL 函数 anything_match(pattern, value) 使用的通配符模式，代替 LIKE
+// * 匹配任意个字符，? 匹配单个 UTF-8 字符，其余字符（包括 LIKE 的 % 和 _）按字面匹配；
+// 整个值都要匹配，子串搜索由调用者在首尾补 *。编译时按模式的形状选出专门的实现：
+//   EXACT     没有通配符，比较长度与内容
+//   PREFIX    abc*，只比较开头
+//   SUFFIX    *abc，只比较结尾
+//   CONTAINS  *abc*，SIMD 子串查找（NameMatcher::find_literal）
+//   GLOB      其他形状，按 * 切段依次查找，含 ? 时回溯匹配
+// ascii_case_insensitive 时按 ASCII 大小写不敏感比较，与 SQLite 的 LIKE 相同；
+// 折叠过的列（file_name_folded）与折叠后的模式比较时不需要。
+// 编译后只读，可以在多个线程上并发使用。
+class GlobPattern {
+public:
+    enum class Kind { EXACT, PREFIX, SUFFIX, CONTAINS, GLOB };
+
+    // 用 sqlite3_bind_pointer 把编译好的模式绑定到语句时使用的类型名
+    static const char* const POINTER_TYPE;
+
+    static std::shared_ptr<const GlobPattern> compile(const std::string& pattern, bool ascii_case_insensitive);
+
+    virtual ~GlobPattern() = default;
+
+    virtual bool match(const char* value, size_t len) const = 0;
+
+    Kind kind() const { return kind_; }
+
+protected:
+    GlobPattern(Kind kind, bool ascii_case_insensitive) : kind_(kind), ascii_case_insensitive_(ascii_case_insensitive) {}
+
+    Kind kind_;
+    bool ascii_case_insensitive_;
+};
+
+#endif // GLOBPATTERN_H
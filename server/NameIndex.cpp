@@ -0,0 +1,934 @@
+#include "NameIndex.h"
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string_view>
+#include <cstring>
+
+// 删除标记超过这个数量且占比超过 1/4 时整理一次
+static const size_t COMPACT_MIN_DELETED = 65536;
+
+// 并行扫描时每个分片至少包含的记录数，太小的分片不值得开线程
+static const size_t MIN_SHARD_SLOTS = 65536;
+
+// 求交时最多使用的倒排表个数，后面的表只会让候选集合略微变小
+static const size_t MAX_INTERSECT_LISTS = 6;
+
+// 有时间预算的扫描每匹配这么多个名字检查一次时钟
+static const size_t BUDGET_CHECK_INTERVAL = 16;
+
+// 修改日志保留的条目数，超过后较早的缓存结果只能整体失效
+static const size_t MAX_CHANGE_LOG = 4096;
+
+// 排序数组建立之后追加的记录超过这个数量、且超过记录数的 1/16 时重建
+static const size_t SORTED_REBUILD_MIN = 4096;
+
+static uint32_t make_trigram(const char* p) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+// 取出字符串中所有不重复的三元组
+static void collect_trigrams(const char* s, size_t length, std::vector<uint32_t>& out) {
+    out.clear();
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        out.push_back(make_trigram(s + i));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+static void put_varint(std::vector<uint8_t>& data, uint32_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t get_varint(const uint8_t*& p) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= static_cast<uint32_t>(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint32_t>(*p++) << shift;
+    return value;
+}
+
+NameIndex::NameIndex(const std::string& key_sql, const std::string& filter_sql)
+    : key_sql_(key_sql), filter_sql_(filter_sql) {
+}
+
+bool NameIndex::load(sqlite3* db) {
+    auto start = std::chrono::steady_clock::now();
+
+    sqlite3_stmt* stmt = nullptr;
+    std::string sql = "SELECT id, " + key_sql_ + ", is_directory, parent_directory FROM file_info ";
+    if (!filter_sql_.empty()) {
+        sql += "WHERE " + filter_sql_ + " ";
+    }
+    sql += "ORDER BY id";
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "加载文件名索引失败: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    arena_.clear();
+    offsets_.assign(1, 0);
+    ids_.clear();
+    flags_.clear();
+    parents_.clear();
+    deleted_count_ = 0;
+    directories_.clear();
+    directory_hidden_.clear();
+    directory_depth_.clear();
+    directory_ids_.clear();
+    trigrams_.clear();
+    invalidate_sorted();
+    reset_changes();
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        // 数据库里存的已经是折叠后的名字，不需要再折叠
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        const char* parent = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+
+        std::string folded = name ? std::string(name, sqlite3_column_bytes(stmt, 1)) : "";
+        uint32_t parent_id = intern_directory(parent ? parent : "");
+        append(sqlite3_column_int(stmt, 0), folded,
+               make_flags(folded, sqlite3_column_int(stmt, 2), parent_id), parent_id);
+    }
+    sqlite3_finalize(stmt);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "文件名索引加载完成 (" << key_sql_ << "), 记录数: " << ids_.size()
+              << ", 名字区: " << arena_.size() << " 字节, 三元组: " << trigrams_.size()
+              << ", 耗时: " << elapsed << "ms" << std::endl;
+    return true;
+}
+
+void NameIndex::insert(int id, const std::string& file_name, int is_directory,
+                       const std::string& parent_directory) {
+    std::string folded = NameMatcher::fold_name(file_name);
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    uint32_t parent_id = intern_directory(parent_directory);
+    uint8_t flags = make_flags(folded, is_directory, parent_id);
+
+    generation_++;
+    record_change(id);
+
+    // 新记录的 id 总是最大的，绝大多数情况直接追加
+    if (ids_.empty() || id > ids_.back()) {
+        append(id, folded, flags, parent_id);
+        return;
+    }
+
+    size_t pos = std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+    if (pos < ids_.size() && ids_[pos] == id) {
+        if (name_length(pos) == folded.size() &&
+            folded.compare(0, folded.size(), name_at(pos), folded.size()) == 0) {
+            // 名字没变，原地更新
+            if (flags_[pos] & FLAG_DELETED) {
+                deleted_count_--;
+            }
+            flags_[pos] = flags;
+            parents_[pos] = parent_id;
+            return;
+        }
+        // 改名：删除后在同一位置插入，其他记录的位置不变，只需把这条记录移出排序数组
+        unsort_slot(static_cast<uint32_t>(pos));
+        erase_at(pos);
+    } else {
+        // 乱序插入的新记录让后面的记录位置整体后移
+        invalidate_sorted();
+    }
+
+    insert_at(pos, id, folded, flags, parent_id);
+}
+
+void NameIndex::remove(int id) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    generation_++;
+    record_change(id);
+    mark_deleted(id);
+    compact_if_needed();
+}
+
+void NameIndex::remove(const std::vector<int>& ids) {
+    if (ids.empty()) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    generation_++;
+    for (int id : ids) {
+        record_change(id);
+        mark_deleted(id);
+    }
+    compact_if_needed();
+}
+
+void NameIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    arena_.clear();
+    offsets_.assign(1, 0);
+    ids_.clear();
+    flags_.clear();
+    parents_.clear();
+    deleted_count_ = 0;
+    trigrams_.clear();
+    invalidate_sorted();
+    reset_changes();
+}
+
+size_t NameIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return ids_.size() - deleted_count_;
+}
+
+size_t NameIndex::count_range(int min_id, int max_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const size_t lo = std::lower_bound(ids_.begin(), ids_.end(), min_id) - ids_.begin();
+    const size_t hi = std::upper_bound(ids_.begin(), ids_.end(), max_id) - ids_.begin();
+    if (lo >= hi) {
+        return 0;
+    }
+    if (deleted_count_ == 0) {
+        return hi - lo;
+    }
+    return std::count_if(flags_.begin() + lo, flags_.begin() + hi,
+                         [](uint8_t flags) { return (flags & FLAG_DELETED) == 0; });
+}
+
+int NameIndex::max_id() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return ids_.empty() ? 0 : ids_.back();
+}
+
+uint64_t NameIndex::generation() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return generation_;
+}
+
+bool NameIndex::changes_since(uint64_t since, std::vector<int>& ids, uint64_t& current) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    current = generation_;
+    ids.clear();
+    if (since < log_floor_) {
+        return false;
+    }
+
+    // 日志按代数递增，从尾部往前取即可
+    for (auto it = change_log_.rbegin(); it != change_log_.rend() && it->first > since; ++it) {
+        ids.push_back(it->second);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return true;
+}
+
+// 一组字面量的全部三元组（升序去重）
+static void collect_literal_trigrams(const std::vector<std::string>& literals, std::vector<uint32_t>& grams) {
+    std::vector<uint32_t> literal_grams;
+    for (const auto& literal : literals) {
+        collect_trigrams(literal.data(), literal.size(), literal_grams);
+        grams.insert(grams.end(), literal_grams.begin(), literal_grams.end());
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+}
+
+// 从尾到头逐字节比较两个名字
+static int compare_reversed(const char* a, size_t a_length, const char* b, size_t b_length) {
+    const size_t n = std::min(a_length, b_length);
+    for (size_t i = 1; i <= n; ++i) {
+        const unsigned char ca = static_cast<unsigned char>(a[a_length - i]);
+        const unsigned char cb = static_cast<unsigned char>(b[b_length - i]);
+        if (ca != cb) {
+            return ca < cb ? -1 : 1;
+        }
+    }
+    return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+bool NameIndex::find_candidates(const NameMatcher& matcher, std::vector<int>& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    if (anchored_candidates(matcher, out)) {
+        return true;
+    }
+
+    const auto& alternatives = matcher.literal_alternatives();
+    if (alternatives.empty()) {
+        return literal_candidates(matcher.literals(), out);
+    }
+
+    // 多组字面量取各组候选的并集，任何一组无法预筛选时只能扫描
+    std::vector<int> merged;
+    std::vector<int> part;
+    std::vector<int> next;
+    for (const auto& literals : alternatives) {
+        if (!literal_candidates(literals, part)) {
+            return false;
+        }
+        next.clear();
+        std::set_union(merged.begin(), merged.end(), part.begin(), part.end(), std::back_inserter(next));
+        merged.swap(next);
+        if (merged.size() * 4 > ids_.size()) {
+            return false;
+        }
+    }
+    out.swap(merged);
+    return true;
+}
+
+size_t NameIndex::estimate_matches(const NameMatcher& matcher) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const auto& alternatives = matcher.literal_alternatives();
+    if (alternatives.empty()) {
+        return literal_estimate(matcher.literals());
+    }
+
+    size_t total = 0;
+    for (const auto& literals : alternatives) {
+        total += literal_estimate(literals);
+    }
+    return std::min(total, ids_.size());
+}
+
+size_t NameIndex::literal_estimate(const std::vector<std::string>& literals) const {
+    std::vector<uint32_t> grams;
+    collect_literal_trigrams(literals, grams);
+
+    size_t best = ids_.size();
+    for (uint32_t gram : grams) {
+        auto it = trigrams_.find(gram);
+        if (it == trigrams_.end()) {
+            return 0;
+        }
+        best = std::min(best, static_cast<size_t>(it->second.count));
+    }
+    return best;
+}
+
+bool NameIndex::literal_candidates(const std::vector<std::string>& literals, std::vector<int>& out) const {
+    std::vector<uint32_t> grams;
+    collect_literal_trigrams(literals, grams);
+    if (grams.empty()) {
+        return false;
+    }
+
+    std::vector<const Posting*> lists;
+    for (uint32_t gram : grams) {
+        auto it = trigrams_.find(gram);
+        if (it == trigrams_.end()) {
+            out.clear();    // 有三元组从未出现过，不可能匹配
+            return true;
+        }
+        lists.push_back(&it->second);
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const Posting* a, const Posting* b) {
+        return a->count < b->count;
+    });
+
+    // 最短的表都覆盖了四分之一的记录，直接扫描名字区更快
+    if (static_cast<size_t>(lists[0]->count) * 4 > ids_.size()) {
+        return false;
+    }
+
+    out.clear();
+    out.reserve(lists[0]->count);
+    const uint8_t* p = lists[0]->data.data();
+    int id = 0;
+    for (uint32_t i = 0; i < lists[0]->count; ++i) {
+        id += static_cast<int>(get_varint(p));
+        out.push_back(id);
+    }
+
+    for (size_t i = 1; i < lists.size() && i < MAX_INTERSECT_LISTS && !out.empty(); ++i) {
+        // 表比候选集合大太多时，解码它比直接校验候选还慢
+        if (lists[i]->count > out.size() * 64) {
+            break;
+        }
+
+        const uint8_t* q = lists[i]->data.data();
+        int other = 0;
+        uint32_t remaining = lists[i]->count;
+        size_t kept = 0;
+        for (size_t j = 0; j < out.size(); ++j) {
+            while (remaining > 0 && other < out[j]) {
+                other += static_cast<int>(get_varint(q));
+                remaining--;
+            }
+            if (other == out[j]) {
+                out[kept++] = out[j];
+            } else if (other < out[j]) {
+                break;      // 这张表已经读完
+            }
+        }
+        out.resize(kept);
+    }
+
+    return true;
+}
+
+void NameIndex::search(const NameMatcher& matcher, int min_id, int max_id,
+                       bool include_hidden, int limit, std::vector<int>& out,
+                       const std::vector<int>* candidates, int threads,
+                       ScanBudget* budget) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const size_t lo = std::lower_bound(ids_.begin(), ids_.end(), min_id) - ids_.begin();
+    const size_t hi = std::upper_bound(ids_.begin(), ids_.end(), max_id) - ids_.begin();
+    if (lo >= hi) {
+        return;
+    }
+
+    const uint8_t reject = include_hidden ? FLAG_DELETED : (FLAG_DELETED | FLAG_HIDDEN);
+
+    size_t shards = 1;
+    if (threads > 1 && budget == nullptr) {
+        shards = std::min(static_cast<size_t>(threads), (hi - lo) / MIN_SHARD_SLOTS);
+    }
+
+    if (shards <= 1) {
+        scan_slots(matcher, lo, hi, reject, limit, candidates, out, budget);
+        return;
+    }
+
+    // 按记录位置切成连续的分片并行扫描，分片之间本身有序，按顺序拼接即为 id 升序
+    // 调用线程持有共享锁，工作线程只读，不需要再加锁
+    std::vector<std::vector<int>> shard_results(shards);
+    std::vector<std::thread> workers;
+    const size_t step = (hi - lo + shards - 1) / shards;
+    for (size_t i = 1; i < shards; ++i) {
+        const size_t shard_lo = lo + i * step;
+        const size_t shard_hi = std::min(hi, shard_lo + step);
+        workers.emplace_back([&, i, shard_lo, shard_hi]() {
+            scan_slots(matcher, shard_lo, shard_hi, reject, limit, candidates, shard_results[i]);
+        });
+    }
+    scan_slots(matcher, lo, std::min(hi, lo + step), reject, limit, candidates, shard_results[0]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    size_t appended = 0;
+    for (const auto& result : shard_results) {
+        size_t take = result.size();
+        if (limit > 0) {
+            take = std::min(take, static_cast<size_t>(limit) - appended);
+        }
+        out.insert(out.end(), result.begin(), result.begin() + take);
+        appended += take;
+    }
+}
+
+void NameIndex::visit_names(int min_id, int max_id, bool include_hidden,
+                            const std::function<void(int, const char*, size_t)>& visit,
+                            ScanBudget* budget) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    const size_t lo = std::lower_bound(ids_.begin(), ids_.end(), min_id) - ids_.begin();
+    const size_t hi = std::upper_bound(ids_.begin(), ids_.end(), max_id) - ids_.begin();
+    const uint8_t reject = include_hidden ? FLAG_DELETED : (FLAG_DELETED | FLAG_HIDDEN);
+
+    for (size_t slot = lo; slot < hi; ++slot) {
+        if (budget && (slot - lo + 1) % BUDGET_CHECK_INTERVAL == 0 && budget->used_up()) {
+            budget->exhausted = true;
+            budget->resume_id = ids_[slot];
+            return;
+        }
+        if ((flags_[slot] & reject) == 0) {
+            visit(ids_[slot], name_at(slot), name_length(slot));
+        }
+    }
+}
+
+void NameIndex::visit_ids(const std::vector<int>& ids,
+                          const std::function<void(int, const char*, size_t, int)>& visit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    size_t slot = 0;
+    for (int id : ids) {
+        slot = std::lower_bound(ids_.begin() + slot, ids_.end(), id) - ids_.begin();
+        if (slot >= ids_.size()) {
+            break;
+        }
+        if (ids_[slot] != id || (flags_[slot] & FLAG_DELETED) != 0) {
+            continue;
+        }
+        visit(id, name_at(slot), name_length(slot), directory_depth_[parents_[slot]] + 1);
+    }
+}
+
+void NameIndex::count_facets(const std::vector<int>& ids, FacetCounts& out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    // 先按父目录编号和指向名字区的扩展名计数，最后才转成字符串
+    std::unordered_map<uint32_t, size_t> parents;
+    std::unordered_map<std::string_view, size_t> extensions;
+
+    size_t slot = 0;
+    for (int id : ids) {
+        slot = std::lower_bound(ids_.begin() + slot, ids_.end(), id) - ids_.begin();
+        if (slot >= ids_.size()) {
+            break;
+        }
+        if (ids_[slot] != id || (flags_[slot] & FLAG_DELETED) != 0) {
+            continue;
+        }
+
+        const uint32_t parent = parents_[slot];
+        parents[parent]++;
+
+        if ((flags_[slot] & FLAG_DIRECTORY) != 0) {
+            out.directories++;
+            continue;
+        }
+        out.files++;
+        // 以 . 开头且没有其他 . 的名字（如 .bashrc）没有扩展名
+        const std::string_view name(name_at(slot), name_length(slot));
+        const size_t dot = name.rfind('.');
+        extensions[dot == std::string_view::npos || dot == 0 ? std::string_view() : name.substr(dot + 1)]++;
+    }
+
+    for (const auto& item : parents) {
+        out.parents[directories_[item.first]] += item.second;
+    }
+    for (const auto& item : extensions) {
+        out.extensions[std::string(item.first)] += item.second;
+    }
+}
+
+void NameIndex::scan_slots(const NameMatcher& matcher, size_t lo, size_t hi, uint8_t reject,
+                           int limit, const std::vector<int>* candidates, std::vector<int>& out,
+                           ScanBudget* budget) const {
+    if (lo >= hi) {
+        return;
+    }
+
+    size_t found = 0;
+
+    // 在匹配 slot 之前调用，超时时记下从哪里继续
+    size_t checked = 0;
+    auto out_of_time = [&](size_t slot) {
+        if (budget == nullptr || ++checked % BUDGET_CHECK_INTERVAL != 0 || !budget->used_up()) {
+            return false;
+        }
+        budget->exhausted = true;
+        budget->resume_id = ids_[slot];
+        return true;
+    };
+
+    if (candidates) {
+        // 只校验倒排表给出的候选
+        auto it = std::lower_bound(candidates->begin(), candidates->end(), ids_[lo]);
+        size_t slot = lo;
+        for (; it != candidates->end() && *it <= ids_[hi - 1]; ++it) {
+            slot = std::lower_bound(ids_.begin() + slot, ids_.begin() + hi, *it) - ids_.begin();
+            if (slot >= hi) {
+                break;
+            }
+            if (ids_[slot] != *it || (flags_[slot] & reject) != 0) {
+                continue;
+            }
+            if (out_of_time(slot)) {
+                return;
+            }
+            if (matcher.match(name_at(slot), name_length(slot))) {
+                out.push_back(ids_[slot]);
+                if (limit > 0 && ++found >= static_cast<size_t>(limit)) {
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    const std::string& literal = matcher.literal();
+    if (literal.empty()) {
+        // 模式中没有字面量（例如 "?" 或 "*"），只能逐个名字匹配
+        for (size_t slot = lo; slot < hi; ++slot) {
+            if (out_of_time(slot)) {
+                return;
+            }
+            if ((flags_[slot] & reject) == 0 && matcher.match(name_at(slot), name_length(slot))) {
+                out.push_back(ids_[slot]);
+                if (limit > 0 && ++found >= static_cast<size_t>(limit)) {
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    // 在整段名字区上查找字面量，命中后再定位到所属的名字
+    const char* base = arena_.data();
+    size_t pos = offsets_[lo];
+    const size_t end = offsets_[hi];
+    size_t slot = lo;
+
+    while (pos < end) {
+        const char* hit = NameMatcher::find_literal(base + pos, end - pos,
+                                                    literal.data(), literal.size());
+        if (hit == nullptr) {
+            break;
+        }
+
+        const uint32_t offset = static_cast<uint32_t>(hit - base);
+        slot = std::upper_bound(offsets_.begin() + slot, offsets_.begin() + hi + 1, offset)
+               - offsets_.begin() - 1;
+
+        if (offset + literal.size() > offsets_[slot] + name_length(slot)) {
+            // 命中跨过了名字结尾（只有模式里含 '\0' 才会发生）
+            pos = offset + 1;
+            continue;
+        }
+
+        if (out_of_time(slot)) {
+            return;
+        }
+        if ((flags_[slot] & reject) == 0 &&
+            (matcher.is_literal() || matcher.match(name_at(slot), name_length(slot)))) {
+            out.push_back(ids_[slot]);
+            if (limit > 0 && ++found >= static_cast<size_t>(limit)) {
+                return;
+            }
+        }
+
+        // 同一个名字只需命中一次，跳到下一个名字
+        pos = offsets_[slot + 1];
+        slot++;
+    }
+}
+
+void NameIndex::record_change(int id) {
+    change_log_.emplace_back(generation_, id);
+    if (change_log_.size() > MAX_CHANGE_LOG) {
+        // 被丢弃的这一代可能还有其他条目留在日志里，所以从这一代起就不再完整
+        log_floor_ = change_log_.front().first;
+        change_log_.pop_front();
+    }
+}
+
+void NameIndex::reset_changes() {
+    generation_++;
+    change_log_.clear();
+    log_floor_ = generation_;
+}
+
+uint32_t NameIndex::intern_directory(const std::string& directory) {
+    auto it = directory_ids_.find(directory);
+    if (it != directory_ids_.end()) {
+        return it->second;
+    }
+
+    uint32_t directory_id = static_cast<uint32_t>(directories_.size());
+    directories_.push_back(directory);
+    directory_hidden_.push_back(directory.find("/.") != std::string::npos ? 1 : 0);
+    // 根目录 "/" 记为 0，其余为其中 '/' 的个数，目录下的文件再加一层
+    const size_t slashes = directory == "/" ? 0 : std::count(directory.begin(), directory.end(), '/');
+    directory_depth_.push_back(static_cast<uint16_t>(std::min<size_t>(slashes, UINT16_MAX)));
+    directory_ids_.emplace(directory, directory_id);
+    return directory_id;
+}
+
+uint8_t NameIndex::make_flags(const std::string& folded_name, int is_directory, uint32_t parent) const {
+    uint8_t flags = 0;
+    if (is_directory) {
+        flags |= FLAG_DIRECTORY;
+    }
+    // 与原来的 file_path NOT LIKE '%/.%' 等价
+    if (directory_hidden_[parent] || (!folded_name.empty() && folded_name[0] == '.')) {
+        flags |= FLAG_HIDDEN;
+    }
+    return flags;
+}
+
+void NameIndex::add_trigrams(int id, const char* name, size_t length, bool in_order) {
+    std::vector<uint32_t> grams;
+    collect_trigrams(name, length, grams);
+
+    for (uint32_t gram : grams) {
+        Posting& posting = trigrams_[gram];
+        if (in_order && id > posting.last_id) {
+            put_varint(posting.data, static_cast<uint32_t>(id - posting.last_id));
+            posting.last_id = id;
+            posting.count++;
+            continue;
+        }
+
+        // 乱序插入：解码后插入再重新编码
+        std::vector<int> ids;
+        ids.reserve(posting.count + 1);
+        const uint8_t* p = posting.data.data();
+        int value = 0;
+        for (uint32_t i = 0; i < posting.count; ++i) {
+            value += static_cast<int>(get_varint(p));
+            ids.push_back(value);
+        }
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) {
+            continue;
+        }
+        ids.insert(it, id);
+
+        posting.data.clear();
+        posting.last_id = 0;
+        for (int entry : ids) {
+            put_varint(posting.data, static_cast<uint32_t>(entry - posting.last_id));
+            posting.last_id = entry;
+        }
+        posting.count = static_cast<uint32_t>(ids.size());
+    }
+}
+
+void NameIndex::rebuild_trigrams() {
+    trigrams_.clear();
+    for (size_t slot = 0; slot < ids_.size(); ++slot) {
+        if ((flags_[slot] & FLAG_DELETED) == 0) {
+            add_trigrams(ids_[slot], name_at(slot), name_length(slot), true);
+        }
+    }
+}
+
+bool NameIndex::anchored_candidates(const NameMatcher& matcher, std::vector<int>& out) const {
+    const std::string& prefix = matcher.anchored_prefix();
+    const std::string& suffix = matcher.anchored_suffix();
+    if (prefix.empty() && suffix.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> sorted_lock(sorted_mutex_);
+    ensure_sorted();
+
+    auto has_anchor = [&](uint32_t slot) {
+        const size_t length = name_length(slot);
+        if (!prefix.empty()) {
+            return length >= prefix.size() && memcmp(name_at(slot), prefix.data(), prefix.size()) == 0;
+        }
+        return length >= suffix.size() &&
+               memcmp(name_at(slot) + length - suffix.size(), suffix.data(), suffix.size()) == 0;
+    };
+
+    // 带锚点的名字在排序数组中是连续的一段：先二分出起点，再二分出第一个不带锚点的位置
+    const std::vector<uint32_t>& sorted = prefix.empty() ? sorted_by_reversed_ : sorted_by_name_;
+    auto begin = std::partition_point(sorted.begin(), sorted.end(), [&](uint32_t slot) {
+        if (!prefix.empty()) {
+            return std::string_view(name_at(slot), name_length(slot)) < std::string_view(prefix);
+        }
+        return compare_reversed(name_at(slot), name_length(slot), suffix.data(), suffix.size()) < 0;
+    });
+    auto end = std::partition_point(begin, sorted.end(), has_anchor);
+
+    // 一段占了四分之一的记录时，直接扫描名字区更快
+    if (static_cast<size_t>(end - begin) * 4 > ids_.size()) {
+        return false;
+    }
+
+    out.clear();
+    out.reserve(end - begin);
+    for (auto it = begin; it != end; ++it) {
+        if ((flags_[*it] & FLAG_DELETED) == 0) {
+            out.push_back(ids_[*it]);
+        }
+    }
+    for (uint32_t slot : unsorted_slots_) {
+        if ((flags_[slot] & FLAG_DELETED) == 0 && has_anchor(slot)) {
+            out.push_back(ids_[slot]);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return true;
+}
+
+void NameIndex::ensure_sorted() const {
+    if (sorted_built_ && (unsorted_slots_.size() < SORTED_REBUILD_MIN ||
+                          unsorted_slots_.size() * 16 < ids_.size())) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    sorted_by_name_.resize(ids_.size());
+    for (size_t slot = 0; slot < ids_.size(); ++slot) {
+        sorted_by_name_[slot] = static_cast<uint32_t>(slot);
+    }
+    sorted_by_reversed_ = sorted_by_name_;
+
+    // 两个数组互不相干，各用一个线程排序
+    std::thread reversed_sorter([this]() {
+        std::sort(sorted_by_reversed_.begin(), sorted_by_reversed_.end(), [this](uint32_t a, uint32_t b) {
+            return compare_reversed(name_at(a), name_length(a), name_at(b), name_length(b)) < 0;
+        });
+    });
+    std::sort(sorted_by_name_.begin(), sorted_by_name_.end(), [this](uint32_t a, uint32_t b) {
+        return std::string_view(name_at(a), name_length(a)) < std::string_view(name_at(b), name_length(b));
+    });
+    reversed_sorter.join();
+    unsorted_slots_.clear();
+    sorted_built_ = true;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "文件名索引排序数组建立完成 (" << key_sql_ << "), 记录数: " << ids_.size()
+              << ", 耗时: " << elapsed << "ms" << std::endl;
+}
+
+void NameIndex::unsort_slot(uint32_t slot) {
+    if (!sorted_built_ ||
+        std::find(unsorted_slots_.begin(), unsorted_slots_.end(), slot) != unsorted_slots_.end()) {
+        return;
+    }
+
+    // 按当前的名字二分到名字相同的一段，再在其中找到这个位置
+    const char* name = name_at(slot);
+    const size_t length = name_length(slot);
+    auto by_name = std::lower_bound(sorted_by_name_.begin(), sorted_by_name_.end(), slot,
+                                    [&](uint32_t a, uint32_t) {
+        return std::string_view(name_at(a), name_length(a)) < std::string_view(name, length);
+    });
+    while (by_name != sorted_by_name_.end() && *by_name != slot) {
+        ++by_name;
+    }
+    auto by_reversed = std::lower_bound(sorted_by_reversed_.begin(), sorted_by_reversed_.end(), slot,
+                                        [&](uint32_t a, uint32_t) {
+        return compare_reversed(name_at(a), name_length(a), name, length) < 0;
+    });
+    while (by_reversed != sorted_by_reversed_.end() && *by_reversed != slot) {
+        ++by_reversed;
+    }
+    if (by_name == sorted_by_name_.end() || by_reversed == sorted_by_reversed_.end()) {
+        invalidate_sorted();
+        return;
+    }
+    sorted_by_name_.erase(by_name);
+    sorted_by_reversed_.erase(by_reversed);
+    unsorted_slots_.push_back(slot);
+}
+
+void NameIndex::invalidate_sorted() {
+    if (!sorted_built_) {
+        return;
+    }
+    sorted_built_ = false;
+    sorted_by_name_.clear();
+    sorted_by_name_.shrink_to_fit();
+    sorted_by_reversed_.clear();
+    sorted_by_reversed_.shrink_to_fit();
+    unsorted_slots_.clear();
+}
+
+void NameIndex::append(int id, const std::string& folded_name, uint8_t flags, uint32_t parent) {
+    add_trigrams(id, folded_name.data(), folded_name.size(), true);
+    arena_.append(folded_name);
+    arena_.push_back('\0');
+    offsets_.push_back(static_cast<uint32_t>(arena_.size()));
+    ids_.push_back(id);
+    flags_.push_back(flags);
+    parents_.push_back(parent);
+    if (sorted_built_) {
+        unsorted_slots_.push_back(static_cast<uint32_t>(ids_.size() - 1));
+    }
+}
+
+void NameIndex::insert_at(size_t pos, int id, const std::string& folded_name, uint8_t flags, uint32_t parent) {
+    // id 乱序到达时才会走到这里（例如回滚后重新插入），需要整体搬移后续数据
+    add_trigrams(id, folded_name.data(), folded_name.size(), false);
+
+    const uint32_t length = static_cast<uint32_t>(folded_name.size() + 1);
+    arena_.insert(offsets_[pos], folded_name.c_str(), length);
+    offsets_.insert(offsets_.begin() + pos, offsets_[pos]);
+    for (size_t i = pos + 1; i < offsets_.size(); ++i) {
+        offsets_[i] += length;
+    }
+    ids_.insert(ids_.begin() + pos, id);
+    flags_.insert(flags_.begin() + pos, flags);
+    parents_.insert(parents_.begin() + pos, parent);
+}
+
+void NameIndex::erase_at(size_t pos) {
+    if (flags_[pos] & FLAG_DELETED) {
+        deleted_count_--;
+    }
+
+    const uint32_t length = offsets_[pos + 1] - offsets_[pos];
+    arena_.erase(offsets_[pos], length);
+    offsets_.erase(offsets_.begin() + pos);
+    for (size_t i = pos; i < offsets_.size(); ++i) {
+        offsets_[i] -= length;
+    }
+    ids_.erase(ids_.begin() + pos);
+    flags_.erase(flags_.begin() + pos);
+    parents_.erase(parents_.begin() + pos);
+}
+
+void NameIndex::mark_deleted(int id) {
+    auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (it == ids_.end() || *it != id) {
+        return;
+    }
+
+    size_t pos = it - ids_.begin();
+    if ((flags_[pos] & FLAG_DELETED) == 0) {
+        flags_[pos] |= FLAG_DELETED;
+        deleted_count_++;
+    }
+}
+
+void NameIndex::compact_if_needed() {
+    if (deleted_count_ < COMPACT_MIN_DELETED || deleted_count_ * 4 < ids_.size()) {
+        return;
+    }
+
+    std::string arena;
+    std::vector<uint32_t> offsets = {0};
+    std::vector<int> ids;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> parents;
+
+    const size_t live = ids_.size() - deleted_count_;
+    arena.reserve(arena_.size());
+    offsets.reserve(live + 1);
+    ids.reserve(live);
+    flags.reserve(live);
+    parents.reserve(live);
+
+    for (size_t slot = 0; slot < ids_.size(); ++slot) {
+        if (flags_[slot] & FLAG_DELETED) {
+            continue;
+        }
+        arena.append(name_at(slot), name_length(slot) + 1);
+        offsets.push_back(static_cast<uint32_t>(arena.size()));
+        ids.push_back(ids_[slot]);
+        flags.push_back(flags_[slot]);
+        parents.push_back(parents_[slot]);
+    }
+
+    std::cout << "文件名索引整理完成, 清除删除记录: " << deleted_count_ << std::endl;
+
+    arena_.swap(arena);
+    offsets_.swap(offsets);
+    ids_.swap(ids);
+    flags_.swap(flags);
+    parents_.swap(parents);
+    deleted_count_ = 0;
+    invalidate_sorted();
+
+    // 倒排表中删除的 id 一并清除
+    rebuild_trigrams();
+}
@@ -0,0 +1,198 @@
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <shared_mutex>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include "sqlite3.h"
+#include "NameMatcher.h"
+
+// 常驻内存的文件名索引，每个数据库（即每个 uid）一份，挂在 DBConnection 上共享
+// 折叠后的文件名连续存放在 arena_ 中（以 '\0' 分隔），offsets_ 记录每个名字的起始位置，
+// ids_ / flags_ / parents_ 是与之平行的数组。所有数组按 id 升序排列，
+// 因此 id 范围可以二分定位，子串查询可以直接在 arena_ 的一段连续内存上做 SIMD 扫描。
+// 另外维护一份字节三元组倒排表，字面量不短于 3 字节的查询可以先求交得到候选，
+// 只校验候选记录，代价与匹配数量相关而不是与索引大小相关。
+// 锚定在开头或结尾的模式（foo*、*.tar.gz）在按名字、按反转后的名字排好序的两个数组上二分出一段，
+// 代价为对数时间加上结果数，字面量再短（*.c）也适用。两个数组在第一次锚定查询时才建立。
+class NameIndex {
+public:
+    // 扫描的时间预算：到达 deadline 或 cancelled 被置位时停止扫描，exhausted 置位，
+    // resume_id 为下一条尚未扫描的记录 id，调用者从这里继续即可
+    struct ScanBudget {
+        std::chrono::steady_clock::time_point deadline;
+        const std::atomic<bool>* cancelled = nullptr;
+        bool exhausted = false;
+        int resume_id = 0;
+
+        bool used_up() const {
+            return (cancelled && cancelled->load(std::memory_order_relaxed)) ||
+                   std::chrono::steady_clock::now() >= deadline;
+        }
+    };
+
+    // key_sql 为加载时作为名字的 SQL 表达式，filter_sql 为可选的过滤条件，
+    // 默认索引折叠后的文件名；拼音索引只收录含汉字的文件名的拼音检索键
+    explicit NameIndex(const std::string& key_sql = "file_name_folded",
+                       const std::string& filter_sql = "");
+
+    // 禁止拷贝
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+
+    // 从 file_info 表重新加载全部记录
+    bool load(sqlite3* db);
+
+    // 插入或更新一条记录
+    void insert(int id, const std::string& file_name, int is_directory,
+                const std::string& parent_directory);
+    void remove(int id);
+    void remove(const std::vector<int>& ids);
+    void clear();
+
+    // 求出可能匹配的 id（升序）：锚定的模式用排序数组，否则用三元组倒排表
+    // 模式既不锚定、也没有不短于 3 字节的字面量，或者候选太多不如直接扫描时返回 false
+    bool find_candidates(const NameMatcher& matcher, std::vector<int>& out) const;
+
+    // 匹配数的上界：字面量的三元组中最短的倒排表长度，有多组字面量时各组相加；
+    // 没有可用的三元组时为记录数。只读倒排表的长度，不解码
+    size_t estimate_matches(const NameMatcher& matcher) const;
+
+    // 在 [min_id, max_id] 范围内查找匹配的记录，按 id 升序追加到 out，limit <= 0 表示不限制
+    // candidates 不为空时只校验其中的 id，否则扫描整个范围
+    // threads > 1 时把范围切成分片并行扫描，结果仍按 id 升序
+    // budget 不为空时串行扫描，超时后提前返回已找到的部分
+    void search(const NameMatcher& matcher, int min_id, int max_id,
+                bool include_hidden, int limit, std::vector<int>& out,
+                const std::vector<int>* candidates = nullptr, int threads = 1,
+                ScanBudget* budget = nullptr) const;
+
+    // 依次把 [min_id, max_id] 范围内的有效记录交给 visit(id, 折叠后的名字, 长度)，按 id 升序，调用期间持有读锁
+    // budget 的含义与 search 相同
+    void visit_names(int min_id, int max_id, bool include_hidden,
+                     const std::function<void(int, const char*, size_t)>& visit,
+                     ScanBudget* budget = nullptr) const;
+
+    // 对 ids（升序）中仍然有效的记录依次调用 visit(id, 折叠后的名字, 长度, 路径深度)
+    // 路径深度为路径中 '/' 的个数，根目录下的文件为 1
+    void visit_ids(const std::vector<int>& ids,
+                   const std::function<void(int, const char*, size_t, int)>& visit) const;
+
+    // 分面统计的计数，扩展名为折叠后名字中最后一个 . 之后的部分（没有时为空串），只统计文件
+    struct FacetCounts {
+        size_t files = 0;
+        size_t directories = 0;
+        std::unordered_map<std::string, size_t> extensions;
+        std::unordered_map<std::string, size_t> parents;
+    };
+
+    // 对 ids（升序）中仍然有效的记录做分面统计，累加到 out
+    void count_facets(const std::vector<int>& ids, FacetCounts& out) const;
+
+    // 有效记录数
+    size_t size() const;
+
+    // [min_id, max_id] 范围内的有效记录数
+    size_t count_range(int min_id, int max_id) const;
+
+    // 最大的记录 id，索引为空时为 0
+    int max_id() const;
+
+    // 每次修改都会递增的代数，用于判断缓存的搜索结果是否仍然有效
+    uint64_t generation() const;
+
+    // 取出代数 since 之后被修改过的 id（升序去重），current 为当前代数
+    // 修改日志只保留最近的一部分，since 早于日志起点时返回 false
+    bool changes_since(uint64_t since, std::vector<int>& ids, uint64_t& current) const;
+
+private:
+    enum : uint8_t {
+        FLAG_DIRECTORY = 0x01,
+        FLAG_HIDDEN    = 0x02,   // 路径中存在以 . 开头的组成部分
+        FLAG_DELETED   = 0x04,
+    };
+
+    uint32_t intern_directory(const std::string& directory);
+    uint8_t make_flags(const std::string& folded_name, int is_directory, uint32_t parent) const;
+    void append(int id, const std::string& folded_name, uint8_t flags, uint32_t parent);
+    void insert_at(size_t pos, int id, const std::string& folded_name, uint8_t flags, uint32_t parent);
+    void erase_at(size_t pos);
+    void mark_deleted(int id);
+    void compact_if_needed();
+    void record_change(int id);
+    void reset_changes();
+
+    // 扫描记录位置 [lo, hi)，调用者需持有锁
+    void scan_slots(const NameMatcher& matcher, size_t lo, size_t hi, uint8_t reject,
+                    int limit, const std::vector<int>* candidates, std::vector<int>& out,
+                    ScanBudget* budget = nullptr) const;
+
+    // 三元组倒排表：升序 id 的差值用 varint 编码，删除的 id 在整理时才清除
+    struct Posting {
+        std::vector<uint8_t> data;
+        int last_id = 0;
+        uint32_t count = 0;
+    };
+
+    void add_trigrams(int id, const char* name, size_t length, bool in_order);
+    // 包含 literals 中全部字面量的候选 id，语义同 find_candidates，调用者需持有锁
+    bool literal_candidates(const std::vector<std::string>& literals, std::vector<int>& out) const;
+    // 包含 literals 中全部字面量的记录数的上界，调用者需持有锁
+    size_t literal_estimate(const std::vector<std::string>& literals) const;
+    void rebuild_trigrams();
+
+    // 锚定的模式在排序数组上求候选，语义同 find_candidates，调用者需持有读锁
+    bool anchored_candidates(const NameMatcher& matcher, std::vector<int>& out) const;
+    // 排序数组不存在或积累了太多未排序的记录时重建，调用者需持有读锁与 sorted_mutex_
+    void ensure_sorted() const;
+    // 改名前把记录移出排序数组，放进 unsorted_slots_，调用者需持有写锁
+    void unsort_slot(uint32_t slot);
+    // 记录的位置整体移动后排序数组作废，调用者需持有写锁
+    void invalidate_sorted();
+
+    const char* name_at(size_t slot) const { return arena_.data() + offsets_[slot]; }
+    size_t name_length(size_t slot) const { return offsets_[slot + 1] - offsets_[slot] - 1; }
+
+    std::string key_sql_;
+    std::string filter_sql_;
+
+    mutable std::shared_mutex mutex_;
+
+    std::string arena_;
+    std::vector<uint32_t> offsets_ = {0};   // 比记录数多一个，末尾为 arena_ 的长度
+    std::vector<int> ids_;
+    std::vector<uint8_t> flags_;
+    std::vector<uint32_t> parents_;
+    size_t deleted_count_ = 0;
+
+    std::unordered_map<uint32_t, Posting> trigrams_;
+
+    // 锚定查询用的排序数组，保存记录位置：sorted_by_name_ 按名字的字节序，sorted_by_reversed_ 按从尾到头的字节序。
+    // 建立之后追加和改名的记录放在 unsorted_slots_ 中逐个校验；乱序插入与整理会移动记录位置，此时整体作废。
+    // 读者持有读锁时由 sorted_mutex_ 保护，写者持有写锁时可以直接修改
+    mutable std::mutex sorted_mutex_;
+    mutable bool sorted_built_ = false;
+    mutable std::vector<uint32_t> sorted_by_name_;
+    mutable std::vector<uint32_t> sorted_by_reversed_;
+    mutable std::vector<uint32_t> unsorted_slots_;
+
+    // 修改日志：(代数, id)，早于 log_floor_ 的修改已被丢弃
+    uint64_t generation_ = 0;
+    uint64_t log_floor_ = 0;
+    std::deque<std::pair<uint64_t, int>> change_log_;
+
+    // 父目录字符串池
+    std::vector<std::string> directories_;
+    std::vector<uint8_t> directory_hidden_;
+    std::vector<uint16_t> directory_depth_;
+    std::unordered_map<std::string, uint32_t> directory_ids_;
+};
+
+#endif // NAMEINDEX_H
@@ -0,0 +1,199 @@
+#include "NameMatcher.h"
+#include "Utils.h"
+#include "UnicodeFold.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool NameMatcher::is_anchored(const std::string& pattern) {
+    if (pattern.empty()) {
+        return false;
+    }
+    return (pattern.front() == '*') != (pattern.back() == '*');
+}
+
+std::string NameMatcher::substring_glob(const std::string& pattern) {
+    if (!is_anchored(pattern)) {
+        return "*" + pattern + "*";
+    }
+    return pattern;
+}
+
+NameMatcher::NameMatcher(const std::string& pattern) {
+    std::string folded = fold_name(pattern);
+    if (is_anchored(folded)) {
+        anchored_start_ = folded.back() == '*';
+        anchored_end_ = folded.front() == '*';
+    }
+
+    // 合并连续的 *，并在不锚定的一端补 *，得到子串语义
+    const std::string padded = substring_glob(folded);
+    glob_.reserve(padded.size());
+    for (char c : padded) {
+        if (c == '*' && !glob_.empty() && glob_.back() == '*') {
+            continue;
+        }
+        glob_ += c;
+    }
+
+    // 找出最长的字面量片段
+    size_t i = 0;
+    bool has_wildcard = false;
+    while (i < folded.size()) {
+        if (folded[i] == '*' || folded[i] == '?') {
+            has_wildcard = true;
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < folded.size() && folded[i] != '*' && folded[i] != '?') {
+            i++;
+        }
+        literals_.push_back(folded.substr(start, i - start));
+        if (i - start > literal_.size()) {
+            literal_ = literals_.back();
+        }
+    }
+
+    is_literal_ = !has_wildcard && !literal_.empty();
+
+    if (anchored_start_) {
+        anchored_prefix_ = folded.substr(0, folded.find_first_of("*?"));
+    } else if (anchored_end_) {
+        anchored_suffix_ = folded.substr(folded.find_last_of("*?") + 1);
+    }
+
+    has_question_ = folded.find('?') != std::string::npos;
+    if (!has_question_) {
+        size_t start = 0;
+        while (start <= folded.size()) {
+            size_t star = folded.find('*', start);
+            if (star == std::string::npos) {
+                star = folded.size();
+            }
+            if (star > start) {
+                segments_.push_back(folded.substr(start, star - start));
+            }
+            start = star + 1;
+        }
+    }
+}
+
+std::string NameMatcher::fold_name(const std::string& name) {
+    return unicode_fold(name);
+}
+
+bool NameMatcher::match(const char* name, size_t len) const {
+    if (is_literal_) {
+        return find_literal(name, len, literal_.data(), literal_.size()) != nullptr;
+    }
+
+    if (!has_question_) {
+        // 子串语义下最左匹配每一段即可，不需要回溯；锚定的一端只比较开头或结尾
+        size_t first = 0;
+        size_t last = segments_.size();
+        size_t pos = 0;
+        size_t end = len;
+        if (anchored_start_) {
+            const std::string& segment = segments_.front();
+            if (len < segment.size() || memcmp(name, segment.data(), segment.size()) != 0) {
+                return false;
+            }
+            pos = segment.size();
+            first++;
+        } else if (anchored_end_) {
+            const std::string& segment = segments_.back();
+            if (len < segment.size() || memcmp(name + len - segment.size(), segment.data(), segment.size()) != 0) {
+                return false;
+            }
+            end = len - segment.size();
+            last--;
+        }
+        for (size_t i = first; i < last; ++i) {
+            const std::string& segment = segments_[i];
+            const char* hit = find_literal(name + pos, end - pos, segment.data(), segment.size());
+            if (hit == nullptr) {
+                return false;
+            }
+            pos = (hit - name) + segment.size();
+        }
+        return true;
+    }
+
+    const char* p = glob_.data();
+    const size_t plen = glob_.size();
+    size_t pi = 0, si = 0;
+    size_t star = std::string::npos, mark = 0;
+
+    // 经典的回溯通配符匹配，只回溯到最近的一个 *，最坏 O(n*m)
+    while (si < len) {
+        if (pi < plen && p[pi] == '*') {
+            star = pi++;
+            mark = si;
+        } else if (pi < plen && p[pi] == '?') {
+            si += getUTF8CharLength(static_cast<unsigned char>(name[si]));
+            pi++;
+        } else if (pi < plen && p[pi] == name[si]) {
+            pi++;
+            si++;
+        } else if (star != std::string::npos) {
+            pi = star + 1;
+            mark += getUTF8CharLength(static_cast<unsigned char>(name[mark]));
+            si = mark;
+        } else {
+            return false;
+        }
+    }
+
+    if (si > len) {
+        return false;   // ? 跨过了被截断的 UTF-8 字符
+    }
+    while (pi < plen && p[pi] == '*') {
+        pi++;
+    }
+    return pi == plen;
+}
+
+const char* NameMatcher::find_literal(const char* hay, size_t n,
+                                      const char* needle, size_t m) {
+    if (m == 0) {
+        return hay;
+    }
+    if (m > n) {
+        return nullptr;
+    }
+    if (m == 1) {
+        return static_cast<const char*>(memchr(hay, needle[0], n));
+    }
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    // 同时比较首字节和尾字节，16 个候选位置一组，只对两端都命中的位置做 memcmp
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                          _mm_cmpeq_epi8(last, block_last))));
+        while (mask != 0) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (memcmp(hay + i + bit + 1, needle + 1, m - 2) == 0) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i + m <= n; ++i) {
+        if (hay[i] == needle[0] && hay[i + m - 1] == needle[m - 1] &&
+            memcmp(hay + i + 1, needle + 1, m - 2) == 0) {
+            return hay + i;
+        }
+    }
+    return nullptr;
+}
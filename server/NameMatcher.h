@@ -0,0 +1,71 @@
+#ifndef NAMEMATCHER_H
+#define NAMEMATCHER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// 文件名匹配器：每个搜索任务编译一次，供 NameIndex 扫描时反复调用
+// 模式中 * 匹配任意个字符，? 匹配单个 UTF-8 字符，其余字符（包括 % 和 _）按字面匹配
+// 与原来的 LIKE '%term%' 一样是子串语义，大小写不敏感（Unicode 折叠 + NFC，见 UnicodeFold.h）
+// 只有一端是 * 的模式锚定在另一端：*.tar.gz 匹配以 .tar.gz 结尾的名字，foo* 匹配以 foo 开头的名字
+// 其他匹配方式（例如正则表达式）可以派生并重写 match，同时给出必需的字面量供索引预筛选
+class NameMatcher {
+public:
+    explicit NameMatcher(const std::string& pattern);
+    virtual ~NameMatcher() = default;
+
+    // name 必须已经用 fold_name 折叠过
+    virtual bool match(const char* name, size_t len) const;
+
+    // 模式中最长的一段字面量，用于在名字区上做预筛选；为空表示无法预筛选
+    const std::string& literal() const { return literal_; }
+
+    // 模式按 * 和 ? 切开后的全部字面量片段，用于三元组索引求候选
+    const std::vector<std::string>& literals() const { return literals_; }
+
+    // 多组字面量，名字至少包含其中一组的全部字面量（例如 a|b 这样的多选）；非空时代替 literals() 求候选
+    const std::vector<std::vector<std::string>>& literal_alternatives() const { return alternatives_; }
+
+    // 模式本身就是一个字面量，命中预筛选即为匹配
+    bool is_literal() const { return is_literal_; }
+
+    // 锚定在开头的模式第一个通配符之前的字面量、锚定在结尾的模式最后一个通配符之后的字面量，
+    // 不锚定时为空；NameIndex 用它们在排好序的名字上二分
+    const std::string& anchored_prefix() const { return anchored_prefix_; }
+    const std::string& anchored_suffix() const { return anchored_suffix_; }
+
+    // 模式是否只有一端是 *，即锚定在另一端
+    static bool is_anchored(const std::string& pattern);
+
+    // 把模式补成 GlobPattern 使用的整值匹配模式：不锚定的一端补 *
+    static std::string substring_glob(const std::string& pattern);
+
+    // 折叠文件名，索引与模式必须使用同一规则
+    static std::string fold_name(const std::string& name);
+
+    // 在 [hay, hay + n) 中查找 needle，找不到返回 nullptr
+    static const char* find_literal(const char* hay, size_t n,
+                                    const char* needle, size_t m);
+
+protected:
+    NameMatcher() = default;
+
+    std::string literal_;
+    std::vector<std::string> literals_;
+    std::vector<std::vector<std::string>> alternatives_;
+    bool is_literal_ = false;
+    std::string anchored_prefix_;
+    std::string anchored_suffix_;
+
+private:
+    std::string glob_;       // 折叠后、不锚定的一端补上 * 的模式
+
+    // 不含 ? 时按 * 切开的各段字面量，依次查找即可完成匹配
+    std::vector<std::string> segments_;
+    bool has_question_ = false;
+    bool anchored_start_ = false;
+    bool anchored_end_ = false;
+};
+
+#endif // NAMEMATCHER_H
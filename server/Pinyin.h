@@ -0,0 +1,13 @@
+#ifndef PINYIN_H
+#define PINYIN_H
+
+#include <string>
+
+// 生成文件名的拼音检索键
+// full 为全拼：汉字换成不带声调的拼音（ü 记为 v），其余字符按 unicode_fold 折叠后原样保留，
+// initials 为首字母：每个汉字只取拼音的第一个字母，其余字符同上。
+// 例如 "报告v2.docx" 得到 "baogaov2.docx" 与 "bgv2.docx"。
+// 文件名中没有汉字时两者都置空并返回 false，这类文件不需要拼音检索。
+bool make_pinyin_keys(const std::string& name, std::string& full, std::string& initials);
+
+#endif // PINYIN_H
@@ -0,0 +1,802 @@
+#include "RegexMatcher.h"
+#include "UnicodeFold.h"
+#include <algorithm>
+#include <stdexcept>
+
+// 程序长度上限，{n,m} 展开后超过这个长度的模式拒绝编译
+static const size_t MAX_PROGRAM_SIZE = 20000;
+
+// 单个 {n,m} 的重复次数上限与括号嵌套深度上限
+static const int MAX_REPEAT = 1000;
+static const int MAX_DEPTH = 200;
+
+// 字面量分析时 exact 集合的大小与字符串长度上限
+static const size_t MAX_EXACT_STRINGS = 16;
+static const size_t MAX_EXACT_LENGTH = 64;
+
+// 非法的 UTF-8 字节映射到码位范围之外，只有 . 和取反的字符类能匹配
+static const uint32_t INVALID_BYTE_BASE = 0x110000;
+
+static void append_utf8(uint32_t c, std::string& out) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+static uint32_t decode_utf8(const unsigned char* s, size_t length, size_t& i) {
+    const unsigned char c = s[i];
+    size_t extra = 0;
+    uint32_t code_point = c;
+    if (c >= 0xF0 && c < 0xF8) {
+        extra = 3;
+        code_point = c & 0x07;
+    } else if (c >= 0xE0) {
+        extra = 2;
+        code_point = c & 0x0F;
+    } else if (c >= 0xC0) {
+        extra = 1;
+        code_point = c & 0x1F;
+    } else if (c >= 0x80) {
+        i++;
+        return INVALID_BYTE_BASE + c;
+    }
+
+    if (c >= 0xF8 || i + extra >= length) {
+        i++;
+        return INVALID_BYTE_BASE + c;
+    }
+    for (size_t k = 1; k <= extra; ++k) {
+        if ((s[i + k] & 0xC0) != 0x80) {
+            i++;
+            return INVALID_BYTE_BASE + c;
+        }
+        code_point = (code_point << 6) | (s[i + k] & 0x3F);
+    }
+    i += extra + 1;
+    return code_point;
+}
+
+// 单个码位折叠后的第一个码位
+static uint32_t fold_code_point(uint32_t c) {
+    std::string s;
+    append_utf8(c, s);
+    std::string folded = unicode_fold(s);
+    size_t i = 0;
+    return decode_utf8(reinterpret_cast<const unsigned char*>(folded.data()), folded.size(), i);
+}
+
+bool RegexMatcher::CharClass::contains(uint32_t c) const {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), c,
+        [](uint32_t value, const std::pair<uint32_t, uint32_t>& range) { return value < range.first; });
+    bool in = it != ranges.begin() && c <= (it - 1)->second;
+    return in != negated;
+}
+
+RegexMatcher::RegexMatcher(const std::string& pattern) : pattern_(pattern) {
+    int root = parse_alternation();
+    if (pos_ < pattern_.size()) {
+        throw std::invalid_argument("正则表达式中有多余的 )");
+    }
+
+    compile(root);
+    emit(Inst::MATCH);
+
+    // 必须出现的字面量交给索引做预筛选
+    Literals info = analyze(root);
+    if (info.exact_valid && info.exact.size() == 1) {
+        info.must.push_back(info.exact[0]);
+    }
+    for (const auto& literal : info.must) {
+        if (literal.empty() ||
+            std::find(literals_.begin(), literals_.end(), literal) != literals_.end()) {
+            continue;
+        }
+        literals_.push_back(literal);
+        if (literal.size() > literal_.size()) {
+            literal_ = literal;
+        }
+    }
+    is_literal_ = false;
+}
+
+int RegexMatcher::add_node(Node node) {
+    nodes_.push_back(std::move(node));
+    return static_cast<int>(nodes_.size() - 1);
+}
+
+int RegexMatcher::add_class(CharClass cls) {
+    normalize_class(cls);
+    classes_.push_back(std::move(cls));
+
+    Node node;
+    node.type = Node::CLASS;
+    node.cls = static_cast<int>(classes_.size() - 1);
+    return add_node(std::move(node));
+}
+
+int RegexMatcher::parse_alternation() {
+    int first = parse_concatenation();
+    if (pos_ >= pattern_.size() || pattern_[pos_] != '|') {
+        return first;
+    }
+
+    Node alt;
+    alt.type = Node::ALT;
+    alt.children.push_back(first);
+    while (pos_ < pattern_.size() && pattern_[pos_] == '|') {
+        pos_++;
+        alt.children.push_back(parse_concatenation());
+    }
+    return add_node(std::move(alt));
+}
+
+int RegexMatcher::parse_concatenation() {
+    Node concat;
+    concat.type = Node::CONCAT;
+    while (pos_ < pattern_.size() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+        concat.children.push_back(parse_repetition());
+    }
+
+    if (concat.children.empty()) {
+        return add_node(Node());
+    }
+    if (concat.children.size() == 1) {
+        return concat.children[0];
+    }
+    return add_node(std::move(concat));
+}
+
+int RegexMatcher::parse_repetition() {
+    int atom = parse_atom();
+
+    while (pos_ < pattern_.size()) {
+        const char c = pattern_[pos_];
+        int min = 0, max = 0;
+        if (c == '*') {
+            min = 0;
+            max = -1;
+            pos_++;
+        } else if (c == '+') {
+            min = 1;
+            max = -1;
+            pos_++;
+        } else if (c == '?') {
+            min = 0;
+            max = 1;
+            pos_++;
+        } else if (c == '{') {
+            // 不是合法的 {n} / {n,} / {n,m} 时按字面量处理
+            const size_t saved = pos_;
+            pos_++;
+            min = parse_number();
+            if (min < 0) {
+                pos_ = saved;
+                break;
+            }
+            max = min;
+            if (pos_ < pattern_.size() && pattern_[pos_] == ',') {
+                pos_++;
+                max = parse_number();
+            }
+            if (pos_ >= pattern_.size() || pattern_[pos_] != '}') {
+                pos_ = saved;
+                break;
+            }
+            pos_++;
+            if (min > MAX_REPEAT || max > MAX_REPEAT) {
+                throw std::invalid_argument("正则表达式重复次数过大");
+            }
+            if (max >= 0 && max < min) {
+                throw std::invalid_argument("正则表达式重复次数范围无效");
+            }
+        } else {
+            break;
+        }
+
+        // 非贪婪标记对是否匹配没有影响
+        if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+            pos_++;
+        }
+
+        Node repeat;
+        repeat.type = Node::REPEAT;
+        repeat.children.push_back(atom);
+        repeat.min = min;
+        repeat.max = max;
+        atom = add_node(std::move(repeat));
+    }
+
+    return atom;
+}
+
+int RegexMatcher::parse_atom() {
+    const char c = pattern_[pos_];
+    Node node;
+
+    switch (c) {
+    case '(': {
+        pos_++;
+        if (pattern_.compare(pos_, 2, "?:") == 0) {
+            pos_ += 2;
+        } else if (pos_ < pattern_.size() && pattern_[pos_] == '?') {
+            throw std::invalid_argument("不支持的正则表达式分组语法");
+        }
+        if (++depth_ > MAX_DEPTH) {
+            throw std::invalid_argument("正则表达式括号嵌套过深");
+        }
+        int inner = parse_alternation();
+        depth_--;
+        if (pos_ >= pattern_.size() || pattern_[pos_] != ')') {
+            throw std::invalid_argument("正则表达式缺少 )");
+        }
+        pos_++;
+        return inner;
+    }
+    case '[':
+        return parse_class();
+    case '.':
+        pos_++;
+        node.type = Node::ANY;
+        return add_node(std::move(node));
+    case '^':
+        pos_++;
+        node.type = Node::BOL;
+        return add_node(std::move(node));
+    case '$':
+        pos_++;
+        node.type = Node::EOL;
+        return add_node(std::move(node));
+    case '\\':
+        return parse_escape();
+    case '*':
+    case '+':
+    case '?':
+        throw std::invalid_argument("正则表达式中重复符号前缺少内容");
+    default:
+        return literal_node(next_code_point());
+    }
+}
+
+int RegexMatcher::parse_escape() {
+    pos_++;     // 跳过反斜杠
+    if (pos_ >= pattern_.size()) {
+        throw std::invalid_argument("正则表达式以 \\ 结尾");
+    }
+
+    const char e = pattern_[pos_];
+    switch (e) {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+        pos_++;
+        CharClass cls;
+        add_shorthand(static_cast<char>(e | 0x20), cls);
+        cls.negated = (e >= 'A' && e <= 'Z');
+        return add_class(std::move(cls));
+    }
+    case 't': pos_++; return literal_node('\t');
+    case 'n': pos_++; return literal_node('\n');
+    case 'r': pos_++; return literal_node('\r');
+    case 'f': pos_++; return literal_node('\f');
+    case 'v': pos_++; return literal_node('\v');
+    default:
+        if ((e >= 'a' && e <= 'z') || (e >= 'A' && e <= 'Z') || (e >= '0' && e <= '9')) {
+            throw std::invalid_argument(std::string("不支持的正则表达式转义 \\") + e);
+        }
+        return literal_node(next_code_point());
+    }
+}
+
+bool RegexMatcher::parse_class_escape(CharClass& cls, uint32_t& c) {
+    pos_++;     // 跳过反斜杠
+    if (pos_ >= pattern_.size()) {
+        throw std::invalid_argument("正则表达式以 \\ 结尾");
+    }
+
+    const char e = pattern_[pos_];
+    switch (e) {
+    case 'd': case 'w': case 's':
+        pos_++;
+        add_shorthand(e, cls);
+        return false;
+    case 'D': case 'W': case 'S':
+        throw std::invalid_argument("字符类中不支持取反的 \\D \\W \\S");
+    case 't': pos_++; c = '\t'; return true;
+    case 'n': pos_++; c = '\n'; return true;
+    case 'r': pos_++; c = '\r'; return true;
+    case 'f': pos_++; c = '\f'; return true;
+    case 'v': pos_++; c = '\v'; return true;
+    default:
+        if ((e >= 'a' && e <= 'z') || (e >= 'A' && e <= 'Z') || (e >= '0' && e <= '9')) {
+            throw std::invalid_argument(std::string("不支持的正则表达式转义 \\") + e);
+        }
+        c = next_code_point();
+        return true;
+    }
+}
+
+int RegexMatcher::parse_class() {
+    pos_++;     // 跳过 [
+    CharClass cls;
+    if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+        cls.negated = true;
+        pos_++;
+    }
+
+    bool first = true;
+    while (true) {
+        if (pos_ >= pattern_.size()) {
+            throw std::invalid_argument("正则表达式缺少 ]");
+        }
+        if (pattern_[pos_] == ']' && !first) {
+            pos_++;
+            break;
+        }
+        first = false;
+
+        uint32_t lo = 0;
+        if (pattern_[pos_] == '\\') {
+            if (!parse_class_escape(cls, lo)) {
+                continue;
+            }
+        } else {
+            lo = next_code_point();
+        }
+
+        uint32_t hi = lo;
+        if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+            pos_++;
+            if (pattern_[pos_] == '\\') {
+                if (!parse_class_escape(cls, hi)) {
+                    throw std::invalid_argument("正则表达式字符类范围无效");
+                }
+            } else {
+                hi = next_code_point();
+            }
+            if (hi < lo) {
+                throw std::invalid_argument("正则表达式字符类范围无效");
+            }
+        }
+        add_folded_range(cls, lo, hi);
+    }
+
+    return add_class(std::move(cls));
+}
+
+int RegexMatcher::parse_number() {
+    int value = -1;
+    while (pos_ < pattern_.size() && pattern_[pos_] >= '0' && pattern_[pos_] <= '9') {
+        value = (value < 0 ? 0 : value) * 10 + (pattern_[pos_] - '0');
+        if (value > MAX_REPEAT) {
+            value = MAX_REPEAT + 1;
+        }
+        pos_++;
+    }
+    return value;
+}
+
+uint32_t RegexMatcher::next_code_point() {
+    return decode_utf8(reinterpret_cast<const unsigned char*>(pattern_.data()), pattern_.size(), pos_);
+}
+
+int RegexMatcher::literal_node(uint32_t c) {
+    // 名字已经折叠过，模式中的字面量也按同样规则折叠，折叠后可能变成多个字符（例如 ß -> ss）
+    std::string s;
+    append_utf8(c, s);
+    const std::string folded = unicode_fold(s);
+
+    Node concat;
+    concat.type = Node::CONCAT;
+    size_t i = 0;
+    while (i < folded.size()) {
+        Node node;
+        node.type = Node::CHAR;
+        node.ch = decode_utf8(reinterpret_cast<const unsigned char*>(folded.data()), folded.size(), i);
+        concat.children.push_back(add_node(std::move(node)));
+    }
+
+    if (concat.children.size() == 1) {
+        return concat.children[0];
+    }
+    return add_node(std::move(concat));
+}
+
+void RegexMatcher::add_shorthand(char kind, CharClass& cls) {
+    switch (kind) {
+    case 'd':
+        cls.ranges.push_back({'0', '9'});
+        break;
+    case 'w':
+        // 没有 Unicode 字符属性表，非 ASCII 字符（包括汉字）都视为单词字符
+        cls.ranges.push_back({'0', '9'});
+        cls.ranges.push_back({'A', 'Z'});
+        cls.ranges.push_back({'_', '_'});
+        cls.ranges.push_back({'a', 'z'});
+        cls.ranges.push_back({0x80, 0x10FFFF});
+        break;
+    case 's':
+        cls.ranges.push_back({'\t', '\r'});
+        cls.ranges.push_back({' ', ' '});
+        cls.ranges.push_back({0xA0, 0xA0});
+        cls.ranges.push_back({0x3000, 0x3000});
+        break;
+    }
+}
+
+void RegexMatcher::add_folded_range(CharClass& cls, uint32_t lo, uint32_t hi) {
+    cls.ranges.push_back({lo, hi});
+
+    // 名字中只会出现折叠后的字符，把范围内的字符折叠后也加进来
+    if (hi - lo <= 512) {
+        for (uint32_t c = lo; c <= hi; ++c) {
+            uint32_t folded = fold_code_point(c);
+            if (folded != c) {
+                cls.ranges.push_back({folded, folded});
+            }
+        }
+    } else if (lo <= 'Z' && hi >= 'A') {
+        cls.ranges.push_back({std::max<uint32_t>(lo, 'A') + 32, std::min<uint32_t>(hi, 'Z') + 32});
+    }
+}
+
+void RegexMatcher::normalize_class(CharClass& cls) {
+    auto& ranges = cls.ranges;
+    std::sort(ranges.begin(), ranges.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (kept > 0 && ranges[i].first <= ranges[kept - 1].second + 1) {
+            ranges[kept - 1].second = std::max(ranges[kept - 1].second, ranges[i].second);
+        } else {
+            ranges[kept++] = ranges[i];
+        }
+    }
+    ranges.resize(kept);
+}
+
+int RegexMatcher::emit(Inst::Op op, uint32_t arg, int x, int y) {
+    if (program_.size() >= MAX_PROGRAM_SIZE) {
+        throw std::invalid_argument("正则表达式过于复杂");
+    }
+    program_.push_back(Inst{op, arg, x, y});
+    return static_cast<int>(program_.size() - 1);
+}
+
+void RegexMatcher::compile(int index) {
+    const Node& node = nodes_[index];
+
+    switch (node.type) {
+    case Node::EMPTY:
+        break;
+    case Node::CHAR:
+        emit(Inst::CHAR, node.ch);
+        break;
+    case Node::ANY:
+        emit(Inst::ANY);
+        break;
+    case Node::CLASS:
+        emit(Inst::CLASS, static_cast<uint32_t>(node.cls));
+        break;
+    case Node::BOL:
+        emit(Inst::BOL);
+        break;
+    case Node::EOL:
+        emit(Inst::EOL);
+        break;
+    case Node::CONCAT:
+        for (int child : node.children) {
+            compile(child);
+        }
+        break;
+    case Node::ALT: {
+        // SPLIT 分支, 下一个 SPLIT；每个分支结束后跳到末尾
+        std::vector<int> jumps;
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            if (i + 1 < node.children.size()) {
+                int split = emit(Inst::SPLIT);
+                program_[split].x = split + 1;
+                compile(node.children[i]);
+                jumps.push_back(emit(Inst::JMP));
+                program_[split].y = static_cast<int>(program_.size());
+            } else {
+                compile(node.children[i]);
+            }
+        }
+        for (int jump : jumps) {
+            program_[jump].x = static_cast<int>(program_.size());
+        }
+        break;
+    }
+    case Node::REPEAT: {
+        const int child = node.children[0];
+        for (int i = 0; i < node.min; ++i) {
+            compile(child);
+        }
+        if (node.max < 0) {
+            int split = emit(Inst::SPLIT);
+            program_[split].x = split + 1;
+            compile(child);
+            emit(Inst::JMP, 0, split);
+            program_[split].y = static_cast<int>(program_.size());
+        } else {
+            std::vector<int> splits;
+            for (int i = node.min; i < node.max; ++i) {
+                int split = emit(Inst::SPLIT);
+                program_[split].x = split + 1;
+                splits.push_back(split);
+                compile(child);
+            }
+            for (int split : splits) {
+                program_[split].y = static_cast<int>(program_.size());
+            }
+        }
+        break;
+    }
+    }
+}
+
+RegexMatcher::Literals RegexMatcher::analyze(int index) const {
+    const Node& node = nodes_[index];
+    Literals info;
+
+    // 只保留一个字符串时它就是必须出现的字面量
+    auto flush = [](const std::vector<std::string>& exact, std::vector<std::string>& must) {
+        if (exact.size() == 1 && !exact[0].empty()) {
+            must.push_back(exact[0]);
+        }
+    };
+
+    switch (node.type) {
+    case Node::EMPTY:
+    case Node::BOL:
+    case Node::EOL:
+        info.exact_valid = true;
+        info.exact.push_back("");
+        break;
+    case Node::CHAR:
+        info.exact_valid = true;
+        info.exact.push_back("");
+        append_utf8(node.ch, info.exact[0]);
+        break;
+    case Node::ANY:
+        break;
+    case Node::CLASS: {
+        const CharClass& cls = classes_[node.cls];
+        size_t count = 0;
+        for (const auto& range : cls.ranges) {
+            count += range.second - range.first + 1;
+        }
+        if (!cls.negated && count <= MAX_EXACT_STRINGS / 2) {
+            info.exact_valid = true;
+            for (const auto& range : cls.ranges) {
+                for (uint32_t c = range.first; c <= range.second; ++c) {
+                    info.exact.push_back("");
+                    append_utf8(c, info.exact.back());
+                }
+            }
+        }
+        break;
+    }
+    case Node::CONCAT: {
+        // 相邻的 exact 部分做笛卡尔积，积太大或遇到不能精确描述的部分时把已有结果收进 must
+        std::vector<std::string> current = {""};
+        bool all_exact = true;
+        for (int child : node.children) {
+            Literals sub = analyze(child);
+            info.must.insert(info.must.end(), sub.must.begin(), sub.must.end());
+
+            if (!sub.exact_valid) {
+                flush(current, info.must);
+                current = {""};
+                all_exact = false;
+                continue;
+            }
+
+            std::vector<std::string> product;
+            bool fits = current.size() * sub.exact.size() <= MAX_EXACT_STRINGS;
+            for (size_t i = 0; fits && i < current.size(); ++i) {
+                for (const auto& suffix : sub.exact) {
+                    if (current[i].size() + suffix.size() > MAX_EXACT_LENGTH) {
+                        fits = false;
+                        break;
+                    }
+                    product.push_back(current[i] + suffix);
+                }
+            }
+            if (fits) {
+                current.swap(product);
+            } else {
+                flush(current, info.must);
+                current = sub.exact;
+                all_exact = false;
+            }
+        }
+        if (all_exact) {
+            info.exact_valid = true;
+            info.exact.swap(current);
+        } else {
+            flush(current, info.must);
+        }
+        break;
+    }
+    case Node::ALT: {
+        // 每个分支都必须出现的字面量才是整体必须的
+        info.exact_valid = true;
+        for (size_t i = 0; i < node.children.size(); ++i) {
+            Literals sub = analyze(node.children[i]);
+            if (i == 0) {
+                info.must = sub.must;
+                flush(sub.exact_valid ? sub.exact : std::vector<std::string>(), info.must);
+            } else {
+                std::vector<std::string> branch_must = sub.must;
+                flush(sub.exact_valid ? sub.exact : std::vector<std::string>(), branch_must);
+                std::vector<std::string> common;
+                for (const auto& literal : info.must) {
+                    if (std::find(branch_must.begin(), branch_must.end(), literal) != branch_must.end()) {
+                        common.push_back(literal);
+                    }
+                }
+                info.must.swap(common);
+            }
+
+            if (info.exact_valid && sub.exact_valid &&
+                info.exact.size() + sub.exact.size() <= MAX_EXACT_STRINGS) {
+                info.exact.insert(info.exact.end(), sub.exact.begin(), sub.exact.end());
+            } else {
+                info.exact_valid = false;
+                info.exact.clear();
+            }
+        }
+        break;
+    }
+    case Node::REPEAT: {
+        if (node.min == 0) {
+            if (node.max == 0) {
+                info.exact_valid = true;
+                info.exact.push_back("");
+            }
+            break;
+        }
+        Literals sub = analyze(node.children[0]);
+        info.must = sub.must;
+        if (sub.exact_valid && sub.exact.size() == 1 && node.min == node.max &&
+            sub.exact[0].size() * node.min <= MAX_EXACT_LENGTH) {
+            info.exact_valid = true;
+            info.exact.push_back("");
+            for (int i = 0; i < node.min; ++i) {
+                info.exact[0] += sub.exact[0];
+            }
+        } else if (sub.exact_valid) {
+            flush(sub.exact, info.must);
+        }
+        break;
+    }
+    }
+
+    return info;
+}
+
+bool RegexMatcher::match(const char* name, size_t len) const {
+    // 每个线程一份工作区，搜索分片在多个线程上并发调用
+    struct Scratch {
+        std::vector<int> current, next, stack;
+        std::vector<uint32_t> current_mark, next_mark;
+        uint32_t stamp = 0;
+    };
+    thread_local Scratch scratch;
+
+    const size_t size = program_.size();
+    if (scratch.current_mark.size() < size) {
+        scratch.current_mark.resize(size, 0);
+        scratch.next_mark.resize(size, 0);
+    }
+    if (scratch.stamp > 0xFFFFFF00u) {
+        std::fill(scratch.current_mark.begin(), scratch.current_mark.end(), 0);
+        std::fill(scratch.next_mark.begin(), scratch.next_mark.end(), 0);
+        scratch.stamp = 0;
+    }
+
+    // 把 pc 及其经由空转移可达的状态加入列表
+    auto add_thread = [&](std::vector<int>& list, std::vector<uint32_t>& mark, uint32_t stamp,
+                          int start, size_t pos) {
+        auto& stack = scratch.stack;
+        stack.clear();
+        stack.push_back(start);
+        while (!stack.empty()) {
+            int pc = stack.back();
+            stack.pop_back();
+            if (mark[pc] == stamp) {
+                continue;
+            }
+            mark[pc] = stamp;
+
+            const Inst& inst = program_[pc];
+            switch (inst.op) {
+            case Inst::JMP:
+                stack.push_back(inst.x);
+                break;
+            case Inst::SPLIT:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case Inst::BOL:
+                if (pos == 0) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            case Inst::EOL:
+                if (pos == len) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            default:
+                list.push_back(pc);
+                break;
+            }
+        }
+    };
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(name);
+    auto& current = scratch.current;
+    auto& next = scratch.next;
+    current.clear();
+    uint32_t current_stamp = ++scratch.stamp;
+    size_t pos = 0;
+
+    while (true) {
+        // 子串语义：每个位置都可以开始一次新的匹配
+        add_thread(current, scratch.current_mark, current_stamp, 0, pos);
+
+        if (pos >= len) {
+            for (int pc : current) {
+                if (program_[pc].op == Inst::MATCH) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t next_pos = pos;
+        const uint32_t c = decode_utf8(bytes, len, next_pos);
+
+        next.clear();
+        const uint32_t next_stamp = ++scratch.stamp;
+        for (int pc : current) {
+            const Inst& inst = program_[pc];
+            bool advance = false;
+            switch (inst.op) {
+            case Inst::MATCH:
+                return true;
+            case Inst::CHAR:
+                advance = (c == inst.arg);
+                break;
+            case Inst::ANY:
+                advance = true;
+                break;
+            case Inst::CLASS:
+                advance = classes_[inst.arg].contains(c);
+                break;
+            default:
+                break;
+            }
+            if (advance) {
+                add_thread(next, scratch.next_mark, next_stamp, pc + 1, next_pos);
+            }
+        }
+
+        current.swap(next);
+        scratch.current_mark.swap(scratch.next_mark);
+        current_stamp = next_stamp;
+        pos = next_pos;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef REGEXMATCHER_H
+#define REGEXMATCHER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "NameMatcher.h"
+
+// 正则表达式文件名匹配器
+// 编译为 Thompson NFA，用 Pike VM 同时推进所有状态，匹配时间与 名字长度 x 程序长度 成正比，
+// 不会像回溯引擎那样因为病态模式指数爆炸。只判断是否匹配，不记录分组。
+// 支持：字面量、.、[...] / [^...]、\d \w \s 及其大写取反、( )、(?: )、|、* + ? {n} {n,} {n,m}、^ $
+// 与文件名搜索一样是子串语义（不加 ^ $ 时可以匹配名字的任意一段），并且按 Unicode 折叠后大小写不敏感。
+// 构造时分析出任何匹配都必须包含的字面量，填入 literal() / literals()，
+// NameIndex 据此用三元组倒排表或名字区扫描预筛选，只对剩下的名字运行正则。
+class RegexMatcher : public NameMatcher {
+public:
+    // 模式非法或过于复杂时抛出 std::invalid_argument
+    explicit RegexMatcher(const std::string& pattern);
+
+    bool match(const char* name, size_t len) const override;
+
+private:
+    struct Node {
+        enum Type { EMPTY, CHAR, ANY, CLASS, CONCAT, ALT, REPEAT, BOL, EOL } type = EMPTY;
+        uint32_t ch = 0;
+        int cls = -1;
+        std::vector<int> children;
+        int min = 0;
+        int max = 0;        // -1 表示不限
+    };
+
+    struct CharClass {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;   // 升序且互不重叠
+        bool negated = false;
+
+        bool contains(uint32_t c) const;
+    };
+
+    struct Inst {
+        enum Op { CHAR, ANY, CLASS, SPLIT, JMP, MATCH, BOL, EOL } op;
+        uint32_t arg = 0;   // CHAR 的码位或 CLASS 的下标
+        int x = 0;
+        int y = 0;
+    };
+
+    // 字面量分析结果：exact 为该部分可能匹配的全部字符串（有限且较少时），must 为必须出现的字符串
+    struct Literals {
+        bool exact_valid = false;
+        std::vector<std::string> exact;
+        std::vector<std::string> must;
+    };
+
+    // 解析
+    int parse_alternation();
+    int parse_concatenation();
+    int parse_repetition();
+    int parse_atom();
+    int parse_class();
+    int parse_escape();
+    bool parse_class_escape(CharClass& cls, uint32_t& c);
+    int parse_number();
+    uint32_t next_code_point();
+    int literal_node(uint32_t c);
+    int add_node(Node node);
+    int add_class(CharClass cls);
+    static void add_shorthand(char kind, CharClass& cls);
+    static void add_folded_range(CharClass& cls, uint32_t lo, uint32_t hi);
+    static void normalize_class(CharClass& cls);
+
+    // 编译
+    void compile(int node);
+    int emit(Inst::Op op, uint32_t arg = 0, int x = 0, int y = 0);
+
+    Literals analyze(int node) const;
+
+    std::string pattern_;
+    size_t pos_ = 0;
+    int depth_ = 0;
+
+    std::vector<Node> nodes_;
+    std::vector<CharClass> classes_;
+    std::vector<Inst> program_;
+};
+
+#endif // REGEXMATCHER_H
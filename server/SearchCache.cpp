@@ -0,0 +1,135 @@
+#include "SearchCache.h"
+#include "NameMatcher.h"
+#include <iostream>
+
+SearchCache::SearchCache(size_t max_bytes) : max_bytes_(max_bytes) {
+}
+
+std::string SearchCache::make_key(const std::string& pattern, const std::string& search_field,
+                                  bool include_hidden) {
+    // 大小写与连续的 * 不影响匹配结果
+    std::string normalized;
+    normalized.reserve(pattern.size());
+    for (char c : NameMatcher::fold_name(pattern)) {
+        if (c == '*' && !normalized.empty() && normalized.back() == '*') {
+            continue;
+        }
+        normalized += c;
+    }
+
+    return search_field + '\x1f' + (include_hidden ? "1" : "0") + '\x1f' + normalized;
+}
+
+bool SearchCache::get(const std::string& key, Entry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+        misses_++;
+        return false;
+    }
+
+    lru_.splice(lru_.begin(), lru_, it->second);
+    entry = it->second->entry;
+    hits_++;
+    return true;
+}
+
+bool SearchCache::find_refinable(const std::string& key, Entry& entry) {
+    const size_t offset = pattern_offset(key);
+    const std::string pattern = key.substr(offset);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::list<Node>::iterator best = lru_.end();
+    for (auto it = lru_.begin(); it != lru_.end(); ++it) {
+        const std::string& other = it->key;
+        if (other.size() >= key.size() || other.compare(0, offset, key, 0, offset) != 0) {
+            continue;
+        }
+
+        // 空模式或只有 * 的结果就是全部记录，用来细化没有意义
+        const size_t length = other.size() - offset;
+        if (length == 0 || (length == 1 && other[offset] == '*')) {
+            continue;
+        }
+        // 锚定的模式（*.tar）不是子串语义，出现在更长的模式（*.tar.gz）中并不意味着结果是子集
+        if (NameMatcher::is_anchored(other.substr(offset))) {
+            continue;
+        }
+        if (pattern.find(other.c_str() + offset, 0, length) == std::string::npos) {
+            continue;
+        }
+        if (best == lru_.end() || it->entry.ids->size() < best->entry.ids->size()) {
+            best = it;
+        }
+    }
+
+    if (best == lru_.end()) {
+        return false;
+    }
+
+    entry = best->entry;
+    lru_.splice(lru_.begin(), lru_, best);
+    refines_++;
+    return true;
+}
+
+void SearchCache::put(const std::string& key, std::shared_ptr<const std::vector<int>> ids,
+                      uint64_t generation) {
+    const size_t bytes = key.size() + ids->size() * sizeof(int) + sizeof(Node);
+    if (bytes > max_bytes_) {
+        return;     // 单个结果就超过上限，不缓存
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+        used_bytes_ -= it->second->bytes;
+        lru_.erase(it->second);
+        map_.erase(it);
+    }
+
+    Node node;
+    node.key = key;
+    node.entry.ids = std::move(ids);
+    node.entry.generation = generation;
+    node.bytes = bytes;
+
+    lru_.push_front(std::move(node));
+    map_[key] = lru_.begin();
+    used_bytes_ += bytes;
+
+    evict();
+}
+
+void SearchCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    map_.clear();
+    used_bytes_ = 0;
+}
+
+size_t SearchCache::pattern_offset(const std::string& key) {
+    // 键的格式为 字段 \x1f 隐藏标志 \x1f 模式
+    return key.find('\x1f', key.find('\x1f') + 1) + 1;
+}
+
+void SearchCache::evict() {
+    size_t evicted = 0;
+    while (used_bytes_ > max_bytes_ && !lru_.empty()) {
+        const Node& node = lru_.back();
+        used_bytes_ -= node.bytes;
+        map_.erase(node.key);
+        lru_.pop_back();
+        evicted++;
+    }
+    if (evicted == 0) {
+        return;
+    }
+
+    std::cout << "搜索缓存淘汰 " << evicted << " 条" << ", 条目数 " << lru_.size() << ", 占用 " << used_bytes_
+              << " 字节, 命中 " << hits_ << ", 未命中 " << misses_
+              << ", 细化 " << refines_ << std::endl;
+}
@@ -0,0 +1,60 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// 每个 uid 一份的搜索结果缓存
+// 以 (搜索字段, 是否包含隐藏, 规范化后的模式) 为键，保存完整的匹配 id 列表以及求出它时索引的代数。
+// 代数与 NameIndex::generation() 一致时可以直接使用；不一致时由调用者决定修补或丢弃。
+// 总内存超过上限时按 LRU 淘汰。
+class SearchCache {
+public:
+    struct Entry {
+        std::shared_ptr<const std::vector<int>> ids;
+        uint64_t generation = 0;
+    };
+
+    explicit SearchCache(size_t max_bytes = 64 * 1024 * 1024);
+
+    // 禁止拷贝
+    SearchCache(const SearchCache&) = delete;
+    SearchCache& operator=(const SearchCache&) = delete;
+
+    static std::string make_key(const std::string& pattern, const std::string& search_field,
+                                bool include_hidden);
+
+    bool get(const std::string& key, Entry& entry);
+    // 查找可以用来细化的结果：字段和隐藏标志相同，且模式是 key 中模式的真子串（锚定的模式除外）
+    // 新模式的匹配集合一定包含在这样的结果之中，有多个时取最小的一个
+    bool find_refinable(const std::string& key, Entry& entry);
+    void put(const std::string& key, std::shared_ptr<const std::vector<int>> ids, uint64_t generation);
+    void clear();
+
+private:
+    struct Node {
+        std::string key;
+        Entry entry;
+        size_t bytes = 0;
+    };
+
+    void evict();
+    static size_t pattern_offset(const std::string& key);
+
+    size_t max_bytes_;
+    size_t used_bytes_ = 0;
+    std::list<Node> lru_;     // 表头为最近使用
+    std::unordered_map<std::string, std::list<Node>::iterator> map_;
+    std::mutex mutex_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t refines_ = 0;
+};
+
+#endif // SEARCHCACHE_H
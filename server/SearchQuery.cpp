@@ -0,0 +1,243 @@
+#include "SearchQuery.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+static std::string to_lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+static std::string to_upper(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::toupper(c); });
+    return s;
+}
+
+// 取出值开头的比较运算符，没有时为 =
+static std::string take_operator(std::string& value) {
+    for (const char* op : {">=", "<=", ">", "<", "="}) {
+        const size_t length = strlen(op);
+        if (value.compare(0, length, op) == 0) {
+            value.erase(0, length);
+            return op;
+        }
+    }
+    return "=";
+}
+
+static void split_values(const std::string& value, std::vector<std::string>& out) {
+    std::string current;
+    for (char c : value) {
+        if (c == ';' || c == ',') {
+            if (!current.empty()) {
+                out.push_back(current);
+            }
+            current.clear();
+        } else {
+            current += c;
+        }
+    }
+    if (!current.empty()) {
+        out.push_back(current);
+    }
+}
+
+static QueryFilter parse_extension(const std::string& value) {
+    // 扩展名按 std::filesystem::path::extension() 保存，带 . 且保留原大小写；
+    // 用 IN 列出常见的几种写法，而不是 COLLATE NOCASE，这样仍能走 idx_file_extension
+    std::vector<std::string> values;
+    split_values(value, values);
+
+    QueryFilter filter;
+    filter.index = "idx_file_extension";
+    for (auto extension : values) {
+        if (extension[0] == '.') {
+            extension.erase(0, 1);
+        }
+        if (extension.empty()) {
+            continue;
+        }
+        for (const auto& variant : {"." + extension, "." + to_lower(extension), "." + to_upper(extension)}) {
+            if (std::find(filter.params.begin(), filter.params.end(), variant) == filter.params.end()) {
+                filter.params.push_back(variant);
+            }
+        }
+    }
+    if (filter.params.empty()) {
+        throw std::invalid_argument("ext: 缺少扩展名");
+    }
+
+    filter.sql = "file_extension IN (";
+    for (size_t i = 0; i < filter.params.size(); ++i) {
+        filter.sql += i == 0 ? "?" : ", ?";
+    }
+    filter.sql += ")";
+    return filter;
+}
+
+static QueryFilter parse_type(const std::string& value) {
+    const std::string type = to_lower(value);
+
+    QueryFilter filter;
+    if (type == "dir" || type == "folder" || type == "directory" || type == "file") {
+        filter.index = "idx_is_directory";
+        filter.sql = "is_directory = ?";
+        filter.params.push_back(type == "file" ? "0" : "1");
+    } else if (type.find('/') != std::string::npos) {
+        filter.index = "idx_mime_type";
+        filter.sql = "mime_type = ?";
+        filter.params.push_back(type);
+    } else {
+        // MIME 大类：'0' 紧跟在 '/' 之后，[type/, type0) 恰好是以 type/ 开头的全部取值
+        filter.index = "idx_mime_type";
+        filter.sql = "mime_type >= ? AND mime_type < ?";
+        filter.params.push_back(type + "/");
+        filter.params.push_back(type + "0");
+    }
+    return filter;
+}
+
+static QueryFilter parse_size(std::string value) {
+    const std::string op = take_operator(value);
+
+    size_t digits = 0;
+    while (digits < value.size() && (std::isdigit(static_cast<unsigned char>(value[digits])) || value[digits] == '.')) {
+        digits++;
+    }
+    if (digits == 0) {
+        throw std::invalid_argument("size: 的值无效: " + value);
+    }
+
+    const std::string unit = to_lower(value.substr(digits));
+    double multiplier = 0;
+    if (unit.empty() || unit == "b") {
+        multiplier = 1;
+    } else if (unit == "k" || unit == "kb") {
+        multiplier = 1024.0;
+    } else if (unit == "m" || unit == "mb") {
+        multiplier = 1024.0 * 1024;
+    } else if (unit == "g" || unit == "gb") {
+        multiplier = 1024.0 * 1024 * 1024;
+    } else if (unit == "t" || unit == "tb") {
+        multiplier = 1024.0 * 1024 * 1024 * 1024;
+    } else {
+        throw std::invalid_argument("size: 的单位无效: " + unit);
+    }
+
+    double number = 0;
+    size_t parsed = 0;
+    try {
+        number = std::stod(value.substr(0, digits), &parsed);
+    } catch (const std::exception&) {
+        parsed = 0;
+    }
+    if (parsed != digits) {
+        throw std::invalid_argument("size: 的值无效: " + value);
+    }
+    // 超出 long long 范围时 llround 的结果没有定义，直接拒绝
+    const double bytes_value = number * multiplier;
+    if (!(bytes_value < static_cast<double>(LLONG_MAX))) {
+        throw std::invalid_argument("size: 的值过大: " + value);
+    }
+    const long long bytes = std::llround(bytes_value);
+
+    // 大小只对文件有意义
+    QueryFilter filter;
+    filter.index = "idx_file_size";
+    filter.sql = "file_size " + op + " ? AND is_directory = 0";
+    filter.params.push_back(std::to_string(bytes));
+    return filter;
+}
+
+static QueryFilter parse_modified(std::string value) {
+    const std::string op = take_operator(value);
+
+    // 修改时间按 YYYY-MM-DDTHH:MM:SS 保存，日期部分可以省略后面的字段
+    std::replace(value.begin(), value.end(), ' ', 'T');
+    if (value.empty() || value.find_first_not_of("0123456789-T:") != std::string::npos) {
+        throw std::invalid_argument("modified: 的日期无效: " + value);
+    }
+
+    // 以 value 开头的时间都落在 [value, upper) 内
+    const std::string upper = value + "\x7f";
+
+    QueryFilter filter;
+    filter.index = "idx_modified_time";
+    if (op == ">") {
+        filter.sql = "modified_time >= ?";
+        filter.params.push_back(upper);
+    } else if (op == ">=") {
+        filter.sql = "modified_time >= ?";
+        filter.params.push_back(value);
+    } else if (op == "<") {
+        filter.sql = "modified_time < ?";
+        filter.params.push_back(value);
+    } else if (op == "<=") {
+        filter.sql = "modified_time < ?";
+        filter.params.push_back(upper);
+    } else {
+        filter.sql = "modified_time >= ? AND modified_time < ?";
+        filter.params.push_back(value);
+        filter.params.push_back(upper);
+    }
+    return filter;
+}
+
+SearchQuery parse_search_query(const std::string& input) {
+    SearchQuery query;
+
+    size_t pos = 0;
+    while (pos < input.size()) {
+        const size_t begin = input.find_first_not_of(" \t", pos);
+        if (begin == std::string::npos) {
+            break;
+        }
+        // 与 BooleanMatcher 一致：引号内的空白不分隔，引号括起的部分原样保留
+        size_t end = begin;
+        bool quoted = false;
+        bool has_quote = false;
+        while (end < input.size() && (quoted || (input[end] != ' ' && input[end] != '\t'))) {
+            if (input[end] == '"') {
+                quoted = !quoted;
+                has_quote = true;
+            }
+            end++;
+        }
+        pos = end;
+
+        const std::string token = input.substr(begin, end - begin);
+        // 带引号的词按字面匹配，不当作过滤条件
+        const size_t colon = has_quote ? std::string::npos : token.find(':');
+        const std::string key = colon == std::string::npos ? "" : to_lower(token.substr(0, colon));
+        const std::string value = colon == std::string::npos ? "" : token.substr(colon + 1);
+
+        if (key != "ext" && key != "type" && key != "size" && key != "modified") {
+            if (!query.text.empty()) {
+                query.text += ' ';
+            }
+            query.text += token;
+            continue;
+        }
+        if (value.empty()) {
+            throw std::invalid_argument(key + ": 缺少值");
+        }
+
+        QueryFilter filter;
+        if (key == "ext") {
+            filter = parse_extension(value);
+        } else if (key == "type") {
+            filter = parse_type(value);
+        } else if (key == "size") {
+            filter = parse_size(value);
+        } else {
+            filter = parse_modified(value);
+        }
+        filter.name = token;
+        query.filters.push_back(std::move(filter));
+    }
+
+    return query;
+}
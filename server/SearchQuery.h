@@ -0,0 +1,28 @@
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <string>
+#include <vector>
+
+// 搜索文本中的结构化过滤条件，例如 "report ext:pdf;docx size:>10mb modified:>=2026-01-01 type:dir"
+//   ext:pdf;docx       扩展名（不区分 . 与大小写），多个用 ; 或 , 分隔
+//   type:dir / file    目录或文件；type:image 按 MIME 大类，type:image/png 按完整 MIME 类型
+//   size:>10mb         文件大小，支持 > >= < <= =，单位 b k kb m mb g gb t tb（1024 进制）
+//   modified:>=2026-01 修改时间，日期可以只写到年或月，>D 表示整个 D 时间段之后，<=D 表示截至 D 时间段结束
+// 不认识的 key:value 和带引号的词按普通文本处理，其余文本作为文件名搜索词
+struct QueryFilter {
+    std::string name;                  // 条件原文，用于日志
+    std::string index;                 // 作为驱动条件时使用的索引
+    std::string sql;                   // WHERE 子句片段，参数用 ? 占位
+    std::vector<std::string> params;   // 按顺序绑定的参数
+};
+
+struct SearchQuery {
+    std::string text;                  // 去掉过滤条件后的文件名搜索词
+    std::vector<QueryFilter> filters;
+};
+
+// 解析搜索文本，过滤条件的值非法时抛出 std::invalid_argument
+SearchQuery parse_search_query(const std::string& input);
+
+#endif // SEARCHQUERY_H
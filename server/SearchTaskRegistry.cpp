@@ -0,0 +1,164 @@
+#include "SearchTaskRegistry.h"
+#include "FileDB.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// 回收线程两次检查之间的最长间隔
+static const std::chrono::seconds REAP_INTERVAL(30);
+
+SearchTaskRegistry::SearchTaskRegistry(size_t max_tasks, std::chrono::seconds idle_ttl,
+                                       ReleaseCallback on_release)
+    : max_tasks_(std::max<size_t>(max_tasks, 1)), idle_ttl_(idle_ttl), on_release_(std::move(on_release)) {
+}
+
+SearchTaskRegistry::~SearchTaskRegistry() {
+    stop();
+}
+
+void SearchTaskRegistry::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stop_cv_.notify_all();
+    if (reaper_thread_.joinable()) {
+        reaper_thread_.join();
+    }
+}
+
+void SearchTaskRegistry::add(const std::shared_ptr<SearchTask>& task) {
+    std::vector<std::shared_ptr<SearchTask>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_ && !reaper_thread_.joinable()) {
+            // 只有提供搜索的 FileDB 才需要回收线程，扫描器使用的 FileDB 从不创建任务
+            reaper_thread_ = std::thread(&SearchTaskRegistry::reaper_loop, this);
+        }
+
+        if (!task->nested) {
+            size_t counted = 0;
+            for (const auto& item : tasks_) {
+                if (!item.second.task->nested) {
+                    counted++;
+                }
+            }
+            // 挤掉最久没有访问的任务，直到能放下新任务
+            while (counted >= max_tasks_) {
+                auto oldest = tasks_.end();
+                for (auto it = tasks_.begin(); it != tasks_.end(); ++it) {
+                    if (!it->second.task->nested &&
+                        (oldest == tasks_.end() || it->second.last_access < oldest->second.last_access)) {
+                        oldest = it;
+                    }
+                }
+                evicted.push_back(oldest->second.task);
+                tasks_.erase(oldest);
+                counted--;
+                stats_.evicted++;
+            }
+        }
+
+        tasks_[task->task_id] = Entry{task, std::chrono::steady_clock::now()};
+        stats_.created++;
+    }
+
+    for (const auto& old : evicted) {
+        std::cout << "搜索任务数达到上限, 淘汰任务: " << old->task_id << std::endl;
+        release(old);
+    }
+}
+
+std::shared_ptr<SearchTask> SearchTaskRegistry::find(const std::string& task_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tasks_.find(task_id);
+    if (it == tasks_.end()) {
+        return nullptr;
+    }
+    it->second.last_access = std::chrono::steady_clock::now();
+    return it->second.task;
+}
+
+std::shared_ptr<SearchTask> SearchTaskRegistry::remove(const std::string& task_id) {
+    std::shared_ptr<SearchTask> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tasks_.find(task_id);
+        if (it == tasks_.end()) {
+            return nullptr;
+        }
+        task = std::move(it->second.task);
+        tasks_.erase(it);
+    }
+    // 可能还有一批正在执行，让它尽快停下
+    task->cancel_requested = true;
+    return task;
+}
+
+void SearchTaskRegistry::mark_completed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.completed++;
+}
+
+size_t SearchTaskRegistry::reap() {
+    std::vector<std::shared_ptr<SearchTask>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = tasks_.begin(); it != tasks_.end();) {
+            if (!it->second.task->nested && now - it->second.last_access >= idle_ttl_) {
+                expired.push_back(std::move(it->second.task));
+                it = tasks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        stats_.expired += expired.size();
+    }
+
+    for (const auto& task : expired) {
+        release(task);
+    }
+    return expired.size();
+}
+
+SearchTaskRegistry::Stats SearchTaskRegistry::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats result = stats_;
+    result.live = tasks_.size();
+    result.memory_bytes = 0;
+    for (const auto& item : tasks_) {
+        result.memory_bytes += item.second.task->memory_bytes;
+    }
+    return result;
+}
+
+void SearchTaskRegistry::reaper_loop() {
+    // 检查间隔不超过 idle_ttl 的一半，任务最多在空闲 1.5 倍 idle_ttl 后被回收
+    const std::chrono::seconds interval = std::min(REAP_INTERVAL, std::max(idle_ttl_ / 2, std::chrono::seconds(1)));
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        stop_cv_.wait_for(lock, interval, [this]() { return stopping_; });
+        if (stopping_) {
+            break;
+        }
+
+        lock.unlock();
+        const size_t reaped = reap();
+        if (reaped > 0) {
+            const Stats current = stats();
+            std::cout << "回收空闲搜索任务 " << reaped << " 个, 存活: " << current.live
+                      << ", 约 " << current.memory_bytes / 1024 << " KB"
+                      << ", 累计创建: " << current.created << ", 正常结束: " << current.completed
+                      << ", 超时回收: " << current.expired << ", 超额淘汰: " << current.evicted << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+void SearchTaskRegistry::release(const std::shared_ptr<SearchTask>& task) {
+    task->cancel_requested = true;
+    if (on_release_) {
+        on_release_(task);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef SEARCHTASKREGISTRY_H
+#define SEARCHTASKREGISTRY_H
+
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+struct SearchTask;
+
+// 每个 uid 一份的搜索任务表
+// 客户端崩溃、关闭窗口或丢失响应时不会再来取结果，也不会发 DELETE，这样的任务由后台线程按空闲时间回收；
+// 任务数达到上限时，新任务挤掉最久没有访问的任务。被回收或挤掉的任务会被取消，
+// 再交给 on_release 释放它在别处占用的资源（例如共享索引中的子任务）。
+// 共享索引中代表其他用户任务的子任务（SearchTask::nested）不计入上限也不按空闲时间回收，随父任务一起清理。
+class SearchTaskRegistry {
+public:
+    struct Stats {
+        size_t live = 0;            // 当前存活的任务数
+        size_t memory_bytes = 0;    // 存活任务占用内存的估计
+        uint64_t created = 0;       // 累计创建
+        uint64_t completed = 0;     // 累计正常结束
+        uint64_t expired = 0;       // 累计因空闲超时被回收
+        uint64_t evicted = 0;       // 累计因数量上限被挤掉
+    };
+
+    using ReleaseCallback = std::function<void(const std::shared_ptr<SearchTask>&)>;
+
+    SearchTaskRegistry(size_t max_tasks, std::chrono::seconds idle_ttl, ReleaseCallback on_release);
+    ~SearchTaskRegistry();
+
+    // 禁止拷贝
+    SearchTaskRegistry(const SearchTaskRegistry&) = delete;
+    SearchTaskRegistry& operator=(const SearchTaskRegistry&) = delete;
+
+    // 加入任务，第一次调用时启动回收线程
+    void add(const std::shared_ptr<SearchTask>& task);
+    // 查找任务并刷新访问时间，不存在时返回空
+    std::shared_ptr<SearchTask> find(const std::string& task_id);
+    // 从表中移除任务并置位它的取消标志，不存在时返回空
+    std::shared_ptr<SearchTask> remove(const std::string& task_id);
+    // 一个任务正常结束
+    void mark_completed();
+    // 回收空闲超过 idle_ttl 的任务，返回回收的个数
+    size_t reap();
+
+    Stats stats();
+    // 停止并等待回收线程，之后不再启动
+    void stop();
+
+private:
+    struct Entry {
+        std::shared_ptr<SearchTask> task;
+        std::chrono::steady_clock::time_point last_access;
+    };
+
+    void reaper_loop();
+    // 取消被回收或挤掉的任务并释放它的资源，调用时不能持有 mutex_
+    void release(const std::shared_ptr<SearchTask>& task);
+
+    size_t max_tasks_;
+    std::chrono::seconds idle_ttl_;
+    ReleaseCallback on_release_;
+
+    std::unordered_map<std::string, Entry> tasks_;
+    std::mutex mutex_;
+    Stats stats_;
+
+    std::condition_variable stop_cv_;
+    bool stopping_ = false;
+    std::thread reaper_thread_;
+};
+
+#endif // SEARCHTASKREGISTRY_H
@@ -0,0 +1,238 @@
+#include "StandingQueries.h"
+#include "FileDB.h"
+#include "UnicodeFold.h"
+#include <iostream>
+#include <chrono>
+#include <unordered_map>
+
+// 每个查询最多保留的变化条数，客户端落后更多时只能取全部结果
+static const size_t MAX_STANDING_LOG = 4096;
+
+StandingQueries::StandingQueries() {
+    version_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+bool StandingQueries::load(sqlite3* db) {
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT id, query_text, mode, root, include_hidden, created_time "
+                      "FROM standing_queries ORDER BY id";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "加载常驻查询失败: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    auto column_text = [stmt](int column) -> std::string {
+        const unsigned char* text = sqlite3_column_text(stmt, column);
+        return text ? reinterpret_cast<const char*>(text) : "";
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queries_.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        Query query;
+        query.definition.id = sqlite3_column_int(stmt, 0);
+        query.definition.text = column_text(1);
+        query.definition.mode = column_text(2);
+        query.definition.root = column_text(3);
+        query.definition.include_hidden = sqlite3_column_int(stmt, 4) != 0;
+        query.definition.created_time = column_text(5);
+        queries_.emplace(query.definition.id, std::move(query));
+    }
+    sqlite3_finalize(stmt);
+
+    std::cout << "常驻查询加载完成, 数量: " << queries_.size() << std::endl;
+    return true;
+}
+
+void StandingQueries::add(const Definition& definition) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Query query;
+    query.definition = definition;
+    queries_[definition.id] = std::move(query);
+}
+
+bool StandingQueries::remove(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queries_.erase(id) > 0;
+}
+
+std::vector<StandingQueries::Definition> StandingQueries::list() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Definition> definitions;
+    definitions.reserve(queries_.size());
+    for (const auto& item : queries_) {
+        definitions.push_back(item.second.definition);
+    }
+    return definitions;
+}
+
+bool StandingQueries::get(int id, Definition& definition) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = queries_.find(id);
+    if (it == queries_.end()) {
+        return false;
+    }
+    definition = it->second.definition;
+    return true;
+}
+
+size_t StandingQueries::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queries_.size();
+}
+
+bool StandingQueries::fetch(int id, uint64_t since, const Evaluator& evaluate, Delta& delta) {
+    // 求值期间一直持有锁：同时到达的修改在索引更新之后才会进入 on_insert，
+    // 等求值结束后再按集合的当前状态校验一遍，不会丢失
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = queries_.find(id);
+    if (it == queries_.end()) {
+        return false;
+    }
+    Query& query = it->second;
+
+    if (!query.matcher) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<int> ids;
+        std::shared_ptr<NameMatcher> matcher = evaluate(query.definition, ids);
+        if (!matcher) {
+            return false;
+        }
+        query.matcher = matcher;
+        query.ids = std::set<int>(ids.begin(), ids.end());
+        query.log.clear();
+        query.floor = ++version_;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "常驻查询求值: " << id << " (" << query.definition.text << "), 匹配数: "
+                  << query.ids.size() << ", 耗时: " << elapsed << "ms" << std::endl;
+    }
+
+    delta = Delta();
+    delta.version = version_;
+    if (since == 0 || since < query.floor || since > version_) {
+        delta.reset = true;
+        delta.added.assign(query.ids.begin(), query.ids.end());
+        return true;
+    }
+
+    // 同一条记录只保留最后一次变化
+    std::unordered_map<int, bool> last;
+    std::vector<int> order;
+    for (auto entry = query.log.rbegin(); entry != query.log.rend() && entry->first > since; ++entry) {
+        const int record_id = entry->second < 0 ? -entry->second : entry->second;
+        if (last.emplace(record_id, entry->second > 0).second) {
+            order.push_back(record_id);
+        }
+    }
+    for (auto record_id = order.rbegin(); record_id != order.rend(); ++record_id) {
+        (last[*record_id] ? delta.added : delta.removed).push_back(*record_id);
+    }
+    return true;
+}
+
+bool StandingQueries::matches(const Query& query, const FileInfo& file_info, const std::string& folded_name) {
+    const Definition& definition = query.definition;
+    // 与文件名索引的隐藏标记相同：父目录路径中有以 . 开头的部分，或名字本身以 . 开头
+    if (!definition.include_hidden &&
+        (file_info.parent_directory.find("/.") != std::string::npos ||
+         (!folded_name.empty() && folded_name[0] == '.'))) {
+        return false;
+    }
+    if (!definition.root.empty()) {
+        const std::string& parent = file_info.parent_directory;
+        const bool under = parent.size() > definition.root.size() &&
+                           parent.compare(0, definition.root.size(), definition.root) == 0 &&
+                           parent[definition.root.size()] == '/';
+        if (parent != definition.root && !under) {
+            return false;
+        }
+    }
+    if (query.matcher->match(folded_name.data(), folded_name.size())) {
+        return true;
+    }
+    // 拼音模式与拼音索引一致：全拼和首字母分别匹配
+    if (definition.mode == "pinyin" && !file_info.file_name_pinyin.empty()) {
+        const std::string& full = file_info.file_name_pinyin;
+        const std::string& initials = file_info.file_name_initials;
+        return query.matcher->match(full.data(), full.size()) ||
+               query.matcher->match(initials.data(), initials.size());
+    }
+    return false;
+}
+
+void StandingQueries::record(Query& query, int id) {
+    query.log.emplace_back(version_, id);
+    if (query.log.size() > MAX_STANDING_LOG) {
+        // 被丢弃的这一版本之前的变化不再完整
+        query.floor = query.log.front().first;
+        query.log.pop_front();
+    }
+}
+
+void StandingQueries::on_insert(int id, const FileInfo& file_info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string folded_name;
+    bool folded = false;
+    for (auto& item : queries_) {
+        Query& query = item.second;
+        if (!query.matcher) {
+            continue;
+        }
+        if (!folded) {
+            folded_name = unicode_fold(file_info.file_name);
+            folded = true;
+        }
+        if (matches(query, file_info, folded_name)) {
+            // 已在集合中的记录内容可能变了（大小、修改时间），同样作为新增交给客户端替换
+            query.ids.insert(id);
+            ++version_;
+            record(query, id);
+        } else if (query.ids.erase(id) > 0) {
+            ++version_;
+            record(query, -id);
+        }
+    }
+}
+
+void StandingQueries::on_remove(const std::vector<int>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& item : queries_) {
+        Query& query = item.second;
+        if (!query.matcher || query.ids.empty()) {
+            continue;
+        }
+        for (int id : ids) {
+            if (query.ids.erase(id) > 0) {
+                ++version_;
+                record(query, -id);
+            }
+        }
+    }
+}
+
+void StandingQueries::on_clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 之前的版本都不再有效，客户端下次刷新时取到空的全部结果
+    ++version_;
+    for (auto& item : queries_) {
+        Query& query = item.second;
+        query.ids.clear();
+        query.log.clear();
+        query.floor = version_;
+    }
+}
+
+void StandingQueries::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++version_;
+    for (auto& item : queries_) {
+        Query& query = item.second;
+        query.matcher.reset();
+        query.ids.clear();
+        query.log.clear();
+        query.floor = version_;
+    }
+}
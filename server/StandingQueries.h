@@ -0,0 +1,91 @@
+#ifndef STANDINGQUERIES_H
+#define STANDINGQUERIES_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include "sqlite3.h"
+#include "NameMatcher.h"
+
+struct FileInfo;
+
+// 常驻查询：按 uid 保存的搜索，定义存放在 standing_queries 表中，每个数据库一份，挂在 DBConnection 上共享。
+// 第一次取结果时求出一次匹配集合，之后扫描器、文件监控对 file_info 的每次增删改都经 FileDB 的
+// index_insert / index_remove 交给 on_insert / on_remove，逐个已求值的查询校验变化的这一条记录，增量维护集合。
+// 刷新时只需取出当前集合或某个版本之后的变化，不再重新扫描。
+class StandingQueries {
+public:
+    struct Definition {
+        int id = 0;
+        std::string text;               // 搜索文本（未折叠）
+        std::string mode;               // 空为文件名，pinyin 或 regex
+        std::string root;               // 只保留该目录及其子目录下的记录，空表示不限
+        bool include_hidden = false;
+        std::string created_time;
+    };
+
+    // version 之前的状态到当前状态的变化：added 为新增或内容有变化的记录，removed 为移出集合的记录。
+    // reset 为 true 时 since 太旧（或来自服务重启之前），added 为当前的全部匹配，调用者应丢弃已有的结果
+    struct Delta {
+        uint64_t version = 0;
+        bool reset = false;
+        std::vector<int> added;
+        std::vector<int> removed;
+    };
+
+    // 第一次取结果时求出匹配集合（升序）并返回编译好的匹配器，失败时返回空
+    using Evaluator = std::function<std::shared_ptr<NameMatcher>(const Definition&, std::vector<int>&)>;
+
+    StandingQueries();
+
+    // 禁止拷贝
+    StandingQueries(const StandingQueries&) = delete;
+    StandingQueries& operator=(const StandingQueries&) = delete;
+
+    // 从 standing_queries 表加载全部定义，匹配集合在第一次取结果时才求出
+    bool load(sqlite3* db);
+
+    void add(const Definition& definition);
+    bool remove(int id);
+    std::vector<Definition> list() const;
+    bool get(int id, Definition& definition) const;
+
+    // 取出 since 之后的变化，since 为 0 时返回全部匹配；查询不存在或求值失败时返回 false
+    bool fetch(int id, uint64_t since, const Evaluator& evaluate, Delta& delta);
+
+    // 变更流：插入或更新了一条记录、删除了一批记录、清空了数据库
+    void on_insert(int id, const FileInfo& file_info);
+    void on_remove(const std::vector<int>& ids);
+    void on_clear();
+    // 事务回滚：已记录的集合与变化都不再可信，丢弃求值结果，下次取结果时重新求值并返回 reset
+    void invalidate();
+
+    size_t size() const;
+
+private:
+    struct Query {
+        Definition definition;
+        std::shared_ptr<NameMatcher> matcher;   // 为空表示还没有求值
+        std::set<int> ids;
+        // 变化日志：(版本, id)，移出集合的记录 id 取相反数；floor 之前的变化已被丢弃
+        std::deque<std::pair<uint64_t, int>> log;
+        uint64_t floor = 0;
+    };
+
+    // 校验一条记录是否满足查询，folded_name 为折叠后的文件名
+    static bool matches(const Query& query, const FileInfo& file_info, const std::string& folded_name);
+    void record(Query& query, int id);
+
+    mutable std::mutex mutex_;
+    std::map<int, Query> queries_;
+    // 所有查询共用的版本号，每次变化递增；从启动时刻的微秒数开始，重启前的版本号总是早于 floor
+    uint64_t version_ = 0;
+};
+
+#endif // STANDINGQUERIES_H
@@ -0,0 +1,55 @@
+#include "TaskExecutor.h"
+#include <algorithm>
+
+TaskExecutor::TaskExecutor(size_t threads) : thread_count_(std::max<size_t>(threads, 1)) {
+}
+
+TaskExecutor::~TaskExecutor() {
+    stop();
+}
+
+void TaskExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void TaskExecutor::post(std::function<void()> work) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        if (threads_.empty()) {
+            for (size_t i = 0; i < thread_count_; i++) {
+                threads_.emplace_back(&TaskExecutor::worker_loop, this);
+            }
+        }
+        queue_.push_back(std::move(work));
+    }
+    cv_.notify_one();
+}
+
+void TaskExecutor::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+        if (stopping_) {
+            break;
+        }
+        std::function<void()> work = std::move(queue_.front());
+        queue_.pop_front();
+
+        lock.unlock();
+        work();
+        lock.lock();
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef TASKEXECUTOR_H
+#define TASKEXECUTOR_H
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+// 固定数量的后台线程，依次执行投递过来的工作。第一次投递时才启动线程；
+// 析构时等正在执行的工作结束，还没开始的直接丢弃
+class TaskExecutor {
+public:
+    explicit TaskExecutor(size_t threads);
+    ~TaskExecutor();
+
+    // 禁止拷贝
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    void post(std::function<void()> work);
+    // 丢弃还没开始的工作，等正在执行的工作结束后回收线程；之后投递的工作被忽略
+    void stop();
+
+private:
+    void worker_loop();
+
+    size_t thread_count_;
+    std::deque<std::function<void()>> queue_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+#endif // TASKEXECUTOR_H
@@ -0,0 +1,439 @@
+#include "TokenIndex.h"
+#include "UnicodeFold.h"
+#include "Utils.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <iterator>
+
+// 垃圾引用或空记录超过这个数量且占比足够大时整理一次
+static const size_t COMPACT_MIN_WASTE = 65536;
+
+// 尚未归并的新词元超过这个数量时，补全前先归并到 sorted_
+static const size_t MAX_PENDING_TOKENS = 4096;
+
+// 比这更长的词元多半是哈希值或随机串，不作为补全
+static const size_t MAX_TOKEN_BYTES = 64;
+
+namespace {
+
+enum class CharClass { SEPARATOR, UPPER, LOWER, DIGIT, CJK, OTHER };
+
+struct CharInfo {
+    size_t offset;
+    size_t length;
+    CharClass cls;
+};
+
+CharClass classify(uint32_t cp) {
+    if (cp < 0x80) {
+        if (cp >= 'A' && cp <= 'Z') return CharClass::UPPER;
+        if (cp >= 'a' && cp <= 'z') return CharClass::LOWER;
+        if (cp >= '0' && cp <= '9') return CharClass::DIGIT;
+        return CharClass::SEPARATOR;    // 空格与 ASCII 标点
+    }
+    // 中日韩标点与全角标点
+    if ((cp >= 0x3000 && cp <= 0x303F) || (cp >= 0xFF00 && cp <= 0xFF0F) ||
+        (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) ||
+        (cp >= 0xFF5B && cp <= 0xFF65)) {
+        return CharClass::SEPARATOR;
+    }
+    // 中日韩部首、假名、汉字、谚文与扩展区
+    if ((cp >= 0x2E80 && cp <= 0x9FFF) || (cp >= 0xAC00 && cp <= 0xD7AF) ||
+        (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x20000 && cp <= 0x2FFFF)) {
+        return CharClass::CJK;
+    }
+    return CharClass::OTHER;
+}
+
+// 字母类（大写、小写、其他文字）之间只按驼峰切分，与数字、中日韩文字之间总是切分
+int group_of(CharClass cls) {
+    switch (cls) {
+        case CharClass::DIGIT: return 1;
+        case CharClass::CJK:   return 2;
+        default:               return 0;
+    }
+}
+
+void decode(const std::string& s, std::vector<CharInfo>& chars) {
+    chars.clear();
+    size_t i = 0;
+    while (i < s.size()) {
+        const unsigned char lead = static_cast<unsigned char>(s[i]);
+        size_t length = std::min<size_t>(getUTF8CharLength(lead), s.size() - i);
+        uint32_t cp = lead;
+        if (length > 1) {
+            cp = lead & (0xFF >> (length + 1));
+            for (size_t j = 1; j < length; ++j) {
+                const unsigned char c = static_cast<unsigned char>(s[i + j]);
+                if ((c & 0xC0) != 0x80) {
+                    length = j;     // 非法序列，按已读到的字节处理
+                    break;
+                }
+                cp = (cp << 6) | (c & 0x3F);
+            }
+        }
+        chars.push_back(CharInfo{i, length, length == 1 && lead >= 0x80 ? CharClass::OTHER : classify(cp)});
+        i += length;
+    }
+}
+
+// 纯 ASCII 的词元只需转小写，结果与 unicode_fold 相同
+std::string fold_token(const char* s, size_t length) {
+    std::string folded(s, length);
+    for (char& c : folded) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return unicode_fold(s, length);
+        }
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c + ('a' - 'A'));
+        }
+    }
+    return folded;
+}
+
+bool starts_with(const std::string& s, const std::string& prefix) {
+    return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+std::vector<std::string> TokenIndex::tokenize(const std::string& file_name) {
+    std::vector<std::string> tokens;
+    thread_local std::vector<CharInfo> chars;
+    decode(file_name, chars);
+
+    size_t start = std::string::npos;
+    auto flush = [&](size_t end) {
+        if (start == std::string::npos) {
+            return;
+        }
+        const size_t length = end - start;
+        if (length >= 2 && length <= MAX_TOKEN_BYTES) {
+            tokens.push_back(fold_token(file_name.data() + start, length));
+        }
+        start = std::string::npos;
+    };
+
+    for (size_t i = 0; i < chars.size(); ++i) {
+        const CharClass cls = chars[i].cls;
+        if (cls == CharClass::SEPARATOR) {
+            flush(chars[i].offset);
+            continue;
+        }
+        if (start != std::string::npos) {
+            const CharClass prev = chars[i - 1].cls;
+            // fooBar 在 B 前切分，HTTPServer 在 S 前切分
+            const bool boundary =
+                group_of(prev) != group_of(cls) ||
+                (cls == CharClass::UPPER && (prev == CharClass::LOWER || prev == CharClass::OTHER)) ||
+                (cls == CharClass::UPPER && prev == CharClass::UPPER &&
+                 i + 1 < chars.size() && chars[i + 1].cls == CharClass::LOWER);
+            if (boundary) {
+                flush(chars[i].offset);
+            }
+        }
+        if (start == std::string::npos) {
+            start = chars[i].offset;
+        }
+    }
+    flush(file_name.size());
+
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    return tokens;
+}
+
+bool TokenIndex::load(sqlite3* db) {
+    auto start = std::chrono::steady_clock::now();
+
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT id, file_name FROM file_info ORDER BY id";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "加载词元索引失败: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    reset();
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        if (name == nullptr) {
+            continue;
+        }
+        const std::vector<std::string> tokens = tokenize(std::string(name, sqlite3_column_bytes(stmt, 1)));
+        if (tokens.empty()) {
+            continue;
+        }
+        ids_.push_back(sqlite3_column_int(stmt, 0));
+        starts_.push_back(0);
+        lengths_.push_back(0);
+        empty_slots_++;
+        set_tokens(ids_.size() - 1, tokens);
+    }
+    sqlite3_finalize(stmt);
+    merge_pending();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "词元索引加载完成, 记录数: " << ids_.size() << ", 词元: " << live_tokens_
+              << ", 引用: " << refs_.size() << ", 耗时: " << elapsed << "ms" << std::endl;
+    return true;
+}
+
+void TokenIndex::insert(int id, const std::string& file_name) {
+    const std::vector<std::string> tokens = tokenize(file_name);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // 新记录的 id 总是最大的，绝大多数情况直接追加
+    size_t slot = std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+    if (slot == ids_.size() || ids_[slot] != id) {
+        if (tokens.empty()) {
+            return;
+        }
+        ids_.insert(ids_.begin() + slot, id);
+        starts_.insert(starts_.begin() + slot, 0);
+        lengths_.insert(lengths_.begin() + slot, 0);
+        empty_slots_++;
+    } else {
+        release(slot);
+    }
+    set_tokens(slot, tokens);
+    compact_if_needed();
+}
+
+void TokenIndex::remove(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (it != ids_.end() && *it == id) {
+        release(it - ids_.begin());
+        compact_if_needed();
+    }
+}
+
+void TokenIndex::remove(const std::vector<int>& ids) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int id : ids) {
+        auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+        if (it != ids_.end() && *it == id) {
+            release(it - ids_.begin());
+        }
+    }
+    compact_if_needed();
+}
+
+void TokenIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reset();
+}
+
+std::vector<TokenIndex::Suggestion> TokenIndex::suggest(const std::string& prefix, size_t k) {
+    std::vector<Suggestion> result;
+    if (prefix.empty() || k == 0) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() > MAX_PENDING_TOKENS) {
+        merge_pending();
+    }
+
+    // 次数多的在前，次数相同时短的、字节序小的在前；堆顶是目前最差的一个
+    auto better = [this](uint32_t a, uint32_t b) {
+        if (counts_[a] != counts_[b]) {
+            return counts_[a] > counts_[b];
+        }
+        const std::string& ta = token_at(a);
+        const std::string& tb = token_at(b);
+        return ta.size() != tb.size() ? ta.size() < tb.size() : ta < tb;
+    };
+    std::vector<uint32_t> best;
+    auto consider = [&](uint32_t token) {
+        if (counts_[token] == 0) {
+            return;
+        }
+        if (best.size() < k) {
+            best.push_back(token);
+            std::push_heap(best.begin(), best.end(), better);
+        } else if (better(token, best.front())) {
+            std::pop_heap(best.begin(), best.end(), better);
+            best.back() = token;
+            std::push_heap(best.begin(), best.end(), better);
+        }
+    };
+
+    // 以 prefix 开头的词元在 sorted_ 中是连续的一段
+    auto begin = std::lower_bound(sorted_.begin(), sorted_.end(), prefix,
+                                  [this](uint32_t token, const std::string& p) { return token_at(token) < p; });
+    auto end = std::partition_point(begin, sorted_.end(),
+                                    [&](uint32_t token) { return starts_with(token_at(token), prefix); });
+    for (auto it = begin; it != end; ++it) {
+        consider(*it);
+    }
+    for (uint32_t token : pending_) {
+        if (starts_with(token_at(token), prefix)) {
+            consider(token);
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), better);
+    for (uint32_t token : best) {
+        result.push_back(Suggestion{token_at(token), counts_[token]});
+    }
+    return result;
+}
+
+size_t TokenIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_tokens_;
+}
+
+void TokenIndex::reset() {
+    tokens_.clear();
+    counts_.clear();
+    token_ids_.clear();
+    live_tokens_ = 0;
+    sorted_.clear();
+    pending_.clear();
+    ids_.clear();
+    starts_.clear();
+    lengths_.clear();
+    refs_.clear();
+    garbage_refs_ = 0;
+    empty_slots_ = 0;
+}
+
+uint32_t TokenIndex::intern(const std::string& token) {
+    auto it = token_ids_.find(token);
+    if (it != token_ids_.end()) {
+        return it->second;
+    }
+    const uint32_t id = static_cast<uint32_t>(tokens_.size());
+    tokens_.push_back(token);
+    counts_.push_back(0);
+    token_ids_.emplace(tokens_.back(), id);
+    pending_.push_back(id);
+    return id;
+}
+
+void TokenIndex::set_tokens(size_t slot, const std::vector<std::string>& tokens) {
+    // 调用时 slot 为空记录
+    const size_t length = std::min<size_t>(tokens.size(), std::numeric_limits<uint8_t>::max());
+    if (length == 0) {
+        return;
+    }
+    starts_[slot] = static_cast<uint32_t>(refs_.size());
+    lengths_[slot] = static_cast<uint8_t>(length);
+    empty_slots_--;
+    for (size_t i = 0; i < length; ++i) {
+        const uint32_t token = intern(tokens[i]);
+        if (counts_[token]++ == 0) {
+            live_tokens_++;
+        }
+        refs_.push_back(token);
+    }
+}
+
+void TokenIndex::release(size_t slot) {
+    if (lengths_[slot] == 0) {
+        return;
+    }
+    for (size_t i = starts_[slot]; i < starts_[slot] + lengths_[slot]; ++i) {
+        if (--counts_[refs_[i]] == 0) {
+            live_tokens_--;
+        }
+    }
+    garbage_refs_ += lengths_[slot];
+    lengths_[slot] = 0;
+    empty_slots_++;
+}
+
+void TokenIndex::merge_pending() {
+    if (pending_.empty()) {
+        return;
+    }
+    auto less = [this](uint32_t a, uint32_t b) { return token_at(a) < token_at(b); };
+    std::sort(pending_.begin(), pending_.end(), less);
+
+    std::vector<uint32_t> merged;
+    merged.reserve(sorted_.size() + pending_.size());
+    std::merge(sorted_.begin(), sorted_.end(), pending_.begin(), pending_.end(),
+               std::back_inserter(merged), less);
+    sorted_.swap(merged);
+    pending_.clear();
+}
+
+void TokenIndex::compact_if_needed() {
+    const bool refs_wasted = garbage_refs_ >= COMPACT_MIN_WASTE && garbage_refs_ * 2 >= refs_.size();
+    const bool slots_wasted = empty_slots_ >= COMPACT_MIN_WASTE && empty_slots_ * 4 >= ids_.size();
+    if (!refs_wasted && !slots_wasted) {
+        return;
+    }
+
+    // 出现次数为 0 的词元一并清除，词元重新编号
+    std::vector<uint32_t> remap(tokens_.size(), std::numeric_limits<uint32_t>::max());
+    std::deque<std::string> tokens;
+    std::vector<uint32_t> counts;
+    token_ids_.clear();
+    for (size_t token = 0; token < tokens_.size(); ++token) {
+        if (counts_[token] == 0) {
+            continue;
+        }
+        remap[token] = static_cast<uint32_t>(tokens.size());
+        tokens.push_back(std::move(tokens_[token]));
+        counts.push_back(counts_[token]);
+    }
+    for (size_t token = 0; token < tokens.size(); ++token) {
+        token_ids_.emplace(tokens[token], static_cast<uint32_t>(token));
+    }
+
+    // 排好的顺序不变，只去掉清除的词元
+    auto renumber = [&remap](std::vector<uint32_t>& list) {
+        std::vector<uint32_t> kept;
+        kept.reserve(list.size());
+        for (uint32_t token : list) {
+            if (remap[token] != std::numeric_limits<uint32_t>::max()) {
+                kept.push_back(remap[token]);
+            }
+        }
+        list.swap(kept);
+    };
+    renumber(sorted_);
+    renumber(pending_);
+
+    std::vector<int> ids;
+    std::vector<uint32_t> starts;
+    std::vector<uint8_t> lengths;
+    std::vector<uint32_t> refs;
+    const size_t live = ids_.size() - empty_slots_;
+    ids.reserve(live);
+    starts.reserve(live);
+    lengths.reserve(live);
+    refs.reserve(refs_.size() - garbage_refs_);
+    for (size_t slot = 0; slot < ids_.size(); ++slot) {
+        if (lengths_[slot] == 0) {
+            continue;
+        }
+        ids.push_back(ids_[slot]);
+        starts.push_back(static_cast<uint32_t>(refs.size()));
+        lengths.push_back(lengths_[slot]);
+        for (size_t i = starts_[slot]; i < starts_[slot] + lengths_[slot]; ++i) {
+            refs.push_back(remap[refs_[i]]);
+        }
+    }
+
+    std::cout << "词元索引整理完成, 清除空记录: " << empty_slots_ << ", 垃圾引用: " << garbage_refs_
+              << ", 词元: " << tokens_.size() << " -> " << tokens.size() << std::endl;
+
+    tokens_.swap(tokens);
+    counts_.swap(counts);
+    ids_.swap(ids);
+    starts_.swap(starts);
+    lengths_.swap(lengths);
+    refs_.swap(refs);
+    garbage_refs_ = 0;
+    empty_slots_ = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef TOKENINDEX_H
+#define TOKENINDEX_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "sqlite3.h"
+
+// 输入联想用的词元索引，每个数据库一份，挂在 DBConnection 上共享
+// 文件名按分隔符（. _ - 空格等）、驼峰大小写、字母/数字/中日韩文字之间的边界切成词元，
+// 折叠后记录每个词元出现在多少个文件名中。词元按字节序排好放在 sorted_ 中，
+// 前缀补全是一次二分查找加一段连续区间上的计数比较，不需要访问数据库。
+// 每条记录的词元列表保存在 refs_ 中，删除或改名时据此把计数减回去。
+class TokenIndex {
+public:
+    struct Suggestion {
+        std::string token;
+        size_t count = 0;
+    };
+
+    TokenIndex() = default;
+
+    // 禁止拷贝
+    TokenIndex(const TokenIndex&) = delete;
+    TokenIndex& operator=(const TokenIndex&) = delete;
+
+    // 把文件名切成折叠后的词元，去重；单个 ASCII 字符和过长的词元（如哈希值）不收录
+    static std::vector<std::string> tokenize(const std::string& file_name);
+
+    // 从 file_info 表重新加载全部记录
+    bool load(sqlite3* db);
+
+    // 插入或更新一条记录
+    void insert(int id, const std::string& file_name);
+    void remove(int id);
+    void remove(const std::vector<int>& ids);
+    void clear();
+
+    // 以 prefix（已折叠）开头的词元中出现次数最多的 k 个，次数相同时短的、字节序小的在前
+    std::vector<Suggestion> suggest(const std::string& prefix, size_t k);
+
+    // 出现次数不为 0 的词元数
+    size_t size() const;
+
+private:
+    // 清空全部数据，调用者需持有锁
+    void reset();
+    uint32_t intern(const std::string& token);
+    void set_tokens(size_t slot, const std::vector<std::string>& tokens);
+    void release(size_t slot);
+    void merge_pending();
+    void compact_if_needed();
+
+    const std::string& token_at(uint32_t token) const { return tokens_[token]; }
+
+    mutable std::mutex mutex_;
+
+    // 词元表：deque 中的字符串地址不变，token_ids_ 的键直接引用它们
+    std::deque<std::string> tokens_;
+    std::vector<uint32_t> counts_;
+    std::unordered_map<std::string_view, uint32_t> token_ids_;
+    size_t live_tokens_ = 0;
+
+    // 按词元字节序排列的词元编号；新词元先放进 pending_，补全时再归并
+    std::vector<uint32_t> sorted_;
+    std::vector<uint32_t> pending_;
+
+    // 每条记录的词元列表：ids_ 升序，refs_[starts_[slot], starts_[slot] + lengths_[slot]) 为它的词元编号
+    // 更新后旧的列表留在 refs_ 中成为垃圾，删除的记录 lengths_ 为 0，积累到一定程度时整理
+    std::vector<int> ids_;
+    std::vector<uint32_t> starts_;
+    std::vector<uint8_t> lengths_;
+    std::vector<uint32_t> refs_;
+    size_t garbage_refs_ = 0;
+    size_t empty_slots_ = 0;
+};
+
+#endif // TOKENINDEX_H
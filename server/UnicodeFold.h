@@ -0,0 +1,21 @@
+#ifndef UNICODEFOLD_H
+#define UNICODEFOLD_H
+
+#include <string>
+#include <cstddef>
+
+// Unicode 大小写折叠 + NFC 组合
+// 文件名先按 NFC 把基字符与其后的组合字符（以及韩文字母）合成预组合字符，再按 Unicode 完整折叠规则折叠，
+// 这样 "Ä"、"Ä"、"ä" 以及西里尔、希腊、全角拉丁字母的大小写形式都得到同一个结果。
+// 只组合紧跟在起始字符后面的组合字符，不做规范重排序，对实际文件名已经足够。
+// 非法的 UTF-8 字节原样保留。
+std::string unicode_fold(const char* s, size_t length);
+
+inline std::string unicode_fold(const std::string& s) {
+    return unicode_fold(s.data(), s.size());
+}
+
+// 按折叠后的字节序比较，用作 SQLite 排序规则
+int unicode_fold_compare(const char* a, size_t a_length, const char* b, size_t b_length);
+
+#endif // UNICODEFOLD_H
@@ -3,6 +3,9 @@
 #include <filesystem>
 #include <fstream>
 #include <regex>
+#include <thread>
+#include <mutex>
+#include <unordered_map>
 #include "Defines.h"
 
 std::string get_db_path_by_uid(std::string uid)
@@ -10,6 +13,19 @@ std::string get_db_path_by_uid(std::string uid)
     return std::string(DATABASE_FILE_PATH) + "/" + uid + "/" + std::string(TARGET_DB_FILE);
 }
 
+int getUTF8CharLength(unsigned char firstByte) {
+    if ((firstByte & 0x80) == 0) {
+        return 1;  // ASCII
+    } else if ((firstByte & 0xE0) == 0xC0) {
+        return 2;  // 2 字节字符
+    } else if ((firstByte & 0xF0) == 0xE0) {
+        return 3;  // 3 字节字符
+    } else if ((firstByte & 0xF8) == 0xF0) {
+        return 4;  // 4 字节字符
+    }
+    return 1;  // 无效 UTF-8，按单字节处理
+}
+
 std::vector<std::string> get_all_db_path() {
     std::vector<std::string> results;
 
@@ -52,4 +68,63 @@ std::string get_rescan_schedule_time()
     }
 
     return "00:00";
-}
\ No newline at end of file
+}
+
+int read_int_config(const char* path, int default_value)
+{
+    // 每个配置文件只在第一次用到时读取，之后创建任务、逐键搜索时不再访问磁盘
+    static std::mutex cache_mutex;
+    static std::unordered_map<std::string, int> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = cache.find(path);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    int value = default_value;
+    std::ifstream file(path);
+    if (!file.is_open() || !(file >> value)) {
+        value = default_value;
+    }
+    cache.emplace(path, value);
+    return value;
+}
+
+int get_search_parallelism()
+{
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (threads <= 0) {
+        threads = 1;
+    }
+
+    const int configured = read_int_config(SEARCH_THREADS_FILE, 0);
+    if (configured > 0) {
+        return std::min(configured, 64);
+    }
+
+    return threads;
+}
+
+bool is_pinyin_keys_enabled()
+{
+    return read_int_config(PINYIN_KEYS_FILE, 1) != 0;
+}
+
+bool is_shared_index_enabled()
+{
+    return read_int_config(SHARED_INDEX_FILE, 1) != 0;
+}
+
+int get_query_time_limit_ms()
+{
+    const int default_limit_ms = 60000;
+
+    const int configured = read_int_config(QUERY_TIME_LIMIT_FILE, default_limit_ms);
+    return configured >= 0 ? configured : default_limit_ms;
+}
+
+bool is_suggest_index_enabled()
+{
+    return read_int_config(SUGGEST_INDEX_FILE, 1) != 0;
+}
@@ -3,12 +3,40 @@
 #define __UTILS_H__
 
 #include <string>
+#include <vector>
 
 std::string get_db_path_by_uid(std::string uid);
 
 std::vector<std::string> get_all_db_path();
 
+/**
+ * @brief 获取 UTF-8 字符的字节长度
+ * @param firstByte UTF-8 字符的第一个字节
+ * @return 该字符的总字节数（1-4）
+ */
+int getUTF8CharLength(unsigned char firstByte);
+
 // 读取定时重扫配置，返回 "HH:MM"，默认 "00:00"
 std::string get_rescan_schedule_time();
 
+// 读取只含一个整数的配置文件，文件不存在或内容无法解析时返回 default_value；
+// 每个文件只在第一次调用时读取并缓存，修改配置后需要重启服务
+int read_int_config(const char* path, int default_value);
+
+// 读取搜索并行度配置，默认为 CPU 核数，1 表示串行按 id 区间逐批扫描
+int get_search_parallelism();
+
+// 读取是否在扫描时生成拼音检索键，文件内容为 0 时关闭，默认开启
+bool is_pinyin_keys_enabled();
+
+// 读取是否让其他用户的搜索同时查询 root 的共享索引，文件内容为 0 时关闭，默认开启
+bool is_shared_index_enabled();
+
+// 读取单个搜索任务的总时间上限（毫秒），超时后正在执行的语句被中断，任务只返回已找到的部分；
+// 文件内容为 0 时不限制，默认 60000
+int get_query_time_limit_ms();
+
+// 读取是否维护输入联想用的词元索引，文件内容为 0 时关闭，默认开启
+bool is_suggest_index_enabled();
+
 #endif
\ No newline at end of file
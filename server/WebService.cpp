@@ -6,6 +6,7 @@
 #include <iostream>
 #include <cassert>
 #include <string>
+#include <algorithm>
 
 static unsigned char FromHex(unsigned char x) {
     if (x >= 'A' && x <= 'Z') return x - 'A' + 10;
@@ -73,6 +74,48 @@ static crow::response create_error_response(const std::string& message) {
     return res;
 }
 
+// 搜索结果中的一条记录
+static crow::json::wvalue file_to_json(const FileInfo& file) {
+    crow::json::wvalue file_json;
+    file_json["id"] = file.id;
+    file_json["file_name"] = file.file_name;
+    file_json["file_path"] = file.file_path;
+    file_json["file_extension"] = file.file_extension;
+    file_json["mime_type"] = file.mime_type;
+    file_json["is_directory"] = file.is_directory;
+    file_json["file_size"] = file.file_size;
+    return file_json;
+}
+
+// 随机访问一次最多返回的记录数，与逐批返回的默认批大小相同
+static const int MAX_WINDOW_COUNT = 1000;
+
+// 输入联想最多返回的补全个数
+static const int MAX_SUGGESTIONS = 50;
+
+// 分面统计转为 JSON，各列表为 [{"value": ..., "count": ...}]
+static crow::json::wvalue facets_to_json(const SearchFacets& facets) {
+    auto list = [](const std::vector<std::pair<std::string, int>>& items) {
+        std::vector<crow::json::wvalue> result;
+        for (const auto& item : items) {
+            crow::json::wvalue entry;
+            entry["value"] = item.first;
+            entry["count"] = item.second;
+            result.push_back(std::move(entry));
+        }
+        return crow::json::wvalue(result);
+    };
+
+    crow::json::wvalue json;
+    json["total"] = facets.total;
+    json["files"] = facets.files;
+    json["directories"] = facets.directories;
+    json["extensions"] = list(facets.extensions);
+    json["parents"] = list(facets.parents);
+    json["scan_objs"] = list(facets.roots);
+    return json;
+}
+
 // GET /api/scan_obj/{uid} - 获取scan_obj列表
 crow::response WebService::get_scan_objs(const std::string& uid) {
     crow::response res;
@@ -182,11 +225,39 @@ crow::response WebService::get_filedb_objs(const std::string& uid, const std::st
     return res;
 }
 
+// GET /api/filedb/{uid}/suggest/{prefix} - 输入联想，补全搜索文本的最后一个词
+crow::response WebService::get_suggestions(const std::string& uid, const std::string& prefix, int limit)
+{
+    crow::response res;
+    crow::json::wvalue result;
+    std::string error_msg;
+
+    // 每次按键都会请求，不打印日志
+    std::string decoded_prefix = UrlDecode(prefix);
+    int count = db_get_suggestions(uid, decoded_prefix, limit, result, error_msg);
+    if (count < 0) {
+        return create_error_response(std::string("Failed to get suggestions, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["prefix"] = decoded_prefix;
+    response["count"] = count;
+    response["suggestions"] = std::move(result);
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
 // POST /api/filedb/{uid}/task/{search_text} - 创建查找任务，获取task_id
 crow::response WebService::create_search_task(const std::string& uid, const std::string& search_text,
-                                              bool include_hidden)
+                                              bool include_hidden, const std::string& mode, bool facets,
+                                              const std::string& sort, bool descending)
 {
     int max_file_count = 0;
+    bool refined = false;
     crow::response res;
     std::string error_msg;
 
@@ -195,8 +266,15 @@ crow::response WebService::create_search_task(const std::string& uid, const std:
     std::cout << "原始搜索文本: " << search_text << std::endl;
     std::cout << "解码后搜索文本: " << decoded_search_text << std::endl;
     std::cout << "包含隐藏文件夹: " << (include_hidden ? "是" : "否") << std::endl;
+    if (!mode.empty()) {
+        std::cout << "搜索模式: " << mode << std::endl;
+    }
+    if (!sort.empty()) {
+        std::cout << "排序: " << sort << (descending ? " 降序" : " 升序") << std::endl;
+    }
 
-    std::string task_id = db_create_search_task(uid, decoded_search_text, max_file_count, error_msg, include_hidden);
+    std::string task_id = db_create_search_task(uid, decoded_search_text, max_file_count, refined, error_msg,
+                                                include_hidden, mode, facets, sort, descending);
 
     if (!task_id.empty()) {
         crow::json::wvalue response;
@@ -204,6 +282,9 @@ crow::response WebService::create_search_task(const std::string& uid, const std:
         response["search_text"] = decoded_search_text;
         response["task_id"] = task_id;
         response["max_file_count"] = max_file_count;
+        response["refined"] = refined;
+        // 请求了分面统计而该模式不支持时为 false
+        response["facets"] = facets;
         set_cors_headers(res);
         res.code = 200;
         res.write(response.dump());
@@ -221,8 +302,11 @@ crow::response WebService::get_search_task(const std::string& uid, const std::st
     crow::json::wvalue result;
     std::string error_msg;
     bool is_finished = false;
+    SearchProgress progress;
+    SearchFacets facets;
+    bool has_facets = false;
 
-    int count = db_get_search_task(uid, task_id, result, is_finished, error_msg);
+    int count = db_get_search_task(uid, task_id, result, is_finished, progress, facets, has_facets, error_msg);
 
     // 获取数据成功
     crow::json::wvalue response;
@@ -230,6 +314,17 @@ crow::response WebService::get_search_task(const std::string& uid, const std::st
     response["task_id"] = task_id;
     response["is_finished"] = is_finished;
     response["count"] = count;
+    // 进度：已检查的记录数 / 记录总数；estimated_matches 为匹配总数的估计，-1 表示还无法估计
+    response["cursor"] = progress.cursor;
+    response["rows_examined"] = progress.rows_examined;
+    response["total_rows"] = progress.total_rows;
+    response["estimated_matches"] = progress.estimated_matches;
+    // 任务因超过单次查询的时间上限而结束，已返回的结果不完整
+    response["timed_out"] = progress.timed_out;
+    // 创建任务时请求了分面统计：与第一批结果一起返回一次
+    if (has_facets) {
+        response["facets"] = facets_to_json(facets);
+    }
     response["filedb_objs"] = std::move(result);
     set_cors_headers(res);
     res.code = 200;
@@ -238,6 +333,35 @@ crow::response WebService::get_search_task(const std::string& uid, const std::st
     return res;    
 }
 
+// GET /api/filedb/{uid}/task/{task_id}?offset=&count= - 随机访问查找结果中的一段，用于虚拟滚动
+crow::response WebService::get_search_window(const std::string& uid, const std::string& task_id, int offset, int count)
+{
+    crow::response res;
+    crow::json::wvalue result;
+    std::string error_msg;
+    int total = 0;
+
+    count = std::min(std::max(count, 0), MAX_WINDOW_COUNT);
+    int returned = db_get_search_window(uid, task_id, offset, count, result, total, error_msg);
+    if (returned < 0) {
+        return create_error_response(std::string("Failed to get result window, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["task_id"] = task_id;
+    response["offset"] = offset;
+    response["count"] = returned;
+    // 匹配总数，客户端据此确定滚动范围
+    response["total"] = total;
+    response["filedb_objs"] = std::move(result);
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
 // DELETE /api/filedb/{uid}/task/{task_id} - 删除查找任务
 crow::response WebService::delete_search_task(const std::string& uid, const std::string& task_id)
 {
@@ -258,6 +382,128 @@ crow::response WebService::delete_search_task(const std::string& uid, const std:
     return res;    
 }
 
+// GET /api/search_stats/{uid} - 搜索任务表与后台预取的累计计数
+crow::response WebService::get_search_stats(const std::string& uid)
+{
+    crow::response res;
+    crow::json::wvalue result;
+    std::string error_msg;
+
+    if (!db_get_search_stats(uid, result, error_msg)) {
+        return create_error_response(std::string("Failed to get search stats, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["stats"] = std::move(result);
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
+// GET /api/standing_query/{uid} - 常驻查询列表
+crow::response WebService::get_standing_queries(const std::string& uid)
+{
+    crow::response res;
+    crow::json::wvalue result;
+    std::string error_msg;
+
+    int count = db_get_standing_queries(uid, result, error_msg);
+    if (count < 0) {
+        return create_error_response(std::string("Failed to get standing queries, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["count"] = count;
+    response["standing_queries"] = std::move(result);
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
+// POST /api/standing_query/{uid}/{search_text} - 保存常驻查询，结果随文件变化增量维护
+crow::response WebService::add_standing_query(const std::string& uid, const std::string& search_text,
+                                              const std::string& mode, const std::string& root, bool include_hidden)
+{
+    crow::response res;
+    std::string error_msg;
+
+    std::string decoded_search_text = UrlDecode(search_text);
+    std::string decoded_root = UrlDecode(root);
+    std::cout << "添加常驻查询: " << decoded_search_text << ", 目录: " << decoded_root << std::endl;
+
+    int id = db_add_standing_query(uid, decoded_search_text, mode, decoded_root, include_hidden, error_msg);
+    if (id <= 0) {
+        return create_error_response(std::string("Failed to add standing query, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["id"] = id;
+    response["search_text"] = decoded_search_text;
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
+// GET /api/standing_query/{uid}/{id}?since= - 常驻查询的全部结果，或自版本 since 以来的变化
+crow::response WebService::get_standing_query(const std::string& uid, const std::string& id, uint64_t since)
+{
+    crow::response res;
+    std::string error_msg;
+    crow::json::wvalue added;
+    crow::json::wvalue removed;
+    uint64_t version = 0;
+    bool reset = false;
+
+    int count = db_get_standing_query(uid, std::atoi(id.c_str()), since, version, reset, added, removed, error_msg);
+    if (count < 0) {
+        return create_error_response(std::string("Failed to get standing query, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["id"] = id;
+    // 下次刷新时作为 since 传回；reset 为 true 时 filedb_objs 为全部结果，客户端应丢弃已有的结果
+    response["version"] = static_cast<unsigned long long>(version);
+    response["reset"] = reset;
+    response["count"] = count;
+    response["filedb_objs"] = std::move(added);
+    response["removed_ids"] = std::move(removed);
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
+// DELETE /api/standing_query/{uid}/{id} - 删除常驻查询
+crow::response WebService::delete_standing_query(const std::string& uid, const std::string& id)
+{
+    crow::response res;
+    std::string error_msg;
+
+    if (!db_delete_standing_query(uid, std::atoi(id.c_str()), error_msg)) {
+        return create_error_response(std::string("Failed to delete standing query, error message: ") + error_msg);
+    }
+
+    crow::json::wvalue response;
+    response["result"] = "ok";
+    response["id"] = id;
+    set_cors_headers(res);
+    res.code = 200;
+    res.write(response.dump());
+
+    return res;
+}
+
 // POST /api/audit/events - 处理audit消息
 crow::response WebService::audit_event(const crow::request& req)
 {
@@ -342,6 +588,13 @@ bool WebService::db_add_scan_obj(const std::string& uid, const std::string& path
         std::filesystem::create_directories(db_dir);  // 创建目录（包括父目录）
     }
 
+    // 已在共享索引中的目录不再为每个用户重复扫描一份
+    std::string shared_dir = uid == SHARED_INDEX_UID ? std::string() : find_shared_scan_obj(path);
+    if (!shared_dir.empty()) {
+        error_msg = "Directory is already indexed by the shared index: " + shared_dir;
+        return false;
+    }
+
     // 现在处理数据库操作
     ScanObject scan_object(db_path);
     if (!scan_object.init_database()) {
@@ -425,25 +678,44 @@ int WebService::db_get_filedb_objs(const std::string& uid, const std::string& se
     int index = 0;
     std::vector<FileInfo> files = filedb->search_files(search_text, "file_name");
     for (const auto& file : files) {
-        crow::json::wvalue file_json;
-        file_json["id"] = file.id;
-        file_json["file_name"] = file.file_name;
-        file_json["file_path"] = file.file_path;
-        file_json["file_extension"] = file.file_extension;
-        file_json["mime_type"] = file.mime_type;
-        file_json["is_directory"] = file.is_directory;
+        result[index++] = file_to_json(file);
+    }
 
-        result[index++] = std::move(file_json);
+    return index;
+}
+
+int WebService::db_get_suggestions(const std::string& uid, const std::string& prefix, int limit,
+                                   crow::json::wvalue& result, std::string& error_msg) {
+    result = crow::json::wvalue(std::vector<crow::json::wvalue>());
+
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return -1;
     }
 
+    // 只补全自己数据库中的词元：共享索引中的文件名未经权限过滤，不能作为联想结果
+    int index = 0;
+    for (const auto& completion : filedb->suggest_completions(prefix, std::min(std::max(limit, 1), MAX_SUGGESTIONS))) {
+        crow::json::wvalue suggestion_json;
+        suggestion_json["text"] = completion.first;
+        suggestion_json["count"] = completion.second;
+        result[index++] = std::move(suggestion_json);
+    }
     return index;
 }
 
 std::string WebService::db_create_search_task(const std::string& uid,
     const std::string& decoded_search_text,
     int &max_file_count,
+    bool &refined,
     std::string &error_msg,
-    bool include_hidden)
+    bool include_hidden,
+    const std::string& mode,
+    bool &facets,
+    const std::string& sort,
+    bool descending)
 {
     std::shared_ptr<FileDB> filedb = get_db(uid);
     // 初始化数据库
@@ -452,14 +724,83 @@ std::string WebService::db_create_search_task(const std::string& uid,
         return std::string();
     }
 
-    // 这里应该指定搜索字段，默认为"file_name"
-    return filedb->start_search_task(decoded_search_text, "file_name", max_file_count, -1, include_hidden);
+    // 默认按文件名搜索，mode=pinyin 时文件名或其拼音、拼音首字母匹配均可，mode=regex 时按正则表达式匹配文件名，
+    // mode=fuzzy 时容错匹配文件名并按相关度从高到低返回，mode=ranked 时按文件名匹配并优先返回精确、前缀匹配
+    // 默认模式下搜索文本还可以带 ext: type: size: modified: 过滤条件，见 SearchQuery.h
+    std::string search_field = "file_name";
+    if (mode == "pinyin") {
+        search_field = "pinyin";
+    } else if (mode == "regex") {
+        search_field = "regex";
+    } else if (mode == "fuzzy") {
+        search_field = "fuzzy";
+    } else if (mode == "ranked") {
+        search_field = "ranked";
+    }
+
+    // sort=name|natural|path|mtime|size：服务端按该键排好序后分批返回，natural 为数字按数值比较的名字顺序
+    SearchSort search_sort;
+    search_sort.descending = descending;
+    if (sort == "name") {
+        search_sort.key = SortKey::NAME;
+    } else if (sort == "natural") {
+        search_sort.key = SortKey::NATURAL;
+    } else if (sort == "path") {
+        search_sort.key = SortKey::PATH;
+    } else if (sort == "mtime") {
+        search_sort.key = SortKey::MTIME;
+    } else if (sort == "size") {
+        search_sort.key = SortKey::SIZE;
+    } else if (!sort.empty()) {
+        error_msg = "Invalid sort key: " + sort;
+        return std::string();
+    }
+
+    std::string task_id;
+    try {
+        task_id = filedb->start_search_task(decoded_search_text, search_field, max_file_count, -1, include_hidden, &refined);
+    } catch (const std::exception& e) {
+        // 正则表达式语法错误等
+        error_msg = e.what();
+        return std::string();
+    }
+
+    if (search_sort.key != SortKey::NONE && !filedb->set_task_sort(task_id, search_sort)) {
+        filedb->cleanup_task(task_id);
+        error_msg = "Sorting is not supported in mode: " + mode;
+        return std::string();
+    }
+
+    if (facets) {
+        // 按扫描对象统计：自己的扫描对象，挂了共享索引时再加上 root 的扫描对象
+        std::vector<std::string> roots;
+        std::vector<std::string> db_paths = {get_db_path_by_uid(uid)};
+        if (filedb->has_shared_index()) {
+            db_paths.push_back(get_db_path_by_uid(SHARED_INDEX_UID));
+        }
+        for (const auto& db_path : db_paths) {
+            ScanObject scan_object(db_path);
+            if (!scan_object.init_database()) {
+                continue;
+            }
+            for (const auto& object : scan_object.get_all_scan_objects()) {
+                if (std::find(roots.begin(), roots.end(), object.directory_path) == roots.end()) {
+                    roots.push_back(object.directory_path);
+                }
+            }
+        }
+        facets = filedb->enable_task_facets(task_id, roots);
+    }
+    return task_id;
 }
 
 int WebService::db_get_search_task(const std::string& uid,
     const std::string& task_id,
     crow::json::wvalue& result,
     bool &is_finished,
+    SearchProgress &progress,
+    SearchFacets &facets,
+    bool &has_facets,
     std::string &error_msg)
 {
     int index = 0;
@@ -481,22 +822,17 @@ int WebService::db_get_search_task(const std::string& uid,
     is_finished = (status == SearchStatus::COMPLETED ||
                    status == SearchStatus::CANCELLED);
 
-    // 获取一批结果（例如每次100条）
+    // 获取一批结果：从上一批的游标处继续，凑满一批或用完时间预算就返回
     std::vector<FileInfo> batch_results;
     if (!is_finished) {
         batch_results = filedb->get_search_batch(task_id);
         for (const auto& file : batch_results) {
-            crow::json::wvalue file_json;
-            file_json["id"] = file.id;
-            file_json["file_name"] = file.file_name;
-            file_json["file_path"] = file.file_path;
-            file_json["file_extension"] = file.file_extension;
-            file_json["mime_type"] = file.mime_type;
-            file_json["is_directory"] = file.is_directory;
-
-            result[index++] = std::move(file_json);
+            result[index++] = file_to_json(file);
         }
+        filedb->get_task_progress(task_id, progress);
+        has_facets = filedb->take_task_facets(task_id, facets);
     } else {
+        filedb->get_task_progress(task_id, progress);
         filedb->cleanup_task(task_id);
     }
 
@@ -504,6 +840,145 @@ int WebService::db_get_search_task(const std::string& uid,
 
 }
 
+int WebService::db_get_search_window(const std::string& uid,
+    const std::string& task_id,
+    int offset,
+    int count,
+    crow::json::wvalue& result,
+    int &total,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return -1;
+    }
+
+    // 第一次访问时求出全部匹配，之后只按下标取出这一段
+    std::vector<FileInfo> files;
+    if (!filedb->get_search_window(task_id, offset, count, files, total)) {
+        error_msg = "Task not found, timed out, or its search mode does not support random access.";
+        return -1;
+    }
+
+    result = crow::json::wvalue(std::vector<crow::json::wvalue>());
+    int index = 0;
+    for (const auto& file : files) {
+        result[index++] = file_to_json(file);
+    }
+    return index;
+}
+
+int WebService::db_get_standing_queries(const std::string& uid,
+    crow::json::wvalue& result,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return -1;
+    }
+
+    result = crow::json::wvalue(std::vector<crow::json::wvalue>());
+    int index = 0;
+    for (const auto& definition : filedb->get_standing_queries()) {
+        crow::json::wvalue query_json;
+        query_json["id"] = definition.id;
+        query_json["search_text"] = definition.text;
+        query_json["mode"] = definition.mode;
+        query_json["root"] = definition.root;
+        query_json["include_hidden"] = definition.include_hidden;
+        query_json["created_time"] = definition.created_time;
+        result[index++] = std::move(query_json);
+    }
+    return index;
+}
+
+int WebService::db_add_standing_query(const std::string& uid,
+    const std::string& decoded_search_text,
+    const std::string& mode,
+    const std::string& root,
+    bool include_hidden,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return -1;
+    }
+
+    // 只维护自己数据库中的记录：共享索引的变化不经过这个数据库，结果也需要按权限过滤
+    int id = 0;
+    try {
+        id = filedb->add_standing_query(decoded_search_text, mode, root, include_hidden);
+    } catch (const std::exception& e) {
+        // 模式不支持、正则表达式语法错误等
+        error_msg = e.what();
+        return -1;
+    }
+    if (id <= 0) {
+        error_msg = "Failed to save standing query.";
+    }
+    return id;
+}
+
+int WebService::db_get_standing_query(const std::string& uid,
+    int id,
+    uint64_t since,
+    uint64_t &version,
+    bool &reset,
+    crow::json::wvalue& added,
+    crow::json::wvalue& removed,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return -1;
+    }
+
+    // 第一次访问时求出匹配集合，之后只返回变化
+    std::vector<FileInfo> files;
+    std::vector<int> removed_ids;
+    if (!filedb->fetch_standing_query(id, since, version, reset, files, removed_ids)) {
+        error_msg = "Standing query not found or could not be evaluated.";
+        return -1;
+    }
+
+    added = crow::json::wvalue(std::vector<crow::json::wvalue>());
+    int index = 0;
+    for (const auto& file : files) {
+        added[index++] = file_to_json(file);
+    }
+    removed = crow::json::wvalue(std::vector<crow::json::wvalue>());
+    for (size_t i = 0; i < removed_ids.size(); ++i) {
+        removed[i] = removed_ids[i];
+    }
+    return index;
+}
+
+bool WebService::db_delete_standing_query(const std::string& uid,
+    int id,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return false;
+    }
+
+    if (!filedb->delete_standing_query(id)) {
+        error_msg = "Standing query not found.";
+        return false;
+    }
+    return true;
+}
+
 void WebService::db_delete_search_task(const std::string& uid,
     const std::string& task_id,
     std::string &error_msg)
@@ -528,10 +1003,66 @@ void WebService::db_delete_search_task(const std::string& uid,
     return;
 }
 
+bool WebService::db_get_search_stats(const std::string& uid,
+    crow::json::wvalue& result,
+    std::string &error_msg)
+{
+    std::shared_ptr<FileDB> filedb = get_db(uid);
+    // 初始化数据库
+    if (filedb == nullptr) {
+        error_msg = "Failed to initialize database.";
+        return false;
+    }
+
+    const SearchTaskRegistry::Stats tasks = filedb->get_task_stats();
+    result["tasks"]["live"] = tasks.live;
+    result["tasks"]["memory_bytes"] = tasks.memory_bytes;
+    result["tasks"]["created"] = tasks.created;
+    result["tasks"]["completed"] = tasks.completed;
+    result["tasks"]["expired"] = tasks.expired;
+    result["tasks"]["evicted"] = tasks.evicted;
+
+    // 后台计算的时间减去请求等待预取的时间，就是与请求重叠掉的时间
+    const SearchPrefetchStats prefetch = filedb->get_prefetch_stats();
+    result["prefetch"]["batches_prefetched"] = prefetch.batches_prefetched;
+    result["prefetch"]["batches_served"] = prefetch.batches_served;
+    result["prefetch"]["batches_discarded"] = prefetch.batches_discarded;
+    result["prefetch"]["background_us"] = prefetch.background_us;
+    result["prefetch"]["foreground_us"] = prefetch.foreground_us;
+    result["prefetch"]["wait_us"] = prefetch.wait_us;
+    result["prefetch"]["overlapped_us"] =
+        prefetch.background_us > prefetch.wait_us ? prefetch.background_us - prefetch.wait_us : 0;
+    return true;
+}
+
 std::shared_ptr<FileDB> WebService::get_db(const std::string& uid)
 {
     std::lock_guard<std::mutex> lock(db_map_mutex_);
 
+    std::shared_ptr<FileDB> db = open_db(uid);
+    if (db == nullptr || uid == SHARED_INDEX_UID || db->has_shared_index() || !is_shared_index_enabled() ||
+        !std::filesystem::exists(get_db_path_by_uid(SHARED_INDEX_UID))) {
+        return db;
+    }
+
+    // 其他用户的搜索同时查询 root 的共享索引，结果按该用户对所在目录的权限过滤
+    uid_t numeric_uid;
+    try {
+        numeric_uid = static_cast<uid_t>(std::stoul(uid));
+    } catch (const std::exception&) {
+        return db;
+    }
+
+    std::shared_ptr<FileDB> shared = open_db(SHARED_INDEX_UID);
+    if (shared) {
+        db->set_shared_index(shared, std::make_shared<AccessChecker>(numeric_uid));
+        std::cout << "已挂载共享索引, uid: " << uid << std::endl;
+    }
+    return db;
+}
+
+std::shared_ptr<FileDB> WebService::open_db(const std::string& uid)
+{
     auto it = db_map_.find(uid);
     if (it != db_map_.end()) {
         return it->second;
@@ -547,4 +1078,30 @@ std::shared_ptr<FileDB> WebService::get_db(const std::string& uid)
     {
         return nullptr;
     }
-}
\ No newline at end of file
+}
+
+std::string WebService::find_shared_scan_obj(const std::string& path)
+{
+    const std::string shared_db_path = get_db_path_by_uid(SHARED_INDEX_UID);
+    if (!is_shared_index_enabled() || !std::filesystem::exists(shared_db_path)) {
+        return std::string();
+    }
+
+    ScanObject scan_object(shared_db_path);
+    if (!scan_object.init_database()) {
+        return std::string();
+    }
+
+    for (const auto& object : scan_object.get_all_scan_objects()) {
+        const std::string& dir = object.directory_path;
+        if (path == dir) {
+            return dir;
+        }
+        const bool under = path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+                           (dir.back() == '/' || path[dir.size()] == '/');
+        if (under && object.is_recursive) {
+            return dir;
+        }
+    }
+    return std::string();
+}
@@ -20,16 +20,40 @@ public:
     // GET /api/filedb/{uid}/{search_text} - 获取scan_obj列表
     crow::response get_filedb_objs(const std::string& uid, const std::string& search_text);
 
+    // GET /api/filedb/{uid}/suggest/{prefix} - 输入联想，补全搜索文本的最后一个词
+    crow::response get_suggestions(const std::string& uid, const std::string& prefix, int limit = 10);
+
     // POST /api/filedb/{uid}/task/{search_text} - 创建查找任务，获取task_id
     crow::response create_search_task(const std::string& uid, const std::string& search_text,
-                                      bool include_hidden = false);
+                                      bool include_hidden = false, const std::string& mode = "",
+                                      bool facets = false, const std::string& sort = "",
+                                      bool descending = false);
 
     // GET /api/filedb/{uid}/task/{task_id} - 获取查找任务，获取task_id的一部分查找结果，与查找状态
     crow::response get_search_task(const std::string& uid, const std::string& task_id);
 
+    // GET /api/filedb/{uid}/task/{task_id}?offset=&count= - 随机访问查找结果中的一段，用于虚拟滚动
+    crow::response get_search_window(const std::string& uid, const std::string& task_id, int offset, int count);
+
     // DELETE /api/filedb/{uid}/task/{task_id} - 删除查找任务
     crow::response delete_search_task(const std::string& uid, const std::string& task_id);
 
+    // GET /api/search_stats/{uid} - 搜索任务表与后台预取的累计计数
+    crow::response get_search_stats(const std::string& uid);
+
+    // GET /api/standing_query/{uid} - 常驻查询列表
+    crow::response get_standing_queries(const std::string& uid);
+
+    // POST /api/standing_query/{uid}/{search_text} - 保存常驻查询，结果随文件变化增量维护
+    crow::response add_standing_query(const std::string& uid, const std::string& search_text,
+                                      const std::string& mode, const std::string& root, bool include_hidden);
+
+    // GET /api/standing_query/{uid}/{id}?since= - 常驻查询的全部结果，或自版本 since 以来的变化
+    crow::response get_standing_query(const std::string& uid, const std::string& id, uint64_t since);
+
+    // DELETE /api/standing_query/{uid}/{id} - 删除常驻查询
+    crow::response delete_standing_query(const std::string& uid, const std::string& id);
+
     // POST /api/audit/events - 处理audit消息
     crow::response audit_event(const crow::request& req);
 
@@ -55,23 +79,77 @@ private:
         crow::json::wvalue& result,
         std::string &error_msg);
 
+    int db_get_suggestions(const std::string& uid,
+        const std::string& prefix,
+        int limit,
+        crow::json::wvalue& result,
+        std::string &error_msg);
+
     std::string db_create_search_task(const std::string& uid,
         const std::string& decoded_search_text,
         int &max_file_count,
+        bool &refined,
         std::string &error_msg,
-        bool include_hidden = false);
+        bool include_hidden,
+        const std::string& mode,
+        bool &facets,
+        const std::string& sort,
+        bool descending);
 
     int db_get_search_task(const std::string& uid,
         const std::string& task_id,
         crow::json::wvalue& result,
         bool &is_finished,
+        SearchProgress &progress,
+        SearchFacets &facets,
+        bool &has_facets,
+        std::string &error_msg);
+
+    int db_get_search_window(const std::string& uid,
+        const std::string& task_id,
+        int offset,
+        int count,
+        crow::json::wvalue& result,
+        int &total,
         std::string &error_msg);
 
     void db_delete_search_task(const std::string& uid,
         const std::string& task_id,
         std::string &error_msg);
 
+    bool db_get_search_stats(const std::string& uid,
+        crow::json::wvalue& result,
+        std::string &error_msg);
+
+    int db_get_standing_queries(const std::string& uid,
+        crow::json::wvalue& result,
+        std::string &error_msg);
+
+    int db_add_standing_query(const std::string& uid,
+        const std::string& decoded_search_text,
+        const std::string& mode,
+        const std::string& root,
+        bool include_hidden,
+        std::string &error_msg);
+
+    int db_get_standing_query(const std::string& uid,
+        int id,
+        uint64_t since,
+        uint64_t &version,
+        bool &reset,
+        crow::json::wvalue& added,
+        crow::json::wvalue& removed,
+        std::string &error_msg);
+
+    bool db_delete_standing_query(const std::string& uid,
+        int id,
+        std::string &error_msg);
+
     std::shared_ptr<FileDB> get_db(const std::string& uid);
+    // 调用者需持有 db_map_mutex_
+    std::shared_ptr<FileDB> open_db(const std::string& uid);
+    // path 已被 root 的某个扫描对象覆盖时返回该扫描对象的目录
+    std::string find_shared_scan_obj(const std::string& path);
 
     std::mutex db_map_mutex_;
     std::map<std::string, std::shared_ptr<FileDB>> db_map_;
@@ -0,0 +1,73 @@
+// 文件名索引并行扫描的基准测试：在合成的文件名上按 1..N 个线程各跑一遍全量扫描
+// 用法: name_index_bench [记录数，默认 5000000] [最大线程数，默认 CPU 核数]
+// 构建: cmake -DANYTHING_BUILD_BENCH=ON
+#include "NameIndex.h"
+#include "NameMatcher.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+// 每个模式重复的次数，取最快的一次
+static const int BENCH_REPEAT = 3;
+
+int main(int argc, char** argv) {
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 5000000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    max_threads = std::max(max_threads, 1);
+
+    // 合成的文件名：常见的前缀、随机编号与扩展名，分散在一千个目录下
+    static const char* words[] = {"report", "photo", "backup", "notes", "invoice", "build", "draft", "readme"};
+    static const char* extensions[] = {".txt", ".pdf", ".jpg", ".cpp", ".h", ".docx", ".tar.gz", ""};
+    std::mt19937 rng(1);
+    NameIndex index;
+    auto start = std::chrono::steady_clock::now();
+    for (int id = 1; id <= rows; ++id) {
+        const std::string name = std::string(words[rng() % 8]) + "_" + std::to_string(rng() % 1000000) +
+                                 extensions[rng() % 8];
+        index.insert(id, name, 0, "/home/user/dir" + std::to_string(rng() % 1000));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "记录数: " << rows << ", 建索引耗时: " << elapsed << "ms, CPU 核数: "
+              << std::thread::hardware_concurrency() << std::endl;
+
+    // 不传候选，强制扫描整个范围；依次是字面量、子串通配符和带 ? 的模式
+    // 线程数按 1, 2, 4 ... 翻倍，最后一次用满 max_threads
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (const char* pattern : {"up_1", "rep*7.p", "b?ck*9"}) {
+        const NameMatcher matcher(pattern);
+        double serial_ms = 0;
+        for (int threads : thread_counts) {
+            double best_ms = 0;
+            size_t matches = 0;
+            for (int round = 0; round < BENCH_REPEAT; ++round) {
+                std::vector<int> out;
+                auto begin = std::chrono::steady_clock::now();
+                index.search(matcher, 1, rows, true, -1, out, nullptr, threads);
+                const double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - begin).count();
+                if (round == 0 || ms < best_ms) {
+                    best_ms = ms;
+                }
+                matches = out.size();
+            }
+            if (threads == 1) {
+                serial_ms = best_ms;
+            }
+            std::cout << "模式: " << std::setw(8) << pattern << ", 线程数: " << std::setw(2) << threads
+                      << ", 匹配数: " << std::setw(8) << matches << ", 耗时: " << std::fixed << std::setprecision(1)
+                      << best_ms << "ms, 加速比: " << std::setprecision(2) << serial_ms / best_ms << std::endl;
+        }
+    }
+    return 0;
+}
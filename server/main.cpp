@@ -47,6 +47,18 @@ int main() {
         return web_service.get_filedb_objs(uid, search_text);
     });
 
+    // GET /api/filedb/{uid}/suggest/{prefix} - 输入联想，limit 为返回的补全个数，默认 10
+    CROW_ROUTE(app, "/api/filedb/<string>/suggest/<string>")
+    .methods("GET"_method)
+    ([&web_service](const crow::request& req, const std::string& uid, const std::string& prefix) {
+        int limit = 10;
+        const char* limit_param = req.url_params.get("limit");
+        if (limit_param != nullptr) {
+            limit = std::atoi(limit_param);
+        }
+        return web_service.get_suggestions(uid, prefix, limit);
+    });
+
     // POST /api/audit/events - audit插件发过来的消息通告
     CROW_ROUTE(app, "/api/audit/events")
     .methods("POST"_method)
@@ -63,13 +75,49 @@ int main() {
         if (hidden_param != nullptr) {
             include_hidden = (std::string(hidden_param) == "1");
         }
-        return web_service.create_search_task(uid, search_text, include_hidden);
+        // 默认按文件名搜索，搜索文本可以带过滤条件，例如 "report ext:pdf size:>1mb modified:>=2026-01 type:file"
+        // 多个词之间为“并且”，a|b 表示任选其一，!draft 或 -draft 表示不包含，引号内的空格按字面匹配
+        // mode=pinyin：同时按拼音、拼音首字母匹配中文文件名
+        // mode=regex：搜索文本为正则表达式
+        // mode=fuzzy：容错匹配，结果按相关度排序
+        // mode=ranked：先返回精确、前缀匹配，再返回其余匹配中相关度最高的部分
+        std::string mode;
+        const char* mode_param = req.url_params.get("mode");
+        if (mode_param != nullptr) {
+            mode = mode_param;
+        }
+        // facets=1：第一批结果附带按扩展名、文件/目录、父目录、扫描对象统计的匹配数
+        bool facets = false;
+        const char* facets_param = req.url_params.get("facets");
+        if (facets_param != nullptr) {
+            facets = (std::string(facets_param) == "1");
+        }
+        // sort=name|natural|path|mtime|size&order=desc：结果在服务端排好序后分批返回，第一批就是排序后的开头部分
+        std::string sort;
+        const char* sort_param = req.url_params.get("sort");
+        if (sort_param != nullptr) {
+            sort = sort_param;
+        }
+        bool descending = false;
+        const char* order_param = req.url_params.get("order");
+        if (order_param != nullptr) {
+            descending = (std::string(order_param) == "desc");
+        }
+        return web_service.create_search_task(uid, search_text, include_hidden, mode, facets, sort, descending);
     });
 
     // GET /api/filedb/{uid}/task/{search_text} - 创建查找任务，获取task_id
     CROW_ROUTE(app, "/api/filedb/<string>/task/<string>")
     .methods("GET"_method)
-    ([&web_service](const std::string& uid, const std::string& task_id) {
+    ([&web_service](const crow::request& req, const std::string& uid, const std::string& task_id) {
+        // 带 offset 时随机访问结果中的 [offset, offset + count)，count 默认 100；
+        // 第一次访问时求出全部匹配的 id，之后每次的耗时只与 count 有关
+        const char* offset_param = req.url_params.get("offset");
+        if (offset_param != nullptr) {
+            const char* count_param = req.url_params.get("count");
+            int count = count_param != nullptr ? std::atoi(count_param) : 100;
+            return web_service.get_search_window(uid, task_id, std::atoi(offset_param), count);
+        }
         return web_service.get_search_task(uid, task_id);
     });
 
@@ -80,6 +128,51 @@ int main() {
         return web_service.delete_search_task(uid, task_id);
     });
 
+    // GET /api/search_stats/{uid} - 搜索任务表与后台预取的累计计数
+    CROW_ROUTE(app, "/api/search_stats/<string>")
+    .methods("GET"_method)
+    ([&web_service](const std::string& uid) {
+        return web_service.get_search_stats(uid);
+    });
+
+    // GET /api/standing_query/{uid} - 常驻查询列表
+    CROW_ROUTE(app, "/api/standing_query/<string>")
+    .methods("GET"_method)
+    ([&web_service](const std::string& uid) {
+        return web_service.get_standing_queries(uid);
+    });
+
+    // POST /api/standing_query/{uid}/{search_text} - 保存常驻查询
+    // mode=pinyin|regex 与搜索任务相同；root=/srv 只保留该目录下的记录；include_hidden=1 包含隐藏文件夹
+    CROW_ROUTE(app, "/api/standing_query/<string>/<string>")
+    .methods("POST"_method)
+    ([&web_service](const crow::request& req, const std::string& uid, const std::string& search_text) {
+        const char* mode_param = req.url_params.get("mode");
+        const char* root_param = req.url_params.get("root");
+        const char* hidden_param = req.url_params.get("include_hidden");
+        return web_service.add_standing_query(uid, search_text,
+                                              mode_param != nullptr ? mode_param : "",
+                                              root_param != nullptr ? root_param : "",
+                                              hidden_param != nullptr && std::string(hidden_param) == "1");
+    });
+
+    // GET /api/standing_query/{uid}/{id}?since= - 常驻查询的结果：不带 since 时返回全部，
+    // 带上一次返回的 version 时只返回之后新增、变化与移出的记录，没有变化时不访问数据库
+    CROW_ROUTE(app, "/api/standing_query/<string>/<string>")
+    .methods("GET"_method)
+    ([&web_service](const crow::request& req, const std::string& uid, const std::string& id) {
+        const char* since_param = req.url_params.get("since");
+        uint64_t since = since_param != nullptr ? std::strtoull(since_param, nullptr, 10) : 0;
+        return web_service.get_standing_query(uid, id, since);
+    });
+
+    // DELETE /api/standing_query/{uid}/{id} - 删除常驻查询
+    CROW_ROUTE(app, "/api/standing_query/<string>/<string>")
+    .methods("DELETE"_method)
+    ([&web_service](const std::string& uid, const std::string& id) {
+        return web_service.delete_standing_query(uid, id);
+    });
+
     std::cout << "🚀 Web Service 已启动!" << std::endl;
     std::cout << "📍 服务地址: http://localhost:5071" << std::endl;
     